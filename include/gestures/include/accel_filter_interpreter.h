@@ -5,11 +5,13 @@
 #include <math.h>
 
 #include <memory>
+#include <vector>
 #include <gtest/gtest.h>  // for FRIEND_TEST
 
 #include "gestures/include/filter_interpreter.h"
 #include "gestures/include/gestures.h"
 #include "gestures/include/prop_registry.h"
+#include "gestures/include/shared_resources.h"
 #include "gestures/include/tracer.h"
 
 #ifndef GESTURES_ACCEL_FILTER_INTERPRETER_H_
@@ -19,20 +21,31 @@ namespace gestures {
 
 // This interpreter provides pointer and scroll acceleration based on
 // an acceleration curve and the user's sensitivity setting.
-
-class AccelFilterInterpreter : public FilterInterpreter {
+//
+// Curves are made of segments, each a quadratic in the input speed. When the
+// curve in use changes, it's compiled so that the segment for a given speed
+// is found with a table lookup rather than a scan over the segments.
+
+class AccelFilterInterpreter : public FilterInterpreter,
+                               public PropertyDelegate {
+  FRIEND_TEST(AccelFilterInterpreterTest, AccelPointsTest);
+  FRIEND_TEST(AccelFilterInterpreterTest, CompiledCurveTest);
   FRIEND_TEST(AccelFilterInterpreterTest, CustomAccelTest);
+  FRIEND_TEST(AccelFilterInterpreterTest, SharedCurvesTest);
   FRIEND_TEST(AccelFilterInterpreterTest, SimpleTest);
   FRIEND_TEST(AccelFilterInterpreterTest, TimingTest);
   FRIEND_TEST(AccelFilterInterpreterTest, TinyMoveTest);
  public:
-  // Takes ownership of |next|:
+  // Takes ownership of |next|. If |resources| is given, the default curves
+  // are shared with other instances using it.
   AccelFilterInterpreter(PropRegistry* prop_reg, Interpreter* next,
-                         Tracer* tracer);
+                         Tracer* tracer, SharedResources* resources = NULL);
   virtual ~AccelFilterInterpreter() {}
 
   virtual void ConsumeGesture(const Gesture& gs);
 
+  virtual void DoubleArrayWasWritten(DoubleArrayProperty* prop);
+
  private:
   struct CurveSegment {
     CurveSegment() : x_(INFINITY), sqr_(0.0), mul_(1.0), int_(0.0) {}
@@ -51,12 +64,47 @@ class AccelFilterInterpreter : public FilterInterpreter {
   static const size_t kMaxCurveSegs = 3;
   static const size_t kMaxCustomCurveSegs = 20;
   static const size_t kMaxAccelCurves = 5;
+  // Most (input speed, output speed) points in a measured curve
+  static const size_t kMaxAccelPoints = 256;
+
+  // A curve prepared for lookups. The speeds up to the curve's last finite
+  // segment boundary are split into equal buckets, each of which knows the
+  // first segment that can hold a speed in it. A lookup starts there, and
+  // with several buckets per segment, seldom has to step past a boundary.
+  class CompiledCurve {
+   public:
+    CompiledCurve() : source_(NULL), bucket_scale_(0.0) {}
+    // Copies the first |count| segments of |segs|, up to the first that
+    // extends to infinity, and sets up the buckets.
+    void Compile(const CurveSegment* segs, size_t count);
+    // Returns the first segment whose max X value is at least |mag|, or NULL
+    // if there is none.
+    const CurveSegment* Find(float mag) const;
+
+    // The segments last compiled, or NULL to force compiling them again
+    const CurveSegment* source_;
+
+   private:
+    size_t Bucket(double mag) const;
+
+    std::vector<CurveSegment> segs_;
+    // Index in segs_ to start from for each bucket. The last one is for
+    // speeds beyond the last finite boundary.
+    std::vector<size_t> starts_;
+    double bucket_scale_;  // Buckets per mm/s
+  };
 
-  // curves for sensitivity 1..5
-  CurveSegment point_curves_[kMaxAccelCurves][kMaxCurveSegs];
-  CurveSegment old_mouse_point_curves_[kMaxAccelCurves][kMaxCurveSegs];
-  CurveSegment mouse_point_curves_[kMaxAccelCurves][kMaxCurveSegs];
-  CurveSegment scroll_curves_[kMaxAccelCurves][kMaxCurveSegs];
+  // The built-in curves. They never change, so all instances can share them.
+  struct DefaultCurves {
+    // curves for sensitivity 1..5
+    CurveSegment point_curves[kMaxAccelCurves][kMaxCurveSegs];
+    CurveSegment old_mouse_point_curves[kMaxAccelCurves][kMaxCurveSegs];
+    CurveSegment mouse_point_curves[kMaxAccelCurves][kMaxCurveSegs];
+    CurveSegment scroll_curves[kMaxAccelCurves][kMaxCurveSegs];
+  };
+  static DefaultCurves* NewDefaultCurves(void* unused);
+
+  std::shared_ptr<const DefaultCurves> curves_;
 
   // Custom curves
   CurveSegment tp_custom_point_[kMaxCustomCurveSegs];
@@ -76,6 +124,21 @@ class AccelFilterInterpreter : public FilterInterpreter {
   BoolProperty use_custom_tp_scroll_curve_;
   BoolProperty use_custom_mouse_curve_;
 
+  // A measured mouse pointer curve: (input speed, output speed) pairs in
+  // mm/s, with increasing input speeds, interpolated linearly from (0, 0)
+  // and extended past the last point with the last slope. The list ends at
+  // the first pair whose input speed isn't greater than the one before.
+  // Takes precedence over the other mouse pointer curves if enabled.
+  void SetMouseAccelPoints();
+  double mouse_accel_points_[2 * kMaxAccelPoints];
+  CurveSegment mouse_accel_points_curve_[kMaxAccelPoints + 1];
+  DoubleArrayProperty mouse_accel_points_prop_;
+  BoolProperty use_mouse_accel_points_;
+
+  // The current pointing and scrolling curves
+  CompiledCurve point_curve_;
+  CompiledCurve scroll_curve_;
+
   IntProperty pointer_sensitivity_;  // [1..5]
   IntProperty scroll_sensitivity_;  // [1..5]
 
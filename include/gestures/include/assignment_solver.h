@@ -0,0 +1,52 @@
+// Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef GESTURES_ASSIGNMENT_SOLVER_H_
+#define GESTURES_ASSIGNMENT_SOLVER_H_
+
+#include "gestures/include/finger_metrics.h"
+#include "gestures/include/macros.h"
+
+namespace gestures {
+
+// Pairs up rows and columns of a cost matrix, e.g. old and new contacts
+// with their distances, so that as many pairs as possible are made and,
+// among those pairings, the total cost is smallest. Pairs whose cost was
+// never set are forbidden. Unlike taking each row's cheapest column in
+// turn, the result doesn't depend on the order of the rows.
+//
+// This is the Hungarian method, O(n^3) in the larger side of the matrix.
+// Everything is in fixed-size arrays, so solving never allocates.
+class AssignmentSolver {
+ public:
+  static const size_t kMaxSize = kMaxFingers;
+  static const int kUnassigned = -1;
+
+  AssignmentSolver();
+
+  // Starts a new |rows| x |cols| problem, with every pair forbidden.
+  void Reset(size_t rows, size_t cols);
+  // Allows pairing |row| with |col|, at |cost|, which must be >= 0.
+  void SetCost(size_t row, size_t col, float cost);
+  // Returns the number of pairs made.
+  size_t Solve();
+  // After Solve(), the column paired with |row|, or kUnassigned.
+  int ColForRow(size_t row) const { return col_for_row_[row]; }
+  // After Solve(), the row paired with |col|, or kUnassigned.
+  int RowForCol(size_t col) const { return row_for_col_[col]; }
+
+ private:
+  size_t rows_;
+  size_t cols_;
+  float cost_[kMaxSize][kMaxSize];
+  bool allowed_[kMaxSize][kMaxSize];
+  int col_for_row_[kMaxSize];
+  int row_for_col_[kMaxSize];
+
+  DISALLOW_COPY_AND_ASSIGN(AssignmentSolver);
+};
+
+}  // namespace gestures
+
+#endif  // GESTURES_ASSIGNMENT_SOLVER_H_
@@ -8,7 +8,7 @@
 #include "gestures/include/filter_interpreter.h"
 #include "gestures/include/finger_metrics.h"
 #include "gestures/include/gestures.h"
-#include "gestures/include/map.h"
+#include "gestures/include/hardware_state_buffer.h"
 #include "gestures/include/prop_registry.h"
 #include "gestures/include/tracer.h"
 
@@ -48,7 +48,8 @@ class BoxFilterInterpreter : public FilterInterpreter, public PropertyDelegate {
   DoubleProperty box_width_;
   DoubleProperty box_height_;
 
-  map<short, FingerState, kMaxFingers> previous_output_;
+  // The previous output
+  HardwareStateBuffer output_history_;
 };
 
 }  // namespace gestures
@@ -0,0 +1,146 @@
+// Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef GESTURES_CONFIG_PROFILE_H_
+#define GESTURES_CONFIG_PROFILE_H_
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include <json/value.h>
+
+#include "gestures/include/gestures.h"
+#include "gestures/include/macros.h"
+
+namespace gestures {
+
+class PropRegistry;
+
+// A precompiled set of property values per device, memory-mapped from a
+// file so that applying it needs no parsing.
+//
+// Each entry is keyed by device class and a fingerprint of the device's
+// HardwareProperties. A fingerprint of kAnyDevice matches every device of
+// the class. Files are written by ConfigProfileBuilder, in host byte order:
+//
+//   Header
+//   Entry[entry_count]
+//   Setting[setting_count]
+//   double values[]  (for numbers and bools; 8-byte aligned)
+//   char strings[]   (NUL-terminated names and string values)
+//
+// All offsets are from the start of the file. Open() checks that they are
+// in range, so Apply() needn't.
+class ConfigProfile {
+ public:
+  static const uint32_t kMagic = 0x46525047;  // "GPRF"
+  static const uint32_t kVersion = 1;
+  static const uint32_t kAnyDevice = 0;
+
+  struct Header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;  // of the whole file
+    uint32_t entry_count;
+    uint32_t setting_count;
+    uint32_t values_offset;
+    uint32_t value_count;
+    uint32_t strings_offset;
+  };
+  struct Entry {
+    uint32_t device_class;
+    uint32_t fingerprint;
+    uint32_t first_setting;
+    uint32_t setting_count;
+  };
+  struct Setting {
+    uint32_t name_offset;
+    uint32_t type;  // a GesturesPropType
+    // For arrays, the number of values; 0 for a scalar.
+    uint32_t count;
+    // For strings, the offset of the value; otherwise the index of the
+    // first value in the values array.
+    uint32_t value;
+  };
+
+  ConfigProfile() : data_(NULL), size_(0) {}
+  ~ConfigProfile();
+
+  // Maps the file at |path|. Returns false if it can't be read or isn't a
+  // valid profile.
+  bool Open(const char* path);
+
+  // Sets the properties in |prop_reg| listed by the entries for |cls| and
+  // |fingerprint|: first the class-wide entry, then the device's own.
+  // Settings for properties that aren't registered, or with values of the
+  // wrong type, are skipped with an error. Returns the number applied.
+  size_t Apply(GestureInterpreterDeviceClass cls, uint32_t fingerprint,
+               PropRegistry* prop_reg) const;
+
+  // Never returns kAnyDevice.
+  static uint32_t Fingerprint(const HardwareProperties& hwprops);
+
+ private:
+  // Checks the mapped file's header and offsets.
+  bool Validate() const;
+  const Header* header() const {
+    return reinterpret_cast<const Header*>(data_);
+  }
+  const Entry* entries() const {
+    return reinterpret_cast<const Entry*>(data_ + sizeof(Header));
+  }
+  const Setting* settings() const {
+    return reinterpret_cast<const Setting*>(
+        entries() + header()->entry_count);
+  }
+  const double* values() const {
+    return reinterpret_cast<const double*>(data_ + header()->values_offset);
+  }
+  size_t ApplyEntry(const Entry& entry, PropRegistry* prop_reg) const;
+  Json::Value SettingValue(const Setting& setting) const;
+
+  const char* data_;
+  size_t size_;
+
+  DISALLOW_COPY_AND_ASSIGN(ConfigProfile);
+};
+
+// Compiles property values, as JSON objects mapping names to values like
+// the "properties" of an activity log, into a ConfigProfile file.
+class ConfigProfileBuilder {
+ public:
+  ConfigProfileBuilder() {}
+
+  // Returns false, adding nothing, if a value isn't a bool, number, string
+  // or non-empty array of one of those.
+  bool AddEntry(GestureInterpreterDeviceClass cls, uint32_t fingerprint,
+                const Json::Value& props);
+  // Returns the file contents.
+  std::string Build() const;
+
+ private:
+  struct PendingSetting {
+    std::string name;
+    ConfigProfile::Setting setting;
+    std::string string_val;
+  };
+  static bool ScalarType(const Json::Value& value, uint32_t* type);
+  // Fills in |setting|'s type and count, and appends any numeric values to
+  // |values|. Returns false if |value| can't be stored.
+  static bool ParseValue(const Json::Value& value,
+                         ConfigProfile::Setting* setting,
+                         std::vector<double>* values);
+
+  std::vector<ConfigProfile::Entry> entries_;
+  std::vector<PendingSetting> settings_;
+  std::vector<double> values_;
+
+  DISALLOW_COPY_AND_ASSIGN(ConfigProfileBuilder);
+};
+
+}  // namespace gestures
+
+#endif  // GESTURES_CONFIG_PROFILE_H_
@@ -0,0 +1,95 @@
+// Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef GESTURES_EVDEV_FRONT_END_H_
+#define GESTURES_EVDEV_FRONT_END_H_
+
+#include <linux/input.h>
+#include <memory>
+
+#include "gestures/include/gestures.h"
+#include "gestures/include/macros.h"
+
+namespace gestures {
+
+// Turns a stream of evdev input_events into HardwareStates, so embedders
+// don't each have to implement multitouch protocol B slot tracking.
+//
+// All storage is allocated up front from the HardwareProperties: each call to
+// ReadEvents() does a single read() into a fixed event buffer, updates the
+// slots in place, and for each SYN_REPORT fills in the same HardwareState
+// (and FingerState array) and hands it to a callback. The HardwareState is
+// only valid for the duration of the callback.
+//
+// Quirks follow the HardwareProperties: on T5R2 and semi-MT pads, touch_cnt
+// comes from BTN_TOOL_* and may be larger than the number of reported slots.
+// Everywhere else it's the number of active slots.
+//
+// The fd may be an evdev device or a regular file holding a recorded event
+// stream. After SYN_DROPPED, events are discarded up to the next SYN_REPORT
+// and the slot state that was last seen is kept.
+class EvdevFrontEnd {
+ public:
+  typedef void (*FrameCallback)(void* data, HardwareState* hwstate);
+
+  explicit EvdevFrontEnd(const HardwareProperties& hwprops);
+
+  // Does one read() from |fd| and processes every complete event read,
+  // calling |callback| for each frame. Returns the number of events
+  // processed, 0 if there was nothing to read (EOF or EAGAIN), or -1 on
+  // error.
+  int ReadEvents(int fd, FrameCallback callback, void* data);
+
+  // Processes a single event. Returns true if it completed a frame, in which
+  // case hwstate() holds it.
+  bool ProcessEvent(const struct input_event& event);
+
+  HardwareState* hwstate() { return &hwstate_; }
+
+  // A FrameCallback that pushes frames into the GestureInterpreter passed
+  // as |data|.
+  static void PushToGestureInterpreter(void* data, HardwareState* hwstate);
+
+ private:
+  struct Slot {
+    FingerState finger;
+    bool active;
+  };
+
+  static const size_t kEventBufferSize = 64;
+
+  void HandleAbs(const struct input_event& event);
+  void HandleKey(const struct input_event& event);
+  void HandleRel(const struct input_event& event);
+  // Fills hwstate_ from the slots at the end of a frame.
+  void FinishFrame(stime_t timestamp);
+
+  HardwareProperties hwprops_;
+  size_t slot_count_;
+  std::unique_ptr<Slot[]> slots_;
+  std::unique_ptr<FingerState[]> fingers_;
+  size_t current_slot_;
+
+  // From BTN_TOOL_*: the number of fingers touching, or 0 if unknown.
+  unsigned short tool_touch_cnt_;
+  int buttons_down_;
+  float rel_x_;
+  float rel_y_;
+  float rel_wheel_;
+  float rel_hwheel_;
+  // Set between SYN_DROPPED and the next SYN_REPORT.
+  bool dropping_;
+
+  HardwareState hwstate_;
+
+  struct input_event buffer_[kEventBufferSize];
+  // Bytes of a partial event left over from the last read().
+  size_t buffered_bytes_;
+
+  DISALLOW_COPY_AND_ASSIGN(EvdevFrontEnd);
+};
+
+}  // namespace gestures
+
+#endif  // GESTURES_EVDEV_FRONT_END_H_
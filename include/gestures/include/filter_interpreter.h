@@ -24,7 +24,13 @@ class FilterInterpreter : public Interpreter, public GestureConsumer {
                     Interpreter* next,
                     Tracer* tracer,
                     bool force_logging)
-      : Interpreter(prop_reg, tracer, force_logging) { next_.reset(next); }
+      : Interpreter(prop_reg, tracer, force_logging) {
+    next_.reset(next);
+    // Chains are built from the bottom up, so they all end up sharing the
+    // last interpreter's geometry.
+    if (next)
+      geometry_ = next->geometry();
+  }
   virtual ~FilterInterpreter() {}
 
   Json::Value EncodeCommonInfo();
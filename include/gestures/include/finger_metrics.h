@@ -11,9 +11,16 @@
 
 namespace gestures {
 
-static const size_t kMaxFingers = 10;
+// Upper bound on the contacts per frame the interpreters track, which sizes
+// their per-finger containers. Builds for large touch surfaces can raise it
+// (e.g. make GESTURES_MAX_FINGERS=40); lookups by tracking id stay O(1).
+#ifndef GESTURES_MAX_FINGERS
+#define GESTURES_MAX_FINGERS 10
+#endif
+
+static const size_t kMaxFingers = GESTURES_MAX_FINGERS;
 static const size_t kMaxGesturingFingers = 3;
-static const size_t kMaxTapFingers = 10;
+static const size_t kMaxTapFingers = kMaxFingers;
 
 // A datastructure describing a 2D vector in the mathematical sense.
 struct Vector2 {
@@ -0,0 +1,71 @@
+// Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef GESTURES_FRAME_GEOMETRY_H_
+#define GESTURES_FRAME_GEOMETRY_H_
+
+#include <gtest/gtest.h>  // for FRIEND_TEST
+
+#include "gestures/include/finger_metrics.h"
+#include "gestures/include/gestures.h"
+#include "gestures/include/macros.h"
+
+namespace gestures {
+
+// Geometry of the fingers in a frame that several interpreters need: the
+// distances between fingers, and how far and fast each finger moved since
+// the previous frame. One instance is shared by the interpreters in a chain
+// (see Interpreter::geometry()), and each value is computed at most once
+// per frame, when it's first asked for.
+//
+// The cached values belong to the finger positions they were computed from.
+// When an interpreter asks about a frame that differs from them, e.g.
+// because a filter moved a finger, they are computed again. A frame with a
+// later timestamp than the cached one becomes the current frame, and the
+// cached one, as the interpreters last saw it, the previous frame.
+//
+// Fingers are identified by their index in the HardwareState.
+class FrameGeometry {
+  FRIEND_TEST(FrameGeometryTest, CacheTest);
+ public:
+  FrameGeometry();
+
+  // Squared distance between fingers |i| and |j| of |hwstate|.
+  float DistSq(const HardwareState& hwstate, size_t i, size_t j);
+  // Movement of finger |i| of |hwstate| since the previous frame, or zero
+  // if the finger is new.
+  Vector2 Delta(const HardwareState& hwstate, size_t i);
+  // Delta() per second, or zero if there's no previous frame.
+  Vector2 Velocity(const HardwareState& hwstate, size_t i);
+
+ private:
+  struct Snapshot {
+    stime_t timestamp;
+    size_t finger_cnt;
+    short tracking_ids[kMaxFingers];
+    Vector2 positions[kMaxFingers];
+  };
+
+  // Makes the cache describe |hwstate|.
+  void Sync(const HardwareState& hwstate);
+  static bool Matches(const Snapshot& snapshot, const HardwareState& hwstate);
+  static void Take(const HardwareState& hwstate, Snapshot* snapshot);
+  void ComputeDistances();
+  void ComputeDeltas();
+
+  Snapshot current_;
+  Snapshot previous_;
+  bool has_previous_;
+
+  bool distances_valid_;
+  float dist_sq_[kMaxFingers][kMaxFingers];
+  bool deltas_valid_;
+  Vector2 deltas_[kMaxFingers];
+
+  DISALLOW_COPY_AND_ASSIGN(FrameGeometry);
+};
+
+}  // namespace gestures
+
+#endif  // GESTURES_FRAME_GEOMETRY_H_
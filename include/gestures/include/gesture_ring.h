@@ -0,0 +1,84 @@
+// Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef GESTURES_GESTURE_RING_H_
+#define GESTURES_GESTURE_RING_H_
+
+#include <atomic>
+#include <memory>
+
+#include "gestures/include/gestures.h"
+#include "gestures/include/macros.h"
+
+namespace gestures {
+
+// A bounded, lock-free, single-producer/single-consumer queue of gestures.
+// The interpreter chain writes gestures into the ring from whatever thread
+// calls PushHardwareState()/TimerCallback(), and the client drains it from
+// its own thread with Pop(). This keeps the client's gesture handling out
+// of the interpretation path.
+//
+// Each slot carries its own state, so the producer and consumer never touch
+// a shared index. If coalescing is enabled and the newest gesture in the
+// ring hasn't been read yet (i.e. the reader is falling behind), a new Move
+// or Scroll of the same type is merged into it instead of taking a new slot.
+// The producer and consumer race for that slot with a compare-and-swap, so
+// a gesture is never modified while it is being read.
+class GestureRing {
+ public:
+  // |capacity| is rounded up to a power of two.
+  GestureRing(size_t capacity, bool coalesce);
+
+  // Producer side. Returns false if the ring was full and |gesture| was
+  // dropped. If |was_empty| is non-NULL, it's set to true when the consumer
+  // had already drained everything before this push, which is when a client
+  // needs to be woken up.
+  bool Push(const Gesture& gesture, bool* was_empty);
+
+  // Consumer side. Returns false if no gesture is ready.
+  bool Pop(Gesture* out);
+
+  size_t capacity() const { return mask_ + 1; }
+  bool coalesce() const { return coalesce_; }
+  // Number of gestures dropped because the ring was full. Producer side.
+  size_t dropped() const { return dropped_; }
+  // Number of gestures merged into an unread gesture. Producer side.
+  size_t coalesced() const { return coalesced_; }
+
+ private:
+  enum SlotState {
+    kSlotEmpty = 0,
+    kSlotWriting,
+    kSlotReady,
+    kSlotReading
+  };
+
+  struct Slot {
+    std::atomic<int> state;
+    Gesture gesture;
+  };
+
+  // Tries to merge |gesture| into the most recently pushed gesture. Fails if
+  // the consumer already started reading it.
+  bool TryCoalesce(const Gesture& gesture);
+
+  std::unique_ptr<Slot[]> slots_;
+  size_t mask_;
+  bool coalesce_;
+
+  // Producer-only state
+  size_t head_;
+  bool pushed_any_;
+  size_t dropped_;
+  size_t coalesced_;
+
+  // Consumer-only state
+  size_t tail_;
+
+  DISALLOW_COPY_AND_ASSIGN(GestureRing);
+};
+
+}  // namespace gestures
+
+#endif  // GESTURES_GESTURE_RING_H_
@@ -358,6 +358,10 @@ struct Gesture {
 typedef void (*GestureReadyFunction)(void* client_data,
                                      const struct Gesture* gesture);
 
+// Called when the gesture ring goes from empty to non-empty, so the client
+// knows to drain it (see GestureInterpreterEnableGestureRing()).
+typedef void (*GestureRingNotifyFunction)(void* client_data);
+
 // Gestures Timer Provider Interface
 struct GesturesTimer;
 typedef struct GesturesTimer GesturesTimer;
@@ -386,6 +390,28 @@ typedef struct {
   GesturesTimerFree free_fn;
 } GesturesTimerProvider;
 
+// Called by GesturesTimerFdLoop when a watched fd is readable.
+typedef void (*GesturesFdCallback)(int fd, void* data);
+
+// A unit of work run on a GesturesStrand.
+typedef void (*GesturesTaskFunction)(void* data);
+
+// Counters for a candidate touchpad stack run in shadow mode (see the
+// "Shadow Touchpad Stack Version" property). An event is one hardware state
+// or timer callback fed to both stacks. It diverged if the two stacks
+// produced different gestures for it.
+typedef struct {
+  size_t events;
+  size_t divergent_events;
+  size_t primary_gestures;
+  size_t shadow_gestures;
+  // Events the shadow stack never saw because it had fallen behind.
+  size_t dropped_events;
+  // Thread CPU time, in seconds, each stack spent on |events|.
+  stime_t primary_cpu_time;
+  stime_t shadow_cpu_time;
+} GesturesShadowStats;
+
 // Gestures Property Provider Interface
 struct GesturesProp;
 typedef struct GesturesProp GesturesProp;
@@ -455,6 +481,57 @@ typedef struct GesturesPropProvider {
   GesturesPropFree free_fn;
 } GesturesPropProvider;
 
+// Bulk property provider interface. Instead of a call per property, the
+// provider is handed a table describing many properties at once, and can
+// report writes to several properties in one call. A GestureInterpreter uses
+// either this or a GesturesPropProvider, not both.
+
+enum GesturesPropType {
+  GESTURES_PROP_INT,
+  GESTURES_PROP_SHORT,
+  GESTURES_PROP_BOOL,
+  GESTURES_PROP_STRING,
+  GESTURES_PROP_REAL
+};
+
+typedef struct GesturesPropDesc {
+  const char* name;
+  enum GesturesPropType type;
+  // As for the create functions above, by type: an int*, short*,
+  // GesturesPropBool*, const char** or double* to keep updated, and the
+  // initial value(s). For strings, |init| is the initial const char* itself
+  // and |count| is 1.
+  void* loc;
+  size_t count;
+  const void* init;
+  // Identifies the property to the written handler.
+  void* handler_data;
+} GesturesPropDesc;
+
+// Call after writing new values to the properties whose handler data is in
+// |handler_data|. All of them must belong to the same GestureInterpreter.
+// Values written together take effect together.
+typedef void (*GesturesPropsWrittenHandler)(void* const* handler_data,
+                                            size_t count);
+
+// Creates the |count| properties in |descs|, storing a handle to each in
+// |props| (NULL on failure). As with the create functions above, the
+// provider may write configured values to their locations before returning.
+typedef void (*GesturesPropCreateBulk)(void* data,
+                                       const GesturesPropDesc* descs,
+                                       size_t count,
+                                       GesturesProp** props,
+                                       GesturesPropsWrittenHandler written);
+
+// Frees |count| properties.
+typedef void (*GesturesPropFreeBulk)(void* data, GesturesProp* const* props,
+                                     size_t count);
+
+typedef struct GesturesBulkPropProvider {
+  GesturesPropCreateBulk create_fn;
+  GesturesPropFreeBulk free_fn;
+} GesturesBulkPropProvider;
+
 #ifdef __cplusplus
 // C++ API:
 
@@ -462,10 +539,21 @@ namespace gestures {
 
 class Interpreter;
 class PropRegistry;
+class BoolProperty;
+class DoubleProperty;
 class LoggingFilterInterpreter;
 class Tracer;
 class GestureInterpreterConsumer;
+class GestureRing;
 class MetricsProperties;
+class TimerScheduler;
+class TimerFdLoop;
+class EvdevFrontEnd;
+class SharedResources;
+class ConfigProfile;
+class ShadowStack;
+class StrandScheduler;
+class Strand;
 
 #if __cplusplus >= 201103L
 
@@ -481,8 +569,28 @@ struct GestureInterpreter {
 
   void set_callback(GestureReadyFunction callback,
                     void* client_data);
+  // Switches to pull-based delivery. A |capacity| of 0 switches back to
+  // calling the GestureReadyFunction.
+  void EnableGestureRing(size_t capacity, bool coalesce,
+                         GestureRingNotifyFunction notify,
+                         void* notify_data);
+  // Copies the oldest queued gesture into |out|. Returns false if there is
+  // none. May be called from a thread other than the interpreter's.
+  bool PollGesture(Gesture* out);
   void SetTimerProvider(GesturesTimerProvider* tp, void* data);
   void SetPropProvider(GesturesPropProvider* pp, void* data);
+  void SetBulkPropProvider(GesturesBulkPropProvider* pp, void* data);
+  // Read-only tables are taken from |resources| rather than built per
+  // instance. Must be called before Initialize(). Not owned.
+  void SetSharedResources(SharedResources* resources) {
+    shared_resources_ = resources;
+  }
+  // Initialize() applies the entries in |profile| for the device class and
+  // for |hwprops|, if not NULL, before the prop provider sees any property.
+  // Values the provider configures still take precedence. Not owned; must
+  // outlive calls to Initialize().
+  void SetConfigProfile(ConfigProfile* profile,
+                        const HardwareProperties* hwprops);
 
   // Initialize GestureInterpreter based on device configuration.  This must be
   // called after GesturesPropProvider is set and before it accepts any inputs.
@@ -493,27 +601,79 @@ struct GestureInterpreter {
   PropRegistry* prop_reg() const { return prop_reg_.get(); }
 
   std::string EncodeActivityLog();
+
+  // Number of frames dropped by the "Skip Idle Frames" mode.
+  size_t idle_frames_skipped() const { return idle_frames_skipped_; }
+
+  // Most fingers per frame passed down the chain; extra ones are dropped.
+  // Set from the device's HardwareProperties, up to the build's limit.
+  size_t contact_capacity() const { return contact_capacity_; }
+
+  // Fills in |out| and returns true if a shadow touchpad stack is running.
+  bool GetShadowStats(GesturesShadowStats* out);
  private:
-  void InitializeTouchpad(void);
-  void InitializeTouchpad2(void);
+  void ReadTouchpadStackVersions(int* version, int* shadow_version);
+  void InitializeTouchpad(int version, int shadow_version);
+  // Builds the touchpad stack of the given version on |prop_reg|.
+  Interpreter* NewTouchpadStack(int version, PropRegistry* prop_reg,
+                                Tracer* tracer);
+  Interpreter* NewTouchpadStack2(PropRegistry* prop_reg, Tracer* tracer);
   void InitializeMouse(void);
   void InitializeMultitouchMouse(void);
+  // (Re)arms or cancels interpret_timer_ if the earliest deadline in timers_
+  // differs from the one it's currently armed for.
+  void ArmTimer(stime_t now);
+  // True if |hwstate| repeats the last frame pushed, nothing is scheduled
+  // and the "Skip Idle Frames" mode is on, so the chain needn't see it.
+  bool IsIdleFrame(const HardwareState& hwstate) const;
+  // Runs interpreter_, and shadow_ alongside it if there is one.
+  void SyncInterpret(HardwareState* hwstate, stime_t* timeout);
+  void HandleTimer(stime_t now, stime_t* timeout);
 
   GestureReadyFunction callback_;
   void* callback_data_;
 
+  std::unique_ptr<GestureRing> ring_;
+  GestureRingNotifyFunction ring_notify_;
+  void* ring_notify_data_;
+
   std::unique_ptr<PropRegistry> prop_reg_;
   std::unique_ptr<Tracer> tracer_;
+  SharedResources* shared_resources_;
+  ConfigProfile* config_profile_;
+  // ConfigProfile::Fingerprint() of the device, or kAnyDevice if unknown.
+  unsigned config_fingerprint_;
+  // While fingers rest on the pad, drivers keep sending identical frames.
+  // If set, those are dropped as long as no timer is pending.
+  std::unique_ptr<BoolProperty> skip_idle_frames_;
+  // Longest time to go without passing a frame down the chain, even if idle.
+  std::unique_ptr<DoubleProperty> idle_frame_max_skip_;
   std::unique_ptr<Interpreter> interpreter_;
   std::unique_ptr<MetricsProperties> mprops_;
+  // Candidate stack fed the same input as interpreter_, if enabled.
+  std::unique_ptr<ShadowStack> shadow_;
 
   GesturesTimerProvider* timer_provider_;
   void* timer_provider_data_;
   GesturesTimer* interpret_timer_;
+  std::unique_ptr<TimerScheduler> timers_;
+  // Deadline interpret_timer_ is set for, or 0.0 if it isn't set.
+  stime_t armed_deadline_;
 
   LoggingFilterInterpreter* loggingFilter_;
   std::unique_ptr<GestureInterpreterConsumer> consumer_;
   HardwareProperties hwprops_;
+  size_t contact_capacity_;
+
+  // Copy of the last frame pushed, before the chain modified it. If
+  // idle_frame_pending_ is set, it's the last frame skipped and its
+  // timestamp is newer than last_interpreted_time_.
+  HardwareState prev_hwstate_;
+  std::unique_ptr<FingerState[]> prev_fingers_;
+  bool have_prev_hwstate_;
+  bool idle_frame_pending_;
+  stime_t last_interpreted_time_;
+  size_t idle_frames_skipped_;
 
   // Disallow copy & assign;
   GestureInterpreter(const GestureInterpreter&);
@@ -531,9 +691,27 @@ struct GestureInterpreter;
 }  // namespace gestures
 
 typedef gestures::GestureInterpreter GestureInterpreter;
+typedef gestures::TimerFdLoop GesturesTimerFdLoop;
+typedef gestures::EvdevFrontEnd GesturesEvdevFrontEnd;
+typedef gestures::SharedResources GesturesSharedResources;
+typedef gestures::ConfigProfile GesturesConfigProfile;
+typedef gestures::StrandScheduler GesturesStrandScheduler;
+typedef gestures::Strand GesturesStrand;
 #else
 struct GestureInterpreter;
 typedef struct GestureInterpreter GestureInterpreter;
+struct GesturesTimerFdLoop;
+typedef struct GesturesTimerFdLoop GesturesTimerFdLoop;
+struct GesturesEvdevFrontEnd;
+typedef struct GesturesEvdevFrontEnd GesturesEvdevFrontEnd;
+struct GesturesSharedResources;
+typedef struct GesturesSharedResources GesturesSharedResources;
+struct GesturesConfigProfile;
+typedef struct GesturesConfigProfile GesturesConfigProfile;
+struct GesturesStrandScheduler;
+typedef struct GesturesStrandScheduler GesturesStrandScheduler;
+struct GesturesStrand;
+typedef struct GesturesStrand GesturesStrand;
 #endif  // __cplusplus
 
 #define GESTURES_VERSION 1
@@ -552,6 +730,23 @@ void GestureInterpreterSetCallback(GestureInterpreter*,
                                    GestureReadyFunction,
                                    void*);
 
+// Pull-based gesture delivery. Once enabled, gestures are queued into a
+// bounded lock-free ring instead of being passed to the GestureReadyFunction
+// from inside PushHardwareState/TimerCallback, and the client drains them
+// from its own thread with GestureInterpreterPollGesture(). |notify|, if not
+// NULL, is called on the interpreter's thread when the ring goes from empty
+// to non-empty. If |coalesce| is non-zero, a Move or Scroll that follows an
+// unread gesture of the same type is merged into it rather than queued.
+// Pass a |capacity| of 0 to go back to the GestureReadyFunction.
+void GestureInterpreterEnableGestureRing(GestureInterpreter*,
+                                         size_t capacity,
+                                         int coalesce,
+                                         GestureRingNotifyFunction notify,
+                                         void* notify_data);
+
+// Returns non-zero and fills in |out| if a gesture was waiting in the ring.
+int GestureInterpreterPollGesture(GestureInterpreter*, struct Gesture* out);
+
 // Gestures will hold a reference to passed provider. Pass NULL to tell
 // Gestures to stop holding a reference.
 void GestureInterpreterSetTimerProvider(GestureInterpreter*,
@@ -562,9 +757,109 @@ void GestureInterpreterSetPropProvider(GestureInterpreter*,
                                        GesturesPropProvider*,
                                        void*);
 
+// Replaces any GesturesPropProvider. Pass NULL to stop holding a reference.
+void GestureInterpreterSetBulkPropProvider(GestureInterpreter*,
+                                           GesturesBulkPropProvider*,
+                                           void*);
+
+// For prop providers that write properties from a thread other than the
+// interpreter's. When |deferred| is non-zero, values written through the
+// provider are staged. They take effect together just before the next
+// hardware state or timer callback is handled, so no frame sees a
+// half-applied change. Call this before GestureInterpreterSetPropProvider().
+void GestureInterpreterSetDeferredProps(GestureInterpreter*, int deferred);
+// Writes between these two calls take effect together, even if a frame is
+// handled in the middle. The calls may be nested, and made from the
+// provider's thread.
+void GestureInterpreterBeginPropUpdate(GestureInterpreter*);
+void GestureInterpreterEndPropUpdate(GestureInterpreter*);
+
 void GestureInterpreterInitialize(GestureInterpreter*,
                                   enum GestureInterpreterDeviceClass);
 
+// Processes that run several GestureInterpreters can share one of these
+// between them, so that read-only data (acceleration curves, non-linearity
+// calibration) is built once rather than per device. Set it before calling
+// GestureInterpreterInitialize(). It may be deleted while interpreters that
+// used it are still alive.
+GesturesSharedResources* NewGesturesSharedResources(void);
+void DeleteGesturesSharedResources(GesturesSharedResources*);
+void GestureInterpreterSetSharedResources(GestureInterpreter*,
+                                          GesturesSharedResources*);
+
+// Precompiled per-device property values, memory-mapped from a file built
+// by gestures::ConfigProfileBuilder. Returns NULL if the file is missing or
+// invalid. One profile can serve many interpreters.
+GesturesConfigProfile* NewGesturesConfigProfile(const char* path);
+void DeleteGesturesConfigProfile(GesturesConfigProfile*);
+// Call before GestureInterpreterInitialize(), which applies the profile's
+// entries for the device class and, if |hwprops| isn't NULL, for that
+// device. Values the prop provider configures still take precedence.
+void GestureInterpreterSetConfigProfile(GestureInterpreter*,
+                                        GesturesConfigProfile*,
+                                        const struct HardwareProperties*);
+
+// A ready-made timer provider for Linux, built on CLOCK_MONOTONIC timerfds
+// and epoll. Pass the loop as the provider data:
+//   GestureInterpreterSetTimerProvider(gi, GesturesTimerFdLoopProvider(),
+//                                      loop);
+// and call GesturesTimerFdLoopDispatch() whenever GesturesTimerFdLoopFd() is
+// readable (or just in a loop). Returns NULL on failure.
+GesturesTimerFdLoop* NewGesturesTimerFdLoop(void);
+void DeleteGesturesTimerFdLoop(GesturesTimerFdLoop*);
+GesturesTimerProvider* GesturesTimerFdLoopProvider(void);
+int GesturesTimerFdLoopFd(GesturesTimerFdLoop*);
+// Lets timers fire up to |slack| seconds late so that wakeups coalesce.
+void GesturesTimerFdLoopSetSlack(GesturesTimerFdLoop*, stime_t slack);
+// Returns non-zero on success.
+int GesturesTimerFdLoopWatchFd(GesturesTimerFdLoop*, int fd,
+                               GesturesFdCallback callback, void* data);
+void GesturesTimerFdLoopUnwatchFd(GesturesTimerFdLoop*, int fd);
+// Waits up to |timeout_ms| (-1 for forever) and runs ready callbacks.
+// Returns the number of callbacks run, or -1 on error.
+int GesturesTimerFdLoopDispatch(GesturesTimerFdLoop*, int timeout_ms);
+
+// Reads evdev events (multitouch protocol B) from an fd and pushes the
+// resulting HardwareStates into a GestureInterpreter, tracking slots so the
+// client doesn't have to. |hwprops| must describe the device.
+GesturesEvdevFrontEnd* NewGesturesEvdevFrontEnd(
+    const struct HardwareProperties* hwprops);
+void DeleteGesturesEvdevFrontEnd(GesturesEvdevFrontEnd*);
+// Does one read() from |fd|. Returns the number of events processed, 0 if
+// nothing was read (EOF or EAGAIN), or -1 on error.
+int GesturesEvdevFrontEndRead(GesturesEvdevFrontEnd*, int fd,
+                              GestureInterpreter*);
+
+// Services many GestureInterpreters from a pool of |thread_count| threads
+// (0 for one per CPU). Give each interpreter its own strand, and only call
+// into it through that strand once it is running: tasks on one strand run
+// in order and never concurrently, while different strands run in parallel.
+// Deleting the scheduler runs whatever is already queued first.
+GesturesStrandScheduler* NewGesturesStrandScheduler(size_t thread_count);
+void DeleteGesturesStrandScheduler(GesturesStrandScheduler*);
+// The strand belongs to the scheduler and is freed with it.
+GesturesStrand* GesturesStrandSchedulerNewStrand(GesturesStrandScheduler*);
+// Blocks until every queued task has run. Don't call it from a task.
+void GesturesStrandSchedulerWaitIdle(GesturesStrandScheduler*);
+void GesturesStrandPost(GesturesStrand*, GesturesTaskFunction task,
+                        void* data);
+// Copies |hwstate| and pushes the copy into |gi| on the strand.
+void GesturesStrandPushHardwareState(GesturesStrand*, GestureInterpreter* gi,
+                                     const struct HardwareState* hwstate);
+// Makes |gi| use |tp| for its timers, with the callbacks delivered on the
+// strand. |tp| must be safe to call from the scheduler's threads. Call this
+// before posting anything for |gi|.
+void GesturesStrandSetTimerProvider(GesturesStrand*, GestureInterpreter* gi,
+                                    GesturesTimerProvider* tp, void* tp_data);
+
+// If the "Shadow Touchpad Stack Version" property was non-zero when the
+// interpreter was initialized, that version of the touchpad stack runs on a
+// thread of its own, fed copies of the same input. Only gestures from the
+// regular stack are delivered. Returns non-zero and fills in |out| if such a
+// shadow stack is running.
+int GestureInterpreterGetShadowStats(GestureInterpreter*,
+                                     GesturesShadowStats* out);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,65 @@
+// Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef GESTURES_HARDWARE_STATE_BUFFER_H_
+#define GESTURES_HARDWARE_STATE_BUFFER_H_
+
+#include <memory>
+
+#include "gestures/include/gestures.h"
+#include "gestures/include/macros.h"
+
+namespace gestures {
+
+// A ring of the most recent frames an interpreter has seen, for the
+// interpreters that look back at earlier frames. Frames are deep copied
+// into storage allocated by Reset(), so pushing a frame never allocates.
+// Callers look frames and fingers up by age (0 is the newest frame) and
+// get pointers into the ring rather than copies.
+class HardwareStateBuffer {
+ public:
+  explicit HardwareStateBuffer(size_t size);
+  ~HardwareStateBuffer() {}
+
+  size_t Size() const { return size_; }
+  // Number of frames pushed since the last Reset(), up to Size()
+  size_t Depth() const { return depth_; }
+
+  // Makes room for |max_finger_cnt| fingers in each frame, and forgets all
+  // frames. With no room for fingers, Get(idx)->fingers is NULL.
+  void Reset(size_t max_finger_cnt);
+
+  // Does a deep copy of state into states_
+  void PushState(const HardwareState& state);
+  // Pops most recently pushed state
+  void PopState();
+
+  const HardwareState* Get(size_t idx) const {
+    return &states_[(idx + newest_index_) % size_];
+  }
+
+  HardwareState* Get(size_t idx) {
+    return const_cast<HardwareState*>(
+        const_cast<const HardwareStateBuffer*>(this)->Get(idx));
+  }
+
+  // Returns the finger with |tracking_id| in the frame |age| frames old, or
+  // NULL if there's no such frame or finger.
+  const FingerState* GetFinger(size_t age, short tracking_id) const {
+    return age < depth_ ? Get(age)->GetFingerState(tracking_id) : NULL;
+  }
+
+ private:
+  std::unique_ptr<HardwareState[]> states_;
+  std::unique_ptr<FingerState[]> fingers_;  // Storage for every frame
+  size_t newest_index_;
+  size_t size_;
+  size_t depth_;
+  size_t max_finger_cnt_;
+  DISALLOW_COPY_AND_ASSIGN(HardwareStateBuffer);
+};
+
+}  // namespace gestures
+
+#endif  // GESTURES_HARDWARE_STATE_BUFFER_H_
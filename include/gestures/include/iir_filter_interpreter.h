@@ -20,52 +20,17 @@ namespace gestures {
 // filter to each incoming finger. The default filter is a low-pass 2nd order
 // Butterworth IIR filter with a normalized cutoff frequency of 0.2. It can be
 // configured via properties to use other formulae or
-// different coefficients for the Butterworth filter.
+// different coefficients for the Butterworth filter, and extended with a
+// cascade of biquad sections for stronger smoothing at high report rates.
+//
+// Filter state is kept in structure-of-arrays form: one float lane per
+// finger slot and filtered field, so each stage of the cascade runs over all
+// fingers in a single loop the compiler can vectorize.
 
 class IirFilterInterpreter : public FilterInterpreter, public PropertyDelegate {
+  FRIEND_TEST(IirFilterInterpreterTest, CascadeTest);
   FRIEND_TEST(IirFilterInterpreterTest, DisableIIRTest);
  public:
-  // We'll maintain one IOHistory record per active finger
-  class IoHistory {
-   public:
-    IoHistory() : in_head(0), out_head(0) {}
-    explicit IoHistory(const FingerState& fs) : in_head(0), out_head(0) {
-      for (size_t i = 0; i < kInSize; i++)
-        in[i] = fs;
-      for (size_t i = 0; i < kOutSize; i++)
-        out[i] = fs;
-    }
-    // Note: NextOut() and the oldest PrevOut() point to the same object.
-    FingerState* NextOut() { return &out[NextOutHead()]; }
-    FingerState* PrevOut(size_t idx) {
-      return &out[(out_head + idx) % kOutSize];
-    }
-    // Note: NextIn() and the oldest PrevIn() point to the same object.
-    FingerState* NextIn() { return &in[NextInHead()]; }
-    FingerState* PrevIn(size_t idx) { return &in[(in_head + idx) % kInSize]; }
-    void Increment();
-
-    bool operator==(const IoHistory& that) const;
-    bool operator!=(const IoHistory& that) const { return !(*this == that); }
-
-    void WarpBy(float dx, float dy);
-
-   private:
-    size_t NextOutHead() const {
-      return (out_head + kOutSize - 1) % kOutSize;
-    }
-    size_t NextInHead() const {
-      return (in_head + kInSize - 1) % kInSize;
-    }
-
-    static const size_t kInSize = 3;
-    static const size_t kOutSize = 2;
-    FingerState in[kInSize];  // previous input values
-    size_t in_head;
-    FingerState out[kOutSize];  // previous output values
-    size_t out_head;
-  };
-
   // Takes ownership of |next|:
   IirFilterInterpreter(PropRegistry* prop_reg, Interpreter* next,
                        Tracer* tracer);
@@ -76,14 +41,62 @@ class IirFilterInterpreter : public FilterInterpreter, public PropertyDelegate {
 
  public:
   virtual void DoubleWasWritten(DoubleProperty* prop);
+  virtual void DoubleArrayWasWritten(DoubleArrayProperty* prop);
+  virtual void IntWasWritten(IntProperty* prop);
 
  private:
-  map<short, IoHistory, kMaxFingers> histories_;
-  
-  // y[0] = b[0]*x[0] + b[1]*x[1] + b[2]*x[2] + b[3]*x[3]
-  //        - (a[1]*y[1] + a[2]*y[2])
+  // The fields filtered for each finger
+  enum Channel { kChannelX, kChannelY, kChannelPressure, kNumChannels };
+  static const size_t kMaxLanes = kMaxFingers * kNumChannels;
+  static const size_t kMaxCascadeStages = 4;
+  // The main filter, then the cascade
+  static const size_t kMaxStages = kMaxCascadeStages + 1;
+
+  // y[0] = b0*x[0] + b1*x[1] + b2*x[2] + b3*x[3] - (a1*y[1] + a2*y[2])
+  struct Coefficients {
+    float b0, b1, b2, b3, a1, a2;
+  };
+  // Previous inputs and outputs of one stage for every lane
+  struct StageState {
+    float in1[kMaxLanes], in2[kMaxLanes], in3[kMaxLanes];
+    float out1[kMaxLanes], out2[kMaxLanes];
+  };
+
+  static size_t Lane(size_t slot, size_t channel) {
+    return slot * kNumChannels + channel;
+  }
+  // Reads the coefficients from the properties, and forgets all fingers.
+  void UpdateCoefficients();
+  // Runs |stage| on the first |lanes| of values_, in place.
+  void RunStage(size_t stage, size_t lanes);
+  // Sets the history of every stage for |lane| as if it had steadily been
+  // given |value|.
+  void ResetLane(size_t lane, float value);
+  // Overrides the latest output of the cascade for |lane| with |value|.
+  void SetLaneOutput(size_t lane, float value);
+  // Shifts the history of |lane| by |delta|.
+  void WarpLane(size_t lane, float delta);
+
+  Coefficients coeffs_[kMaxStages];
+  size_t num_stages_;
+  StageState state_[kMaxStages];
+  // The input to, and then output from, the cascade for this frame
+  float values_[kMaxLanes];
+
+  // Slot of each finger, by tracking id
+  typedef map<short, size_t, kMaxFingers> FingerSlotMap;
+  FingerSlotMap slots_;
+  bool slot_used_[kMaxFingers];
+
   DoubleProperty b0_, b1_, b2_, b3_, a1_, a2_;
 
+  // Biquad sections run after the filter above, each given as b0, b1, b2,
+  // a1, a2 (normalized so that a0 is 1). Only the first
+  // iir_cascade_stages_ are used.
+  double cascade_coeffs_[5 * kMaxCascadeStages];
+  DoubleArrayProperty cascade_coeffs_prop_;
+  IntProperty iir_cascade_stages_;
+
   // If position change between 2 frames is less than iir_dist_thresh_,
   // IIR filter is applied, otherwise rolling average is applied.
   DoubleProperty iir_dist_thresh_;
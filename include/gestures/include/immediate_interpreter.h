@@ -6,6 +6,7 @@
 
 #include "gestures/include/finger_metrics.h"
 #include "gestures/include/gestures.h"
+#include "gestures/include/hardware_state_buffer.h"
 #include "gestures/include/interpreter.h"
 #include "gestures/include/macros.h"
 #include "gestures/include/prop_registry.h"
@@ -109,39 +110,6 @@ class ScrollEventBuffer {
   DISALLOW_COPY_AND_ASSIGN(ScrollEventBuffer);
 };
 
-// Circular buffer for storing a rolling backlog of events for analysis
-// as well as accessor functions for using the buffer's contents.
-class HardwareStateBuffer {
- public:
-  explicit HardwareStateBuffer(size_t size);
-  ~HardwareStateBuffer();
-
-  size_t Size() const { return size_; }
-
-  void Reset(size_t max_finger_cnt);
-
-  // Does a deep copy of state into states_
-  void PushState(const HardwareState& state);
-  // Pops most recently pushed state
-  void PopState();
-
-  const HardwareState* Get(size_t idx) const {
-    return &states_[(idx + newest_index_) % size_];
-  }
-
-  HardwareState* Get(size_t idx) {
-    return const_cast<HardwareState*>(
-        const_cast<const HardwareStateBuffer*>(this)->Get(idx));
-  }
-
- private:
-  std::unique_ptr<HardwareState[]> states_;
-  size_t newest_index_;
-  size_t size_;
-  size_t max_finger_cnt_;
-  DISALLOW_COPY_AND_ASSIGN(HardwareStateBuffer);
-};
-
 // Helper class for compute scroll and fling.
 class ScrollManager {
   FRIEND_TEST(ImmediateInterpreterTest, FlingDepthTest);
@@ -459,7 +427,7 @@ class ImmediateInterpreter : public Interpreter, public PropertyDelegate {
   // The sort first finds the two closes points and includes them first.
   // Then, it finds the point closest to any included point, repeating until
   // all points are included.
-  static void SortFingersByProximity(
+  void SortFingersByProximity(
       const FingerMap& finger_ids,
       const HardwareState& hwstate,
       vector<short, kMaxGesturingFingers>* out_sorted_ids);
@@ -2,11 +2,13 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <memory>
 #include <string>
 
 #include <gtest/gtest.h>
 
 #include "gestures/include/activity_log.h"
+#include "gestures/include/frame_geometry.h"
 #include "gestures/include/gestures.h"
 #include "gestures/include/prop_registry.h"
 #include "gestures/include/tracer.h"
@@ -72,6 +74,9 @@ class Interpreter {
   virtual void ProduceGesture(const Gesture& gesture);
   const char* name() const { return name_; }
 
+  // Per-frame finger geometry, shared with the rest of the chain
+  const std::shared_ptr<FrameGeometry>& geometry() const { return geometry_; }
+
  protected:
   std::unique_ptr<ActivityLog> log_;
   GestureConsumer* consumer_;
@@ -80,6 +85,7 @@ class Interpreter {
   std::unique_ptr<Metrics> own_metrics_;
   bool requires_metrics_;
   bool initialized_;
+  std::shared_ptr<FrameGeometry> geometry_;
 
   void InitName();
   void Trace(const char* message, const char* name);
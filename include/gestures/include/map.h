@@ -8,6 +8,7 @@
 #include <utility>
 
 #include "gestures/include/set.h"
+#include "gestures/include/vector.h"
 
 // This is a map class that doesn't call out to malloc/free. Many of the
 // names were chosen to mirror std::map.
@@ -16,6 +17,8 @@
 // of elements that such a set can hold. Internally, it contains an array
 // of Key and Data objects.
 
+// Lookups by tracking id (short keys) are O(1); see KeyIndex.
+
 // Differences from std::map:
 // - Many methods are unimplemented
 // - insert()/erase() invalidate existing iterators
@@ -33,9 +36,8 @@ class map {
   template<typename KeyT, typename DataT, size_t kThatSize>
   friend class map;
 
-  typedef std::pair<Key, Data> SetElt;
-  typedef typename set<SetElt, kMaxSize>::iterator SetIter;
-  typedef typename set<SetElt, kMaxSize>::const_iterator SetConstIter;
+  typedef std::pair<Key, Data> Elt;
+  typedef typename vector<Elt, kMaxSize>::iterator EltIter;
  public:
   typedef std::pair<const Key, Data> value_type;
   typedef value_type* iterator;
@@ -45,20 +47,16 @@ class map {
   map(const map<Key, Data, kMaxSize>& that) { *this = that; }
 
   const_iterator begin() const {
-    return reinterpret_cast<const_iterator>(set_.begin());
+    return reinterpret_cast<const_iterator>(elts_.begin());
   }
   const_iterator end() const {
-    return reinterpret_cast<const_iterator>(set_.end());
+    return reinterpret_cast<const_iterator>(elts_.end());
   }
   const_iterator find(const Key& key) const {
-    SetConstIter it = set_.begin();
-    for (SetConstIter e = set_.end(); it != e; ++it)
-      if ((*it).first == key)
-        break;
-    return reinterpret_cast<const_iterator>(it);
+    return begin() + index_.Find(key, elts_.begin(), size());
   }
-  size_t size() const { return set_.size(); }
-  bool empty() const { return set_.empty(); }
+  size_t size() const { return elts_.size(); }
+  bool empty() const { return elts_.empty(); }
   // Non-const versions:
   iterator begin() {
     return const_cast<iterator>(
@@ -80,10 +78,11 @@ class map {
       (*it).second = value.second;
       return std::make_pair(it, false);
     }
-    std::pair<SetIter, bool> rc = set_.insert(value);
-    std::pair<iterator, bool> ret(
-        reinterpret_cast<iterator>(rc.first), rc.second);
-    return ret;
+    EltIter added = elts_.insert(elts_.end(), value);
+    if (added == elts_.end())
+      return std::make_pair(end(), false);
+    index_.Add(value.first, size() - 1);
+    return std::make_pair(reinterpret_cast<iterator>(added), true);
   }
 
   // Returns number of elements removed (0 or 1).
@@ -96,27 +95,29 @@ class map {
     return 1;
   }
   void erase(iterator it) {
-    set_.erase(reinterpret_cast<SetIter>(it));
+    elts_.erase(reinterpret_cast<EltIter>(it));
+    index_.Rebuild(elts_.begin(), size());
+  }
+  void clear() {
+    elts_.clear();
+    index_.Clear();
   }
-  void clear() { set_.clear(); }
 
   template<size_t kThatSize>
   map<Key, Data, kMaxSize>& operator=(const map<Key, Data, kThatSize>& that) {
-    set_ = that.set_;
+    elts_ = that.elts_;
+    index_.Rebuild(elts_.begin(), size());
     return *this;
   }
 
   Data& operator[](const Key& key) {
     iterator it = find(key);
     if (it == end()) {
-      if (set_.size() == kMaxSize) {
+      if (size() == kMaxSize) {
         Err("map::operator[]: out of space!");
         return (*--it).second;
       }
-      SetElt vt = std::make_pair(key, Data());
-      std::pair<SetIter, bool> pr;
-      pr = set_.insert(vt);
-      return (*(pr.first)).second;
+      return (*insert(std::make_pair(key, Data())).first).second;
     }
     return (*it).second;
   }
@@ -126,13 +127,23 @@ class map {
   }
 
  private:
-  set<SetElt, kMaxSize> set_;
+  vector<Elt, kMaxSize> elts_;
+  KeyIndex<Key, kMaxSize> index_;
 };
 
 template<typename Key, typename Data, size_t kLeftMaxSize, size_t kRightMaxSize>
 inline bool operator==(const map<Key, Data, kLeftMaxSize>& left,
                        const map<Key, Data, kRightMaxSize>& right) {
-  return left.set_ == right.set_;
+  if (left.size() != right.size())
+    return false;
+  for (typename map<Key, Data, kLeftMaxSize>::const_iterator it = left.begin(),
+           e = left.end(); it != e; ++it) {
+    typename map<Key, Data, kRightMaxSize>::const_iterator found =
+        right.find(it->first);
+    if (found == right.end() || !(found->second == it->second))
+      return false;
+  }
+  return true;
 }
 template<typename Key, typename Data, size_t kLeftMaxSize, size_t kRightMaxSize>
 inline bool operator!=(const map<Key, Data, kLeftMaxSize>& left,
@@ -2,11 +2,14 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <stdint.h>
+
 #include <gtest/gtest.h>  // for FRIEND_TEST
 
 #include "gestures/include/filter_interpreter.h"
 #include "gestures/include/gestures.h"
 #include "gestures/include/prop_registry.h"
+#include "gestures/include/shared_resources.h"
 #include "gestures/include/tracer.h"
 
 #ifndef GESTURES_NON_LINEARITY_FILTER_INTERPRETER_H_
@@ -30,7 +33,12 @@ namespace gestures {
 // The error matrix will have an entry for each value in the cross product of
 // the three range arrays.
 //
-// File format:
+// Files in the compiled format (see DataHeader) are memory-mapped and used in
+// place, so every instance on the machine shares one copy. Files in the
+// original format, described below, are converted when they are loaded;
+// tools/convert_non_linearity_data.py compiles them ahead of time.
+//
+// Original file format:
 //      X Range Array
 //      Y Range Array
 //      P Range Array
@@ -47,59 +55,124 @@ namespace gestures {
 //          8 bytes: Double x error
 //          8 bytes: Double y error
 //
-// Currently, this only handles the situation where exactly 1 finger is on the
-// touchpad at a time.  There may be interactions between multiple contacts
-// that this doesn't take into consideration, so it simply skips hwstates with
-// more than 1 finger.
+// Each finger is corrected on its own, so interactions between multiple
+// contacts aren't taken into consideration.
 
-class NonLinearityFilterInterpreter : public FilterInterpreter {
+class NonLinearityFilterInterpreter : public FilterInterpreter,
+                                      public PropertyDelegate {
+  FRIEND_TEST(NonLinearityFilterInterpreterTest, AxisFindTest);
+  FRIEND_TEST(NonLinearityFilterInterpreterTest, CompiledDataTest);
   FRIEND_TEST(NonLinearityFilterInterpreterTest, DisablingTest);
   FRIEND_TEST(NonLinearityFilterInterpreterTest, HWstateModificationTest);
   FRIEND_TEST(NonLinearityFilterInterpreterTest, HWstateNoChangesNeededTest);
+  FRIEND_TEST(NonLinearityFilterInterpreterTest, SharedGridTest);
  public:
+  // Header of a compiled data file, in little-endian byte order. It's
+  // followed by the payload, all 4-byte floats:
+  //
+  //   x_len X points, y_len Y points, p_len P points
+  //   x_len * y_len * p_len (x error, y error) pairs, in x, y, p order
+  static const uint32_t kDataMagic = 0x444c4e47;  // "GNLD"
+  static const uint32_t kDataVersion = 1;
+  struct DataHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;  // of the whole file
+    uint32_t x_len;
+    uint32_t y_len;
+    uint32_t p_len;
+    uint32_t checksum;  // FNV-1a of the payload
+    uint32_t reserved;
+  };
+
+  // If |resources| is given, calibration data is shared with other
+  // instances that load the same file.
   NonLinearityFilterInterpreter(PropRegistry* prop_reg, Interpreter* next,
-                           Tracer* tracer);
+                                Tracer* tracer,
+                                SharedResources* resources = NULL);
+
+  virtual void StringWasWritten(StringProperty* prop);
 
  protected:
   virtual void SyncInterpretImpl(HardwareState* hwstate, stime_t* timeout);
 
  private:
   struct Error {
-    double x_error;
-    double y_error;
+    float x_error;
+    float y_error;
+  };
+  // The points along one axis where the error was sampled, in increasing
+  // order, and what's needed to find the ones around a value quickly.
+  struct Axis {
+    Axis() : points(NULL), len(0), uniform(false), origin(0.0),
+             inv_step(0.0) {}
+    // Sets up the lookup once the points are loaded. Returns false if they
+    // aren't increasing.
+    bool Prepare();
+    // Finds the cell holding |value|, such that points[*lo] <= value <
+    // points[*lo + 1], and how far across it |value| is. Returns false if
+    // |value| is outside the sampled range.
+    bool Find(float value, size_t* lo, float* frac) const;
+
+    const float* points;
+    size_t len;
+    // If the points are evenly spaced, cells are found by direct indexing
+    // rather than a binary search.
+    bool uniform;
+    double origin;
+    double inv_step;
   };
-  struct Bounds {
-    ssize_t lo;
-    ssize_t hi;
+  // Calibration data, as loaded from the data file. Read-only once loaded.
+  struct Grid {
+    Grid() : err(NULL), mapped(NULL), mapped_size(0) {}
+    ~Grid();
+
+    // Points the axes and errors into |payload|, laid out as in a compiled
+    // file with the given dimensions. Returns false if an axis is invalid.
+    bool SetPayload(const float* payload, size_t x_len, size_t y_len,
+                    size_t p_len);
+
+    // The error readings are stored in a flattened matrix, this finds the 1d
+    // index corresponding to the point (x_index, y_index, p_index)
+    size_t ErrorIndex(size_t x_index, size_t y_index, size_t p_index) const {
+      return (x_index * y.len + y_index) * p.len + p_index;
+    }
+
+    // There is a reading in err for each point formed by the cross product
+    // of these axes.
+    Axis x, y, p;
+    // A flattened 3-d array holding the actual sampled error values
+    const Error* err;
+    // Offsets from the low corner of a cell to each of its 8 corners, in
+    // the order GetError() weights them.
+    size_t corner_offsets[8];
+
+    // Holds the payload: either a mapped compiled file, or data converted
+    // from the original format.
+    const char* mapped;
+    size_t mapped_size;
+    std::unique_ptr<float[]> converted;
   };
 
-  // The error readings are stored in a flattened matrix, this finds the 1d
-  // index corresponding to the point (x_index, y_index, p_index)
-  unsigned int ErrorIndex(size_t x_index, size_t y_index, size_t p_index) const;
-  // Find the two values in the range on either side of "value" to interpolate
-  Bounds FindBounds(float value, const std::unique_ptr<double[]>& range,
-                           size_t len) const;
   // Given a point (x, y, p) calculate the non-linearity error that needs to be
   // compensated for at that point.
   Error GetError(float finger_x, float finger_y, float finger_p) const;
-  // Interpolate linearly between p1 and p2, according to percent_p1
-  Error LinearInterpolate(const Error& p1, const Error& p2,
-                          float percent_p1) const;
-  // Load nonlinearity data from disk and parse it
+  // Load nonlinearity data from disk (or resources_) and parse it
   void LoadData();
-  // Parse only a range array from the binary data
-  bool LoadRange(std::unique_ptr<double[]>& arr, size_t& len, FILE* fd);
-  int ReadObject(void* buf, size_t object_size, FILE* fd);
+  // Loads the file at |path| (a const char*). Returns NULL on failure.
+  static Grid* NewGrid(void* path);
+  // Use a mapped file in each of the formats. Return false if it's invalid.
+  static bool UseCompiledData(Grid* grid, const char* data, size_t size);
+  static bool ConvertOriginalData(Grid* grid, const char* data, size_t size);
+  static uint32_t Checksum(const char* data, size_t size);
+
+  // Before the properties, since data_location_ may load the data as soon
+  // as it is constructed.
+  SharedResources* resources_;
+  std::shared_ptr<const Grid> grid_;
 
   BoolProperty enabled_;
   StringProperty data_location_;
-  // These three arrays define the points where the error was sampled.
-  // There is a reading in err_ for each point formed by the cross product
-  // of these arrays.
-  std::unique_ptr<double[]> x_range_, y_range_, p_range_;
-  size_t x_range_len_, y_range_len_, p_range_len_;
-  // A flattened 3-d array holding the actual sampled error values
-  std::unique_ptr<Error[]> err_;
 };
 
 }  // namespace gestures
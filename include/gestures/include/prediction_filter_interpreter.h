@@ -0,0 +1,87 @@
+// Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>  // for FRIEND_TEST
+
+#include "gestures/include/filter_interpreter.h"
+#include "gestures/include/finger_metrics.h"
+#include "gestures/include/gestures.h"
+#include "gestures/include/macros.h"
+#include "gestures/include/map.h"
+#include "gestures/include/prop_registry.h"
+#include "gestures/include/tracer.h"
+
+#ifndef GESTURES_PREDICTION_FILTER_INTERPRETER_H_
+#define GESTURES_PREDICTION_FILTER_INTERPRETER_H_
+
+namespace gestures {
+
+// This interpreter moves each finger ahead to where it's expected to be a
+// short time (the horizon) later, to make up for the lag that the lookahead
+// and IIR filters add.
+//
+// Each finger's position and velocity are tracked with an alpha-beta filter,
+// the steady-state form of a Kalman filter for a constant-velocity model:
+//
+//   predicted = position + velocity * dt
+//   residual  = measured - predicted
+//   position  = predicted + alpha * residual
+//   velocity  = velocity + beta * residual / dt
+//
+// The output is the measured position plus velocity * horizon, so each new
+// frame starts again from real data and a bad prediction isn't carried
+// forward. The lead is limited in length, and dropped for slow fingers,
+// where it would mostly amplify noise. When the lead shrinks by more than
+// the finger moved, e.g. because the finger stopped, the output would move
+// back against the finger; that axis is warped instead, so the correction
+// isn't seen as movement.
+
+class PredictionFilterInterpreter : public FilterInterpreter {
+  FRIEND_TEST(PredictionFilterInterpreterTest, ConstantVelocityTest);
+ public:
+  // Takes ownership of |next|:
+  PredictionFilterInterpreter(PropRegistry* prop_reg, Interpreter* next,
+                              Tracer* tracer);
+  virtual ~PredictionFilterInterpreter() {}
+
+ protected:
+  virtual void SyncInterpretImpl(HardwareState* hwstate, stime_t* timeout);
+
+ private:
+  struct FingerPrediction {
+    stime_t timestamp;  // of the last frame
+    Vector2 measured;  // last measured position
+    Vector2 position;  // filtered position
+    Vector2 velocity;  // filtered velocity, mm/s
+    Vector2 lead;  // added to the measured position in the last frame
+  };
+
+  // Starts tracking |fs| over, without moving it.
+  static void ResetFinger(const FingerState& fs, stime_t timestamp,
+                          FingerPrediction* pred);
+  // Updates |pred| with |fs| and moves |fs| ahead.
+  void PredictFinger(stime_t timestamp, FingerState* fs,
+                     FingerPrediction* pred);
+
+  map<short, FingerPrediction, kMaxFingers> predictions_;
+
+  BoolProperty enabled_;
+  // How far ahead to predict, in seconds
+  DoubleProperty horizon_;
+  // Longest lead, in mm
+  DoubleProperty max_lead_;
+  // Fingers slower than this, in mm/s, aren't moved
+  DoubleProperty min_speed_;
+  // Gains of the alpha-beta filter
+  DoubleProperty alpha_;
+  DoubleProperty beta_;
+  // A gap between frames longer than this, in seconds, starts a finger over
+  DoubleProperty max_interval_;
+
+  DISALLOW_COPY_AND_ASSIGN(PredictionFilterInterpreter);
+};
+
+}  // namespace gestures
+
+#endif  // GESTURES_PREDICTION_FILTER_INTERPRETER_H_
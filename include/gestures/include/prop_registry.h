@@ -5,8 +5,14 @@
 #ifndef GESTURES_PROP_REGISTRY_H__
 #define GESTURES_PROP_REGISTRY_H__
 
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <set>
 #include <string>
+#include <string.h>
+#include <unordered_map>
+#include <vector>
 
 #include <json/value.h>
 
@@ -20,26 +26,116 @@ class Property;
 
 class PropRegistry {
  public:
-  PropRegistry() : prop_provider_(NULL), activity_log_(NULL) {}
+  PropRegistry()
+      : prop_provider_(NULL),
+        bulk_provider_(NULL),
+        activity_log_(NULL),
+        holding_creation_(false),
+        deferred_(false),
+        holds_(0),
+        ready_(false),
+        epoch_(0) {}
 
   void Register(Property* prop);
   void Unregister(Property* prop);
 
+  // Setting either kind of provider replaces the other.
   void SetPropProvider(GesturesPropProvider* prop_provider, void* data);
+  void SetBulkPropProvider(GesturesBulkPropProvider* bulk_provider,
+                           void* data);
   GesturesPropProvider* PropProvider() const { return prop_provider_; }
+  GesturesBulkPropProvider* BulkPropProvider() const { return bulk_provider_; }
   void* PropProviderData() const { return prop_provider_data_; }
-  const std::set<Property*>& props() const { return props_; }
+  // In the order they were registered.
+  const std::vector<Property*>& props() const { return props_; }
+  // Returns the property called |name|, or NULL if there is none. If two
+  // have the same name (e.g. while an interpreter chain is being replaced),
+  // returns the one registered first.
+  Property* GetProperty(const char* name) const;
 
   void set_activity_log(ActivityLog* activity_log) {
     activity_log_ = activity_log;
   }
   ActivityLog* activity_log() const { return activity_log_; }
 
+  // Until CreateHeldProps(), properties registered aren't created with the
+  // prop provider. Ones unregistered before then never reach it at all.
+  // Lets a whole interpreter chain be built (or rebuilt, replacing the old
+  // one) before the provider sees any of its properties. Since values the
+  // provider configures only arrive afterwards, properties that something
+  // derives state from at construction need a delegate.
+  void HoldCreation();
+  void CreateHeldProps();
+
+  // If set, values written through the prop provider don't take effect
+  // right away. Each write is staged, and the next Commit() applies all
+  // staged values at once. This lets the provider run on its own thread
+  // while the interpreters see a consistent set of values for each frame.
+  // Must be set before the prop provider.
+  void SetDeferred(bool deferred);
+  bool deferred() const { return deferred_; }
+  // Commit() holds back staged values until the matching EndUpdate(), so
+  // that changes to several properties take effect together. May be called
+  // from the provider's thread.
+  void BeginUpdate();
+  void EndUpdate();
+  // Applies staged values, then calls their written handlers. If there are
+  // none, this is a single atomic load. Call it between frames, on the
+  // interpreters' thread.
+  void Commit();
+  // Bumped by each Commit() that applied something. Data derived from
+  // properties can be recomputed when this changes, not on every read.
+  unsigned epoch() const { return epoch_; }
+
  private:
+  friend class Property;
+
+  bool has_provider() const { return prop_provider_ || bulk_provider_; }
+  void ReplaceProvider(GesturesPropProvider* prop_provider,
+                       GesturesBulkPropProvider* bulk_provider,
+                       void* data);
+  // Creates |props| with the provider: in one call to a bulk provider, or
+  // one at a time otherwise. Then tells delegates of the ones whose value
+  // the provider changed.
+  void CreateProps(Property* const* props, size_t count);
+  void CreateUncreatedProps();
+  GesturesProp* CreateWithPropProvider(const GesturesPropDesc& desc);
+  void DestroyProps(Property* const* props, size_t count);
+
+  // On the provider's thread, after it has written |prop|.
+  void Stage(Property* prop);
+
+  // Keys are the properties' own names, so they live as long as the entry.
+  struct NameHash {
+    size_t operator()(const char* name) const;
+  };
+  struct NameEqual {
+    bool operator()(const char* a, const char* b) const {
+      return strcmp(a, b) == 0;
+    }
+  };
+  typedef std::unordered_map<const char*, Property*, NameHash, NameEqual>
+      NameMap;
+
   GesturesPropProvider* prop_provider_;
+  GesturesBulkPropProvider* bulk_provider_;
+  // For either kind of provider
   void* prop_provider_data_;
-  std::set<Property*> props_;
+  std::vector<Property*> props_;
+  NameMap by_name_;
   ActivityLog* activity_log_;
+  bool holding_creation_;
+  bool deferred_;
+
+  // Guards the members below it, except epoch_.
+  std::mutex lock_;
+  // Properties with a staged value not yet committed.
+  std::vector<Property*> written_;
+  int holds_;
+  // Set when written_ is non-empty and no update is open.
+  std::atomic<bool> ready_;
+  // Only changed by Commit(), on the interpreters' thread.
+  unsigned epoch_;
 };
 
 class PropertyDelegate;
@@ -47,20 +143,27 @@ class PropertyDelegate;
 class Property {
  public:
   Property(PropRegistry* parent, const char* name)
-      : gprop_(NULL), parent_(parent), delegate_(NULL), name_(name) {}
+      : gprop_(NULL), parent_(parent), delegate_(NULL), name_(name),
+        created_(false), val_loc_(NULL), val_size_(0), dirty_(false) {}
   Property(PropRegistry* parent, const char* name, PropertyDelegate* delegate)
-      : gprop_(NULL), parent_(parent), delegate_(delegate), name_(name) {}
+      : gprop_(NULL), parent_(parent), delegate_(delegate), name_(name),
+        created_(false), val_loc_(NULL), val_size_(0), dirty_(false) {}
 
   virtual ~Property() {
     if (parent_)
       parent_->Unregister(this);
   }
 
-  void CreateProp();
-  virtual void CreatePropImpl() = 0;
-  void DestroyProp();
+  // Fills in the type, location, count and initial value to create the
+  // provider's property with. Must use ProviderLocation() for the location.
+  virtual void Describe(GesturesPropDesc* desc) = 0;
+  // Whether the value differs from |orig|, a copy of its bytes from before
+  // the provider created the property.
+  virtual bool ValueDiffers(const char* orig) const;
+  // Tells the delegate that the value changed.
+  virtual void NotifyDelegate() = 0;
 
-  const char* name() { return name_; }
+  const char* name() const { return name_; }
   // Returns a newly allocated Value object
   virtual Json::Value NewValue() const = 0;
   // Returns true on success
@@ -73,18 +176,40 @@ class Property {
   }
   // TODO(adlr): pass on will-read notifications
   virtual GesturesPropBool HandleGesturesPropWillRead() { return 0; }
-  static void StaticHandleGesturesPropWritten(void* data) {
-    reinterpret_cast<Property*>(data)->HandleGesturesPropWritten();
-  }
+  // If the registry defers writes, stages the new value instead.
+  static void StaticHandleGesturesPropWritten(void* data);
+  // For bulk providers. If the registry defers writes, the values are
+  // committed together.
+  static void StaticHandleGesturesPropsWritten(void* const* data,
+                                               size_t count);
   virtual void HandleGesturesPropWritten() = 0;
 
  protected:
+  // Returns where the provider should keep the value of |size| bytes at
+  // |val|: |val| itself, or a staging copy if the registry defers writes.
+  void* ProviderLocation(void* val, size_t size);
+  // Call after creating the provider's property, which may have written a
+  // configured value to the location.
+  void TakeCreatedValue();
+
   GesturesProp* gprop_;
   PropRegistry* parent_;
   PropertyDelegate* delegate_;
 
  private:
+  friend class PropRegistry;
+
   const char* name_;
+  // Between PropRegistry::CreateProps() and DestroyProps().
+  bool created_;
+  // For deferred writes: the provider writes staged_, which Stage() copies
+  // to pending_, which Commit() copies to the value at val_loc_.
+  void* val_loc_;
+  size_t val_size_;
+  std::unique_ptr<char[]> staged_;
+  std::unique_ptr<char[]> pending_;
+  // In parent_->written_. Guarded by parent_->lock_.
+  bool dirty_;
 };
 
 class BoolProperty : public Property {
@@ -100,7 +225,8 @@ class BoolProperty : public Property {
     if (parent_)
       parent_->Register(this);
   }
-  virtual void CreatePropImpl();
+  virtual void Describe(GesturesPropDesc* desc);
+  virtual void NotifyDelegate();
   virtual Json::Value NewValue() const;
   virtual bool SetValue(const Json::Value& value);
   virtual void HandleGesturesPropWritten();
@@ -122,7 +248,8 @@ class BoolArrayProperty : public Property {
     if (parent_)
       parent_->Register(this);
   }
-  virtual void CreatePropImpl();
+  virtual void Describe(GesturesPropDesc* desc);
+  virtual void NotifyDelegate();
   virtual Json::Value NewValue() const;
   virtual bool SetValue(const Json::Value& list);
   virtual void HandleGesturesPropWritten();
@@ -144,7 +271,8 @@ class DoubleProperty : public Property {
     if (parent_)
       parent_->Register(this);
   }
-  virtual void CreatePropImpl();
+  virtual void Describe(GesturesPropDesc* desc);
+  virtual void NotifyDelegate();
   virtual Json::Value NewValue() const;
   virtual bool SetValue(const Json::Value& value);
   virtual void HandleGesturesPropWritten();
@@ -166,7 +294,8 @@ class DoubleArrayProperty : public Property {
     if (parent_)
       parent_->Register(this);
   }
-  virtual void CreatePropImpl();
+  virtual void Describe(GesturesPropDesc* desc);
+  virtual void NotifyDelegate();
   virtual Json::Value NewValue() const;
   virtual bool SetValue(const Json::Value& list);
   virtual void HandleGesturesPropWritten();
@@ -188,7 +317,8 @@ class IntProperty : public Property {
     if (parent_)
       parent_->Register(this);
   }
-  virtual void CreatePropImpl();
+  virtual void Describe(GesturesPropDesc* desc);
+  virtual void NotifyDelegate();
   virtual Json::Value NewValue() const;
   virtual bool SetValue(const Json::Value& value);
   virtual void HandleGesturesPropWritten();
@@ -209,7 +339,8 @@ class IntArrayProperty : public Property {
     if (parent_)
       parent_->Register(this);
   }
-  virtual void CreatePropImpl();
+  virtual void Describe(GesturesPropDesc* desc);
+  virtual void NotifyDelegate();
   virtual Json::Value NewValue() const;
   virtual bool SetValue(const Json::Value& list);
   virtual void HandleGesturesPropWritten();
@@ -231,7 +362,8 @@ class ShortProperty : public Property {
     if (parent_)
       parent_->Register(this);
   }
-  virtual void CreatePropImpl();
+  virtual void Describe(GesturesPropDesc* desc);
+  virtual void NotifyDelegate();
   virtual Json::Value NewValue() const;
   virtual bool SetValue(const Json::Value& value);
   virtual void HandleGesturesPropWritten();
@@ -253,7 +385,8 @@ class ShortArrayProperty : public Property {
     if (parent_)
       parent_->Register(this);
   }
-  virtual void CreatePropImpl();
+  virtual void Describe(GesturesPropDesc* desc);
+  virtual void NotifyDelegate();
   virtual Json::Value NewValue() const;
   virtual bool SetValue(const Json::Value& list);
   virtual void HandleGesturesPropWritten();
@@ -275,7 +408,9 @@ class StringProperty : public Property {
     if (parent_)
       parent_->Register(this);
   }
-  virtual void CreatePropImpl();
+  virtual void Describe(GesturesPropDesc* desc);
+  virtual bool ValueDiffers(const char* orig) const;
+  virtual void NotifyDelegate();
   virtual Json::Value NewValue() const;
   virtual bool SetValue(const Json::Value& value);
   virtual void HandleGesturesPropWritten();
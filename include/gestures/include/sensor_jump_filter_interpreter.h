@@ -7,6 +7,7 @@
 #include "gestures/include/filter_interpreter.h"
 #include "gestures/include/finger_metrics.h"
 #include "gestures/include/gestures.h"
+#include "gestures/include/hardware_state_buffer.h"
 #include "gestures/include/map.h"
 #include "gestures/include/prop_registry.h"
 #include "gestures/include/tracer.h"
@@ -66,9 +67,8 @@ class SensorJumpFilterInterpreter : public FilterInterpreter,
   // not be marked as WARP.
   DoubleProperty no_warp_min_dist_move_;
 
-  // Fingers from the previous two SyncInterpret calls. previous_input_[0]
-  // is the more recent.
-  map<short, FingerState, kMaxFingers> previous_input_[2];
+  // Input from this and the previous two SyncInterpret calls
+  HardwareStateBuffer input_history_;
 
   // When a finger is flagged with a warp flag for the first time, we note it
   // here.
@@ -6,6 +6,7 @@
 #define GESTURES_SET_H__
 
 #include <algorithm>
+#include <utility>
 
 #include "gestures/include/gestures.h"
 #include "gestures/include/logging.h"
@@ -26,6 +27,89 @@
 
 namespace gestures {
 
+// The key of an element of a set, or of a map's (key, data) pair.
+template<typename Elt>
+inline const Elt& IndexKey(const Elt& elt) { return elt; }
+template<typename Key, typename Data>
+inline const Key& IndexKey(const std::pair<Key, Data>& elt) {
+  return elt.first;
+}
+
+// Where each key is among the elements of a set or map. In general this
+// searches the elements linearly; for tracking ids (short keys), which are
+// looked up many times per finger each frame, it is a hash table, so that
+// lookups stay O(1) as the number of fingers grows.
+//
+// Add() must be called for each element appended, and Rebuild() after
+// elements are removed or moved.
+template<typename Key, size_t kMaxSize>
+class KeyIndex {
+ public:
+  void Clear() {}
+  void Add(const Key& key, size_t pos) {}
+  template<typename Elt>
+  void Rebuild(const Elt* elts, size_t size) {}
+  // Returns the position of the element with |key|, or |size| if none.
+  template<typename Elt>
+  size_t Find(const Key& key, const Elt* elts, size_t size) const {
+    for (size_t i = 0; i < size; i++)
+      if (IndexKey(elts[i]) == key)
+        return i;
+    return size;
+  }
+};
+
+template<size_t kMaxSize>
+class KeyIndex<short, kMaxSize> {
+ public:
+  KeyIndex() { Clear(); }
+  void Clear() {
+    for (size_t i = 0; i < kSlots; i++)
+      slots_[i].pos = kEmpty;
+  }
+  // |key| must not be in the index already.
+  void Add(short key, size_t pos) {
+    size_t i = Hash(key);
+    while (slots_[i].pos != kEmpty)
+      i = (i + 1) & (kSlots - 1);
+    slots_[i].key = key;
+    slots_[i].pos = pos;
+  }
+  template<typename Elt>
+  void Rebuild(const Elt* elts, size_t size) {
+    Clear();
+    for (size_t i = 0; i < size; i++)
+      Add(IndexKey(elts[i]), i);
+  }
+  template<typename Elt>
+  size_t Find(short key, const Elt* elts, size_t size) const {
+    for (size_t i = Hash(key); slots_[i].pos != kEmpty;
+         i = (i + 1) & (kSlots - 1))
+      if (slots_[i].key == key)
+        return slots_[i].pos;
+    return size;
+  }
+
+ private:
+  static constexpr size_t PowerOfTwoAtLeast(size_t n, size_t pow = 1) {
+    return pow >= n ? pow : PowerOfTwoAtLeast(n, pow * 2);
+  }
+  // At most half full, so probe sequences stay short.
+  static const size_t kSlots = PowerOfTwoAtLeast(2 * kMaxSize);
+  static const unsigned short kEmpty = 0xffff;
+
+  static size_t Hash(short key) {
+    // Tracking ids are usually sequential; spread them over the table.
+    return (static_cast<unsigned short>(key) * 40503u >> 7) & (kSlots - 1);
+  }
+
+  struct Slot {
+    short key;
+    unsigned short pos;
+  };
+  Slot slots_[kSlots];
+};
+
 template<typename Elt, size_t kMaxSize>
 class set {
  public:
@@ -46,12 +130,17 @@ class set {
 
   const_iterator begin() const { return vector_.begin(); }
   const_iterator end() const { return vector_.end(); }
-  const_iterator find(const Elt& value) const { return vector_.find(value); }
+  const_iterator find(const Elt& value) const {
+    return vector_.begin() + index_.Find(value, vector_.begin(), size());
+  }
 
-  // Non-const versions:
+  // Non-const versions. Elements mustn't be changed through iterators.
   iterator begin() { return vector_.begin(); }
   iterator end() { return vector_.end(); }
-  iterator find(const Elt& value) { return vector_.find(value); }
+  iterator find(const Elt& value) {
+    return const_cast<iterator>(
+        const_cast<const set<Elt, kMaxSize>*>(this)->find(value));
+  }
 
   // Unlike std::set, invalidates iterators.
   std::pair<iterator, bool> insert(const Elt& value) {
@@ -60,30 +149,41 @@ class set {
       return std::make_pair(it, false);
 
     it = vector_.insert(vector_.end(), value);
-    return std::make_pair(it, it != vector_.end());
+    if (it == vector_.end())
+      return std::make_pair(it, false);
+    index_.Add(value, it - vector_.begin());
+    return std::make_pair(it, true);
   }
 
   // Returns number of elements removed (0 or 1).
   // Unlike std::set, invalidates iterators.
   size_t erase(const Elt& value) {
-    iterator it = vector_.find(value);
+    iterator it = find(value);
     if (it == vector_.end())
       return 0;
-    vector_.erase(it);
+    erase(it);
     return 1;
   }
-  void erase(iterator it) { vector_.erase(it); }
-  void clear() { vector_.clear(); }
+  void erase(iterator it) {
+    vector_.erase(it);
+    index_.Rebuild(vector_.begin(), size());
+  }
+  void clear() {
+    vector_.clear();
+    index_.Clear();
+  }
 
   template<size_t kThatSize>
   set<Elt, kMaxSize>& operator=(const set<Elt, kThatSize>& that) {
     vector_.clear();
     vector_.insert(vector_.begin(), that.begin(), that.end());
+    index_.Rebuild(vector_.begin(), size());
     return *this;
   }
 
  protected:
   vector<Elt, kMaxSize> vector_;
+  KeyIndex<Elt, kMaxSize> index_;
 };
 
 template<typename Elt, size_t kLeftMaxSize, size_t kRightMaxSize>
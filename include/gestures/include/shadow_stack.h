@@ -0,0 +1,130 @@
+// Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef GESTURES_SHADOW_STACK_H_
+#define GESTURES_SHADOW_STACK_H_
+
+#include <memory>
+#include <mutex>
+
+#include "gestures/include/gestures.h"
+#include "gestures/include/interpreter.h"
+#include "gestures/include/macros.h"
+#include "gestures/include/strand_scheduler.h"
+
+namespace gestures {
+
+class MetricsProperties;
+class PropRegistry;
+
+// What a stack produced in response to one input event, in enough detail
+// to tell whether two stacks behaved the same.
+struct GestureSummary {
+  GestureSummary() { Clear(); }
+  void Clear();
+  void Add(const Gesture& gesture);
+  // True if both have the same number of gestures of each type and the same
+  // button changes, and their total motion differs by at most |tolerance|.
+  bool Matches(const GestureSummary& that, float tolerance) const;
+  size_t total() const;
+
+  static const size_t kTypeCount = kGestureTypeMetrics + 1;
+  size_t counts[kTypeCount];
+  unsigned buttons_down;
+  unsigned buttons_up;
+  float move_dx, move_dy;
+  float scroll_dx, scroll_dy;
+};
+
+// Runs a candidate interpreter stack next to the primary one, for trying
+// out a new stack on live input before switching to it.
+//
+// The primary stack is run through SyncInterpret()/HandleTimer() here, which
+// run it as usual on the calling thread and also queue a copy of the input
+// for the shadow stack, which runs on a thread of its own. Gestures from the
+// shadow stack are compared with the primary's for the same input event and
+// then thrown away. If the shadow thread falls behind by more than
+// kMaxQueuedEvents, further events are dropped (and counted) rather than
+// slowing the primary stack down.
+//
+// The shadow stack keeps its own timer deadline: it is run whenever an
+// input event arrives at or after the deadline, rather than from a real
+// timer.
+class ShadowStack : public GestureConsumer {
+ public:
+  // Takes ownership of all arguments. |prop_reg| and |mprops| are the ones
+  // |shadow| was built with.
+  ShadowStack(PropRegistry* prop_reg, MetricsProperties* mprops,
+              Interpreter* shadow);
+  // Waits for the shadow stack to process everything queued.
+  virtual ~ShadowStack();
+
+  // Copies values into the shadow stack's properties from properties of the
+  // same name in |primary|, so both stacks run with the device's settings.
+  void CopyProperties(const PropRegistry& primary);
+
+  void SetHardwareProperties(const HardwareProperties& hwprops);
+  void SyncInterpret(Interpreter* primary, HardwareState* hwstate,
+                     stime_t* timeout);
+  void HandleTimer(Interpreter* primary, stime_t now, stime_t* timeout);
+
+  // The primary stack's consumer should Add() each gesture to this.
+  GestureSummary* primary_summary() { return &primary_summary_; }
+
+  // Returns the stats so far. Events still queued aren't counted yet.
+  GesturesShadowStats stats();
+  // Blocks until the shadow stack has caught up.
+  void WaitIdle() { scheduler_.WaitIdle(); }
+
+  // For the shadow stack only.
+  virtual void ConsumeGesture(const Gesture& gesture);
+
+ private:
+  struct Event {
+    ShadowStack* stack;
+    bool is_timer;
+    stime_t now;
+    HardwareState hwstate;
+    std::unique_ptr<FingerState[]> fingers;
+    GestureSummary primary;
+    stime_t primary_cpu;
+  };
+
+  static const size_t kMaxQueuedEvents = 256;
+
+  static stime_t ThreadCpuTime();
+  // Returns a new Event, or NULL if the queue is full.
+  Event* NewEvent(bool is_timer, stime_t now);
+  void QueueEvent(Event* event, stime_t primary_cpu);
+  static void RunEvent(void* data);
+  static void RunSetHardwareProperties(void* data);
+  // On the shadow thread: runs the shadow stack's timer while it's due.
+  void HandleDueTimers(stime_t now);
+
+  std::unique_ptr<PropRegistry> prop_reg_;
+  std::unique_ptr<MetricsProperties> mprops_;
+  std::unique_ptr<Interpreter> shadow_;
+
+  // Primary stack's output, written on the primary's thread.
+  GestureSummary primary_summary_;
+
+  // Only used on the shadow thread.
+  HardwareProperties hwprops_;
+  GestureSummary shadow_summary_;
+  stime_t shadow_deadline_;
+
+  std::mutex lock_;
+  GesturesShadowStats stats_;
+  size_t queued_events_;
+
+  // Last, so that its thread is stopped before anything above goes away.
+  StrandScheduler scheduler_;
+  Strand* strand_;
+
+  DISALLOW_COPY_AND_ASSIGN(ShadowStack);
+};
+
+}  // namespace gestures
+
+#endif  // GESTURES_SHADOW_STACK_H_
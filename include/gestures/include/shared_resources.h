@@ -0,0 +1,67 @@
+// Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef GESTURES_SHARED_RESOURCES_H_
+#define GESTURES_SHARED_RESOURCES_H_
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "gestures/include/macros.h"
+
+namespace gestures {
+
+// Owns read-only data that is the same for every device, such as default
+// acceleration curves or calibration files, so that a process running many
+// GestureInterpreters builds or loads each of them once.
+//
+// Resources are keyed by a string that identifies their content: a fixed
+// name for tables that are computed, or FileKey() for data loaded from disk.
+// Callers get a shared_ptr to const data, which stays valid even if the
+// SharedResources is deleted first. An entry is freed once no interpreter
+// references it anymore.
+//
+// Safe to use from multiple threads.
+class SharedResources {
+ public:
+  SharedResources() {}
+
+  // Returns the resource stored under |key|, calling |factory| to create it
+  // if it isn't cached. |factory| returns a new object, or NULL on failure,
+  // in which case NULL is returned and nothing is cached.
+  template<typename T>
+  std::shared_ptr<const T> Get(const std::string& key, T* (*factory)(void*),
+                               void* factory_data) {
+    std::lock_guard<std::mutex> lock(lock_);
+    std::shared_ptr<const void> cached = entries_[key].lock();
+    if (cached)
+      return std::static_pointer_cast<const T>(cached);
+    std::shared_ptr<const T> created(factory(factory_data));
+    if (created)
+      entries_[key] = created;
+    else
+      entries_.erase(key);
+    return created;
+  }
+
+  // Returns a key for the contents of the file at |path|: it includes the
+  // file's identity and modification time, so a file that is replaced
+  // gets reloaded. Returns an empty string if the file can't be stat()ed.
+  static std::string FileKey(const char* prefix, const char* path);
+
+  // Number of live resources.
+  size_t size();
+
+ private:
+  std::mutex lock_;
+  std::map<std::string, std::weak_ptr<const void> > entries_;
+
+  DISALLOW_COPY_AND_ASSIGN(SharedResources);
+};
+
+}  // namespace gestures
+
+#endif  // GESTURES_SHARED_RESOURCES_H_
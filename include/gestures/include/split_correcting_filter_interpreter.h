@@ -4,6 +4,7 @@
 
 #include <gtest/gtest.h>  // for FRIEND_TEST
 
+#include "gestures/include/assignment_solver.h"
 #include "gestures/include/filter_interpreter.h"
 #include "gestures/include/finger_metrics.h"
 #include "gestures/include/gestures.h"
@@ -106,6 +107,8 @@ class SplitCorrectingFilterInterpreter : public FilterInterpreter {
   set<short, kMaxFingers> last_tracking_ids_;
   UnmergedContact unmerged_[kMaxFingers];
   MergedContact merged_[kMaxFingers / 2 + 1];
+  // Pairs unmerged contacts with the new contacts they may have split into
+  AssignmentSolver merge_solver_;
 
   // Contacts must be separated by less than this amount to be considered for
   // merging.
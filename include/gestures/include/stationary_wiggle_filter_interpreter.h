@@ -2,6 +2,9 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <algorithm>
+#include <gtest/gtest.h>  // for FRIEND_TEST
+
 #include "gestures/include/filter_interpreter.h"
 #include "gestures/include/finger_metrics.h"
 #include "gestures/include/gestures.h"
@@ -58,8 +61,13 @@ namespace gestures {
 //      se4 = p0^2 + p1^2 ... + p4^2
 //      se5 = p1^2 + p2^2 ... + p5^2
 //
+// Each of the three sums above is kept as a running sum, adding the newest
+// sample's term and subtracting the one leaving the window, so a frame costs
+// the same however long the window is. The sums are recomputed from the
+// window every so often so that rounding errors don't build up.
 
-#define SIGNAL_SAMPLES 5  // number of signal samples
+#define SIGNAL_SAMPLES 5  // default number of signal samples
+#define MAX_SIGNAL_SAMPLES 64  // most signal samples in a window
 
 struct FingerEnergy {
   float x;  // original position_x
@@ -82,12 +90,19 @@ struct FingerEnergy {
 
 class FingerEnergyHistory {
  public:
-  FingerEnergyHistory()
-      : size_(0),
+  // |window| is the number of signal samples, up to MAX_SIGNAL_SAMPLES.
+  explicit FingerEnergyHistory(size_t window = SIGNAL_SAMPLES)
+      : max_size_(std::max(std::min(window,
+                                    static_cast<size_t>(MAX_SIGNAL_SAMPLES)),
+                           static_cast<size_t>(1))),
+        size_(0),
         head_(0),
         moving_(false),
         idle_time_(0.1),
-        prev_(0) {}
+        prev_(0),
+        pushes_(0) {
+    ClearSums();
+  }
 
   // Push the current finger data into the history buffer
   void PushFingerState(const FingerState &fs, const stime_t timestamp);
@@ -111,16 +126,30 @@ class FingerEnergyHistory {
   bool operator!=(const FingerEnergyHistory& that) const;
 
  private:
-  FingerEnergy history_[SIGNAL_SAMPLES];  // the finger energy buffer
-  size_t max_size_ = arraysize(history_);
+  // Pushes between recomputing the running sums
+  static const size_t kRecomputeInterval = 256;
+
+  void ClearSums();
+  // Recomputes the running sums from the samples in the window.
+  void RecomputeSums();
+
+  FingerEnergy history_[MAX_SIGNAL_SAMPLES];  // the finger energy buffer
+  size_t max_size_;
   size_t size_;
   size_t head_;
   bool moving_;
   stime_t idle_time_;  // timeout for finger without state change
   stime_t prev_;
+  // Running sums of the fields of the samples in the window
+  double sum_x_, sum_y_;
+  double sum_mixed_x_, sum_mixed_y_;
+  double sum_energy_x_, sum_energy_y_;
+  size_t pushes_;  // since the sums were last recomputed
 };
 
-class StationaryWiggleFilterInterpreter : public FilterInterpreter {
+class StationaryWiggleFilterInterpreter : public FilterInterpreter,
+                                          public PropertyDelegate {
+  FRIEND_TEST(StationaryWiggleFilterInterpreterTest, SimpleTest);
  public:
   // Takes ownership of |next|:
   StationaryWiggleFilterInterpreter(PropRegistry* prop_reg,
@@ -131,6 +160,9 @@ class StationaryWiggleFilterInterpreter : public FilterInterpreter {
  protected:
   virtual void SyncInterpretImpl(HardwareState* hwstate, stime_t* timeout);
 
+ public:
+  virtual void IntWasWritten(IntProperty* prop);
+
  private:
   // Calculate signal energy from input data and update finger flag if
   // a finger is stationary
@@ -143,10 +175,14 @@ class StationaryWiggleFilterInterpreter : public FilterInterpreter {
   // True if this interpreter is effective
   BoolProperty enabled_;
 
-  // Threshold and hysteresis of signal energy for finger moving/stationary
+  // Threshold and hysteresis of signal energy for finger moving/stationary.
+  // The energy is summed over the window, so these scale with its size.
   DoubleProperty threshold_;
   DoubleProperty hysteresis_;
 
+  // Number of signal samples in the window, up to MAX_SIGNAL_SAMPLES
+  IntProperty window_size_;
+
   DISALLOW_COPY_AND_ASSIGN(StationaryWiggleFilterInterpreter);
 };
 
@@ -0,0 +1,163 @@
+// Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef GESTURES_STRAND_SCHEDULER_H_
+#define GESTURES_STRAND_SCHEDULER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "gestures/include/gestures.h"
+#include "gestures/include/macros.h"
+
+namespace gestures {
+
+class StrandScheduler;
+
+// A sequence of tasks that run one at a time, in the order they were posted,
+// on whatever StrandScheduler thread is free. Give each GestureInterpreter
+// its own strand and only touch it from tasks on that strand: then it is
+// never used from two threads at once, and hardware states and timer
+// callbacks reach it in order.
+class Strand {
+ public:
+  // Queues |task|. May be called from any thread, including from tasks.
+  void Post(GesturesTaskFunction task, void* data);
+
+  // Copies |hwstate| (and its fingers) and queues pushing the copy into |gi|.
+  void PostHardwareState(GestureInterpreter* gi, const HardwareState& hwstate);
+
+  // A GesturesTimerProvider that wraps the one set with SetTimerProvider():
+  // timers are set through it, but callbacks are posted to the strand rather
+  // than run on the provider's thread. Pass the strand as the provider data:
+  //   strand->SetTimerProvider(tp, tp_data);
+  //   gi->SetTimerProvider(Strand::provider(), strand);
+  // The wrapped provider's functions are called from strand tasks, so they
+  // must be safe to call from the scheduler's threads.
+  static GesturesTimerProvider* provider() { return &kProvider; }
+  void SetTimerProvider(GesturesTimerProvider* tp, void* data) {
+    timer_provider_ = tp;
+    timer_provider_data_ = data;
+  }
+
+ private:
+  friend class StrandScheduler;
+
+  struct Work {
+    GesturesTaskFunction task;
+    void* data;
+  };
+  // Wraps a timer of the underlying provider.
+  struct Timer {
+    Strand* strand;
+    GesturesTimer* timer;
+    GesturesTimerCallback callback;
+    void* callback_data;
+    // Bumped on every set/cancel, so firings posted before then are dropped.
+    std::atomic<unsigned> generation;
+  };
+  struct TimerFiring {
+    Timer* timer;
+    unsigned generation;
+    stime_t now;
+  };
+
+  // Tasks run per turn before the strand yields its thread to other strands.
+  static const size_t kMaxTasksPerTurn = 16;
+
+  explicit Strand(StrandScheduler* scheduler);
+  // Runs up to kMaxTasksPerTurn tasks. Returns true if more are queued.
+  bool RunTurn();
+
+  static void RunHardwareState(void* data);
+  static void RunTimerFiring(void* data);
+  static void DeleteTimer(void* data);
+  static stime_t TimerTrampoline(stime_t now, void* data);
+  void ArmTimer(Timer* timer, stime_t delay);
+
+  static GesturesTimer* StaticCreate(void* data);
+  static void StaticSet(void* data, GesturesTimer* timer, stime_t delay,
+                        GesturesTimerCallback callback, void* callback_data);
+  static void StaticCancel(void* data, GesturesTimer* timer);
+  static void StaticFree(void* data, GesturesTimer* timer);
+  static GesturesTimerProvider kProvider;
+
+  StrandScheduler* scheduler_;
+  std::mutex lock_;
+  std::deque<Work> queue_;
+  // True while the strand is in a run queue or running.
+  bool scheduled_;
+
+  GesturesTimerProvider* timer_provider_;
+  void* timer_provider_data_;
+
+  DISALLOW_COPY_AND_ASSIGN(Strand);
+};
+
+// Runs strands on a fixed pool of threads. Each thread keeps its own queue
+// of runnable strands: a strand that becomes runnable from a task goes on
+// the current thread's queue, and threads with nothing to do steal from the
+// others. A strand gives up its thread after kMaxTasksPerTurn tasks, so one
+// busy device can't starve the rest.
+class StrandScheduler {
+ public:
+  // A |thread_count| of 0 means one per CPU.
+  explicit StrandScheduler(size_t thread_count);
+  // Runs everything already posted, then stops the threads.
+  ~StrandScheduler();
+
+  // The strand is owned by the scheduler and lives as long as it does.
+  Strand* NewStrand();
+
+  // Blocks until no tasks are queued or running.
+  void WaitIdle();
+
+  size_t thread_count() const { return workers_.size(); }
+  // Number of times a thread ran a strand from another thread's queue.
+  size_t steals();
+
+ private:
+  friend class Strand;
+
+  struct Worker {
+    std::thread thread;
+    std::mutex lock;
+    // Own strands are taken from the back, stolen ones from the front.
+    std::deque<Strand*> runnable;
+  };
+
+  // Makes |strand| runnable.
+  void Schedule(Strand* strand);
+  void WorkerMain(size_t index);
+  Strand* TakeStrand(size_t index);
+  void TaskPosted();
+  void TasksDone(size_t count);
+
+  std::vector<std::unique_ptr<Worker> > workers_;
+
+  std::mutex strands_lock_;
+  std::vector<std::unique_ptr<Strand> > strands_;
+
+  // Guards everything below; the condition variables use it.
+  std::mutex lock_;
+  std::condition_variable wake_;
+  std::condition_variable idle_;
+  // Strands in run queues, and tasks not yet run.
+  size_t runnable_count_;
+  size_t pending_tasks_;
+  size_t next_worker_;
+  size_t steals_;
+  bool stopping_;
+
+  DISALLOW_COPY_AND_ASSIGN(StrandScheduler);
+};
+
+}  // namespace gestures
+
+#endif  // GESTURES_STRAND_SCHEDULER_H_
@@ -0,0 +1,53 @@
+// Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef GESTURES_TIMER_SCHEDULER_H_
+#define GESTURES_TIMER_SCHEDULER_H_
+
+#include "gestures/include/gestures.h"
+#include "gestures/include/map.h"
+
+namespace gestures {
+
+// Keeps a small table of absolute deadlines, one per owner id, and reports
+// the earliest one. GestureInterpreter has a single GesturesTimer from the
+// provider; with this it can track each thing that wants a callback on its
+// own, and only re-arm (or cancel) the provider timer when the earliest
+// deadline actually moves.
+//
+// Deadlines are absolute times in the same clock as HardwareState
+// timestamps. A deadline of 0.0 means "no deadline".
+class TimerScheduler {
+ public:
+  static const size_t kMaxTimers = 8;
+  // Deadlines closer together than this are considered equal. Deadlines are
+  // often re-derived from relative timeouts (now + (deadline - now)), which
+  // isn't exact in floating point.
+  static const stime_t kSlack;
+
+  TimerScheduler() {}
+
+  // Sets (or moves) the deadline for |id|. A deadline <= 0.0 cancels it.
+  void SetDeadline(int id, stime_t deadline);
+  void Cancel(int id) { deadlines_.erase(id); }
+  // Returns the deadline for |id|, or 0.0 if none is set.
+  stime_t Deadline(int id) const;
+  // Returns the earliest deadline, or 0.0 if none is set.
+  stime_t NextDeadline() const;
+  // Returns true if |id| has a deadline at or before |now|.
+  bool IsDue(int id, stime_t now) const;
+  bool empty() const { return deadlines_.empty(); }
+  void Clear() { deadlines_.clear(); }
+
+  static bool SameDeadline(stime_t a, stime_t b) {
+    return a - b < kSlack && b - a < kSlack;
+  }
+
+ private:
+  map<int, stime_t, kMaxTimers> deadlines_;
+};
+
+}  // namespace gestures
+
+#endif  // GESTURES_TIMER_SCHEDULER_H_
@@ -0,0 +1,103 @@
+// Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef GESTURES_TIMERFD_LOOP_H_
+#define GESTURES_TIMERFD_LOOP_H_
+
+#include <set>
+#include <vector>
+
+#include "gestures/include/gestures.h"
+#include "gestures/include/macros.h"
+
+namespace gestures {
+
+// A reference GesturesTimerProvider for Linux. Each GesturesTimer is a
+// CLOCK_MONOTONIC timerfd registered with one epoll instance, and Dispatch()
+// waits on that instance and runs whatever timers are due. The epoll fd can
+// itself be polled, so the loop can be nested inside an existing event loop;
+// standalone daemons can register their input fds with WatchFd() instead.
+//
+// Times passed to timer callbacks come from Now(), i.e. CLOCK_MONOTONIC as
+// converted by StimeFromTimespec(), which matches the timestamps of evdev
+// devices set to CLOCK_MONOTONIC.
+//
+// With a non-zero slack, deadlines are rounded up to a multiple of the slack
+// and any timer due within the slack of a wakeup runs in that same wakeup.
+// This trades up to |slack| of timer accuracy for fewer wakeups when several
+// timers (or several GestureInterpreters) are active.
+//
+// Not thread safe; use it from one thread.
+class TimerFdLoop {
+ public:
+  TimerFdLoop();
+  ~TimerFdLoop();
+
+  // Returns false if the epoll instance couldn't be created.
+  bool valid() const { return epoll_fd_ >= 0; }
+  // Pass |this| as the provider data.
+  static GesturesTimerProvider* provider() { return &kProvider; }
+  static stime_t Now();
+
+  int fd() const { return epoll_fd_; }
+  stime_t slack() const { return slack_; }
+  void set_slack(stime_t slack) { slack_ = slack > 0.0 ? slack : 0.0; }
+
+  // Calls |callback| from Dispatch() whenever |fd| is readable.
+  bool WatchFd(int fd, GesturesFdCallback callback, void* data);
+  void UnwatchFd(int fd);
+
+  // Waits up to |timeout_ms| (-1 for no limit) for a timer or watched fd and
+  // dispatches everything that is ready. Returns the number of callbacks
+  // run, or -1 on error.
+  int Dispatch(int timeout_ms);
+
+  GesturesTimer* CreateTimer();
+  void SetTimer(GesturesTimer* timer, stime_t delay,
+                GesturesTimerCallback callback, void* callback_data);
+  void CancelTimer(GesturesTimer* timer);
+  void FreeTimer(GesturesTimer* timer);
+
+ private:
+  // A timer or a watched fd.
+  struct Source {
+    int fd;
+    bool is_timer;
+    // Timers only. 0.0 if not armed.
+    stime_t deadline;
+    GesturesTimerCallback timer_callback;
+    void* timer_data;
+    // Watched fds only.
+    GesturesFdCallback fd_callback;
+    void* fd_data;
+  };
+
+  bool AddSource(Source* source);
+  void RemoveSource(Source* source);
+  bool ArmTimerFd(Source* source, stime_t deadline);
+  // Runs the callback for |timer| and re-arms it if asked to.
+  void FireTimer(Source* timer, stime_t now);
+
+  static GesturesTimer* StaticCreate(void* data);
+  static void StaticSet(void* data, GesturesTimer* timer, stime_t delay,
+                        GesturesTimerCallback callback, void* callback_data);
+  static void StaticCancel(void* data, GesturesTimer* timer);
+  static void StaticFree(void* data, GesturesTimer* timer);
+  static GesturesTimerProvider kProvider;
+
+  int epoll_fd_;
+  stime_t slack_;
+  std::set<Source*> timers_;
+  std::set<Source*> watches_;
+  // Sources removed during Dispatch() are freed once it's done, since their
+  // events may still be pending.
+  bool dispatching_;
+  std::vector<Source*> dead_;
+
+  DISALLOW_COPY_AND_ASSIGN(TimerFdLoop);
+};
+
+}  // namespace gestures
+
+#endif  // GESTURES_TIMERFD_LOOP_H_
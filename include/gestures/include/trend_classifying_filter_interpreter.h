@@ -2,16 +2,15 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <memory>
+
 #include <gtest/gtest.h>  // for FRIEND_TEST
 
 #include "gestures/include/filter_interpreter.h"
 #include "gestures/include/finger_metrics.h"
 #include "gestures/include/gestures.h"
 #include "gestures/include/map.h"
-#include "gestures/include/memory_manager.h"
-#include "gestures/include/list.h"
 #include "gestures/include/prop_registry.h"
-#include "gestures/include/set.h"
 #include "gestures/include/tracer.h"
 
 #ifndef GESTURES_TREND_CLASSIFYING_FILTER_INTERPRETER_H_
@@ -78,6 +77,7 @@ namespace gestures {
 // thumbs.
 
 class TrendClassifyingFilterInterpreter: public FilterInterpreter {
+  FRIEND_TEST(TrendClassifyingFilterInterpreterTest, KendallWindowTest);
 
 public:
   TrendClassifyingFilterInterpreter(PropRegistry* prop_reg, Interpreter* next,
@@ -88,75 +88,68 @@ protected:
   virtual void SyncInterpretImpl(HardwareState* hwstate, stime_t* timeout);
 
 private:
-  struct KState {
-    KState() { Init(); }
-    KState(const FingerState& fs) { Init(fs); }
-
-    // Init functions called by ctors. We don't use constructors directly since
-    // we have to init classes by ourselves for MemoryManaged types.
-    void Init();
-    void Init(const FingerState& fs);
-
-    // Element struct for tracking one finger property (e.g. x, y, pressure).
-    struct KAxis {
-      KAxis(): val(0.0), sum(0), ties(0), score(0), var(0.0) {}
-
-      void Init() {
-        val = 0.0;
-        sum = 0, ties = 0;
-        score = 0;
-        var = 0.0;
-      }
-
-      // The data value to track of the finger at a given timestamp
-      float val;
-
-      // Temp values to speed up the S and Var(S) computation. For more detail,
-      // please look at the comment for UpdateKTValuePair.
-      int sum, ties;
-
-      // The S and Var(S) computed for this timestamp
-      int score;
-      double var;
-    };
-    static const size_t n_axes_ = 6;
-    KAxis axes_[n_axes_];
+  // Finger properties we track. The deltas are the 1-st order differences of
+  // the positions.
+  enum Axis {
+    kAxisX,
+    kAxisDx,
+    kAxisY,
+    kAxisDy,
+    kAxisPressure,
+    kAxisTouchMajor,
+    kNumAxes
+  };
 
-    KAxis* XAxis() { return &axes_[0]; }
-    KAxis* DxAxis() { return &axes_[1]; }
-    KAxis* YAxis() { return &axes_[2]; }
-    KAxis* DyAxis() { return &axes_[3]; }
-    KAxis* PressureAxis() { return &axes_[4]; }
-    KAxis* TouchMajorAxis() { return &axes_[5]; }
+  // Largest value "Trend Classifying Num of Samples" can take effect with
+  static const size_t kMaxNumOfSamples = 256;
 
-    static bool IsDelta(int idx) { return (idx == 1 || idx == 3); }
-    static unsigned IncFlag(int idx) {
-      static const unsigned flags[n_axes_] = {
-          GESTURES_FINGER_TREND_INC_X,
-          GESTURES_FINGER_TREND_INC_X,
-          GESTURES_FINGER_TREND_INC_Y,
-          GESTURES_FINGER_TREND_INC_Y,
-          GESTURES_FINGER_TREND_INC_PRESSURE,
-          GESTURES_FINGER_TREND_INC_TOUCH_MAJOR };
-      return flags[idx];
-    }
-    static unsigned DecFlag(int idx) {
-      static const unsigned flags[n_axes_] = {
-          GESTURES_FINGER_TREND_DEC_X,
-          GESTURES_FINGER_TREND_DEC_X,
-          GESTURES_FINGER_TREND_DEC_Y,
-          GESTURES_FINGER_TREND_DEC_Y,
-          GESTURES_FINGER_TREND_DEC_PRESSURE,
-          GESTURES_FINGER_TREND_DEC_TOUCH_MAJOR };
-      return flags[idx];
-    }
+  static bool IsDelta(size_t axis) {
+    return axis == kAxisDx || axis == kAxisDy;
+  }
+  static unsigned IncFlag(size_t axis) {
+    static const unsigned flags[kNumAxes] = {
+        GESTURES_FINGER_TREND_INC_X,
+        GESTURES_FINGER_TREND_INC_X,
+        GESTURES_FINGER_TREND_INC_Y,
+        GESTURES_FINGER_TREND_INC_Y,
+        GESTURES_FINGER_TREND_INC_PRESSURE,
+        GESTURES_FINGER_TREND_INC_TOUCH_MAJOR };
+    return flags[axis];
+  }
+  static unsigned DecFlag(size_t axis) {
+    static const unsigned flags[kNumAxes] = {
+        GESTURES_FINGER_TREND_DEC_X,
+        GESTURES_FINGER_TREND_DEC_X,
+        GESTURES_FINGER_TREND_DEC_Y,
+        GESTURES_FINGER_TREND_DEC_Y,
+        GESTURES_FINGER_TREND_DEC_PRESSURE,
+        GESTURES_FINGER_TREND_DEC_TOUCH_MAJOR };
+    return flags[axis];
+  }
 
-    KState* next_;
-    KState* prev_;
+  // The Kendall's S-statistic and the tie sums of (2) for a sliding window
+  // of one axis of one finger. Given a time-series (t1, d1) .... (tn, dn),
+  // appending a new item (tn+1, dn+1) adds to S
+  //
+  //   (# of items with di < dn+1) - (# of items with di > dn+1)
+  //
+  // and, if there were already u items with di == dn+1, adds u to Σ C(ui, 2)
+  // and C(u, 2) to Σ C(ui, 3). Removing the oldest item undoes its pairs with
+  // the remaining items the same way. Keeping the window's values sorted
+  // makes each of these counts a binary search, so updating the statistic
+  // costs O(log n) compares plus shifting part of one contiguous array,
+  // instead of a pass over the whole window for every new sample.
+  //
+  // The window's samples live in ring_ (in arrival order, starting at |head|)
+  // and sorted_ (in ascending order), at the offset given by WindowIndex().
+  struct KendallWindow {
+    size_t head;
+    size_t size;
+    int score;  // S
+    int tie_n2;  // Σ C(ui, 2)
+    int tie_n3;  // Σ C(ui, 3)
   };
 
-  typedef MemoryManagedList<KState> FingerHistory;
-
   // Trend types for internal use
   enum TrendType {
     TREND_NONE,
@@ -164,50 +157,24 @@ private:
     TREND_DECREASING
   };
 
+  static size_t WindowIndex(size_t slot, size_t axis) {
+    return slot * kNumAxes + axis;
+  }
+
   // Detect moving fingers and append the GESTURES_FINGER_TREND_* flags
   void UpdateFingerState(const HardwareState& hwstate);
 
-  // Push new finger data into the buffer and update values
-  void AddNewStateToBuffer(FingerHistory* history, const FingerState& fs);
+  // Push new finger data into the windows for |slot|
+  void AddNewStateToBuffer(size_t slot, const FingerState& fs);
 
-  // Assess statistical significance with a classic two-tail hypothesis test
-  TrendType RunKTTest(const KState::KAxis* current, const size_t n_samples);
+  void ClearWindow(size_t idx);
+  // Appends |val| to the window, first dropping the oldest samples to keep
+  // at most |max_size| of them.
+  void PushSample(size_t idx, float val, size_t max_size);
+  void PopSample(size_t idx);
 
-  // Given a time-series (t1, d1), (t2, d2) .... (tn, dn), a naive
-  // implementation to compute the Kendall's S-statistic as in (1) would take
-  // O(n^2) time, which might be too much even for a moderate size of n. To
-  // speed it up, we save temp values sum_i and ties_i for each item and
-  // incrementally update them upon each new data point's arrival. For each
-  // item (ti, di), sum_i and ties_i stand for:
-  //
-  // sum_i = (# of concordant pairs w.r.t. (ti, di)) -
-  //      (# of discordant pairs w.r.t. (ti, di))
-  // ties_i = (# of other equal value items where dj == di)
-  //
-  // within the range (ti, di) .... (tn, dn).
-  //
-  // The S-statistic, C(ui, 3) and C(ui, 2) in (2) can then be computed as
-  //
-  // S = Σsum_i , C(ui, 2) =      Σ ties_j
-  //     i                 j∈i-th ties group
-  //
-  // C(ui, 3) =      Σ (ties_j * (ties_j - 1) / 2)
-  //          j∈i-th ties group
-  //
-  // The sum_i and ties_i can be updated in O(1) time for each item, thus
-  // reducing the total time complexity to compute S and Var(S) from O(n^2) to
-  // O(n).
-  inline void UpdateKTValuePair(KState::KAxis* past, KState::KAxis* current,
-      int* t_n2_sum, int* t_n3_sum) {
-    if (past->val < current->val)
-      past->sum++;
-    else if (past->val > current->val)
-      past->sum--;
-    else
-      past->ties++;
-    current->score += past->sum, (*t_n2_sum) += past->ties;
-    (*t_n3_sum) += ((past->ties * (past->ties - 1)) >> 1);
-  }
+  // Assess statistical significance with a classic two-tail hypothesis test
+  TrendType RunKTTest(const KendallWindow& window);
 
   // Compute the variance of the Kendall's S-statistic according to (2)
   double ComputeKTVariance(const int tie_n2, const int tie_n3,
@@ -219,14 +186,16 @@ private:
                            const unsigned flag_decreasing,
                            unsigned* flags);
 
-  // memory managers to prevent malloc during interrupt calls
-  MemoryManager<KState> kstate_mm_;
-  MemoryManager<FingerHistory> history_mm_;
+  // Window statistics and samples for every axis of every finger slot,
+  // allocated up front so that nothing is allocated during interrupt calls.
+  KendallWindow windows_[kMaxFingers * kNumAxes];
+  std::unique_ptr<float[]> ring_;
+  std::unique_ptr<float[]> sorted_;
 
-  // A map to store each finger's past coordinates and calculation
-  // intermediates
-  typedef map<short, FingerHistory*, kMaxFingers> FingerHistoryMap;
-  FingerHistoryMap histories_;
+  // Slot in windows_ of each finger, by tracking id
+  typedef map<short, size_t, kMaxFingers> FingerSlotMap;
+  FingerSlotMap slots_;
+  bool slot_used_[kMaxFingers];
 
   // Flag to turn on/off the trend classifying filter
   BoolProperty trend_classifying_filter_enable_;
@@ -244,7 +213,7 @@ private:
   // meaningful result)
   IntProperty min_num_of_samples_;
 
-  // Number of samples desired
+  // Number of samples desired, up to kMaxNumOfSamples
   IntProperty num_of_samples_;
 
   // The critical z-value for the hypothesis testing. For a test statistic that
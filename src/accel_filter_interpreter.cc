@@ -15,28 +15,43 @@
 
 namespace gestures {
 
+namespace {
+// Buckets per segment of a compiled curve
+const size_t kBucketsPerSegment = 8;
+}  // namespace {}
+
+const size_t AccelFilterInterpreter::kMaxAccelPoints;
+
 // Takes ownership of |next|:
 AccelFilterInterpreter::AccelFilterInterpreter(PropRegistry* prop_reg,
                                                Interpreter* next,
-                                               Tracer* tracer)
+                                               Tracer* tracer,
+                                               SharedResources* resources)
     : FilterInterpreter(NULL, next, tracer, false),
       // Hack: cast tp_custom_point_/mouse_custom_point_/tp_custom_scroll_
       // to float arrays.
       tp_custom_point_prop_(prop_reg, "Pointer Accel Curve",
                             reinterpret_cast<double*>(&tp_custom_point_),
-                            sizeof(tp_custom_point_) / sizeof(double)),
+                            sizeof(tp_custom_point_) / sizeof(double), this),
       tp_custom_scroll_prop_(prop_reg, "Scroll Accel Curve",
                              reinterpret_cast<double*>(&tp_custom_scroll_),
-                             sizeof(tp_custom_scroll_) / sizeof(double)),
+                             sizeof(tp_custom_scroll_) / sizeof(double), this),
       mouse_custom_point_prop_(prop_reg, "Mouse Pointer Accel Curve",
                                reinterpret_cast<double*>(&mouse_custom_point_),
-                               sizeof(mouse_custom_point_) / sizeof(double)),
+                               sizeof(mouse_custom_point_) / sizeof(double),
+                               this),
       use_custom_tp_point_curve_(
           prop_reg, "Use Custom Touchpad Pointer Accel Curve", 0),
       use_custom_tp_scroll_curve_(
           prop_reg, "Use Custom Touchpad Scroll Accel Curve", 0),
       use_custom_mouse_curve_(
           prop_reg, "Use Custom Mouse Pointer Accel Curve", 0),
+      mouse_accel_points_(),
+      mouse_accel_points_prop_(prop_reg, "Mouse Pointer Accel Points",
+                               mouse_accel_points_,
+                               arraysize(mouse_accel_points_), this),
+      use_mouse_accel_points_(
+          prop_reg, "Use Mouse Pointer Accel Points", 0),
       pointer_sensitivity_(prop_reg, "Pointer Sensitivity", 3),
       scroll_sensitivity_(prop_reg, "Scroll Sensitivity", 3),
       point_x_out_scale_(prop_reg, "Point X Out Scale", 1.0),
@@ -53,6 +68,17 @@ AccelFilterInterpreter::AccelFilterInterpreter(PropRegistry* prop_reg,
       last_end_time_(0.0),
       last_mags_size_(0) {
   InitName();
+  SetMouseAccelPoints();
+  if (resources)
+    curves_ = resources->Get<DefaultCurves>("AccelFilterInterpreter curves",
+                                           NewDefaultCurves, NULL);
+  else
+    curves_.reset(NewDefaultCurves(NULL));
+}
+
+AccelFilterInterpreter::DefaultCurves*
+AccelFilterInterpreter::NewDefaultCurves(void* unused) {
+  DefaultCurves* curves = new DefaultCurves;
   // Set up default curves.
 
   // Our pointing curves are the following.
@@ -72,13 +98,14 @@ AccelFilterInterpreter::AccelFilterInterpreter(PropRegistry* prop_reg,
     const float divisor = point_divisors[i];
     const float linear_until_x = 32.0;
     const float init_slope = linear_until_x / divisor;
-    point_curves_[i][0] = CurveSegment(linear_until_x, 0, init_slope, 0);
+    curves->point_curves[i][0] =
+        CurveSegment(linear_until_x, 0, init_slope, 0);
     const float x_border = 150;
-    point_curves_[i][1] = CurveSegment(x_border, 1 / divisor, 0, 0);
+    curves->point_curves[i][1] = CurveSegment(x_border, 1 / divisor, 0, 0);
     const float slope = x_border * 2 / divisor;
     const float y_at_border = x_border * x_border / divisor;
     const float icept = y_at_border - slope * x_border;
-    point_curves_[i][2] = CurveSegment(INFINITY, 0, slope, icept);
+    curves->point_curves[i][2] = CurveSegment(INFINITY, 0, slope, icept);
   }
 
   const float old_mouse_speed_straight_cutoff[] = { 5.0, 5.0, 5.0, 8.0, 8.0 };
@@ -94,11 +121,12 @@ AccelFilterInterpreter::AccelFilterInterpreter(PropRegistry* prop_reg,
     const float line_b = cutoff_y - cutoff_x * line_m;
     const float kOutMult = old_mouse_speed_accel[i];
 
-    old_mouse_point_curves_[i][0] =
+    curves->old_mouse_point_curves[i][0] =
         CurveSegment(cutoff_x * 25.4, kParabolaA * kOutMult / 25.4,
                      kParabolaB * kOutMult, 0.0);
-    old_mouse_point_curves_[i][1] = CurveSegment(INFINITY, 0.0, line_m * kOutMult,
-                                             line_b * kOutMult * 25.4);
+    curves->old_mouse_point_curves[i][1] =
+        CurveSegment(INFINITY, 0.0, line_m * kOutMult,
+                     line_b * kOutMult * 25.4);
   }
 
   // These values were determined empirically through user studies:
@@ -113,8 +141,10 @@ AccelFilterInterpreter::AccelFilterInterpreter(PropRegistry* prop_reg,
     float second_slope =
         (2.0 * kMouseMultiplierA * kMouseCutoff + kMouseMultiplierB) *
         kMultipliers[i];
-    mouse_point_curves_[i][0] = CurveSegment(cutoff, mouse_a, mouse_b, 0.0);
-    mouse_point_curves_[i][1] = CurveSegment(INFINITY, 0.0, second_slope, -1182);
+    curves->mouse_point_curves[i][0] =
+        CurveSegment(cutoff, mouse_a, mouse_b, 0.0);
+    curves->mouse_point_curves[i][1] =
+        CurveSegment(INFINITY, 0.0, second_slope, -1182);
   }
 
   const float scroll_divisors[] = { 0.0, // unused
@@ -131,20 +161,97 @@ AccelFilterInterpreter::AccelFilterInterpreter(PropRegistry* prop_reg,
     const float divisor = scroll_divisors[i];
     const float linear_until_x = 75.0;
     const float init_slope = linear_until_x / divisor;
-    scroll_curves_[i][0] = CurveSegment(linear_until_x, 0, init_slope, 0);
+    curves->scroll_curves[i][0] =
+        CurveSegment(linear_until_x, 0, init_slope, 0);
     const float x_border = 600;
-    scroll_curves_[i][1] = CurveSegment(x_border, 1 / divisor, 0, 0);
+    curves->scroll_curves[i][1] = CurveSegment(x_border, 1 / divisor, 0, 0);
     // For scrolling / flinging we level off the speed.
     const float slope = init_slope;
     const float y_at_border = x_border * x_border / divisor;
     const float icept = y_at_border - slope * x_border;
-    scroll_curves_[i][2] = CurveSegment(INFINITY, 0, slope, icept);
+    curves->scroll_curves[i][2] = CurveSegment(INFINITY, 0, slope, icept);
+  }
+  return curves;
+}
+
+void AccelFilterInterpreter::CompiledCurve::Compile(const CurveSegment* segs,
+                                                    size_t count) {
+  source_ = segs;
+  segs_.clear();
+  double last_boundary = 0.0;
+  for (size_t i = 0; i < count; i++) {
+    segs_.push_back(segs[i]);
+    if (isinf(segs[i].x_))
+      break;
+    last_boundary = std::max(last_boundary, segs[i].x_);
+  }
+  size_t buckets = kBucketsPerSegment * segs_.size();
+  bucket_scale_ = last_boundary > 0.0 ? buckets / last_boundary : 0.0;
+  // Each bucket starts at the first segment whose boundary lands in it or
+  // a later one. Speeds in the bucket are at least as large as every
+  // boundary before that.
+  starts_.assign(buckets + 1, segs_.size());
+  size_t bucket = 0;
+  for (size_t i = 0; i < segs_.size(); i++)
+    for (size_t last = Bucket(segs_[i].x_); bucket <= last; bucket++)
+      starts_[bucket] = i;
+}
+
+size_t AccelFilterInterpreter::CompiledCurve::Bucket(double mag) const {
+  size_t last = starts_.size() - 1;
+  if (!(mag > 0.0))
+    return 0;
+  double bucket = mag * bucket_scale_;
+  return bucket < last ? static_cast<size_t>(bucket) : last;
+}
+
+const AccelFilterInterpreter::CurveSegment*
+AccelFilterInterpreter::CompiledCurve::Find(float mag) const {
+  for (size_t i = starts_[Bucket(mag)]; i < segs_.size(); i++)
+    if (mag <= segs_[i].x_)
+      return &segs_[i];
+  return NULL;
+}
+
+void AccelFilterInterpreter::DoubleArrayWasWritten(DoubleArrayProperty* prop) {
+  if (prop == &mouse_accel_points_prop_)
+    SetMouseAccelPoints();
+  // A custom curve may have changed.
+  point_curve_.source_ = scroll_curve_.source_ = NULL;
+}
+
+void AccelFilterInterpreter::SetMouseAccelPoints() {
+  double last_x = 0.0;
+  double last_y = 0.0;
+  size_t count = 0;
+  for (size_t i = 0; i < kMaxAccelPoints; i++) {
+    double x = mouse_accel_points_[2 * i];
+    double y = mouse_accel_points_[2 * i + 1];
+    if (!(x > last_x))
+      break;
+    if (y < last_y)
+      Err("Mouse accel points slow down at %f mm/s", x);
+    double slope = (y - last_y) / (x - last_x);
+    mouse_accel_points_curve_[count++] =
+        CurveSegment(x, 0.0, slope, last_y - slope * last_x);
+    last_x = x;
+    last_y = y;
+  }
+  if (count) {
+    // Past the last point, keep going with its slope.
+    mouse_accel_points_curve_[count] = mouse_accel_points_curve_[count - 1];
+    mouse_accel_points_curve_[count].x_ = INFINITY;
+  } else {
+    // No acceleration
+    mouse_accel_points_curve_[count] = CurveSegment();
   }
+  point_curve_.source_ = NULL;
 }
 
 void AccelFilterInterpreter::ConsumeGesture(const Gesture& gs) {
   Gesture copy = gs;
-  CurveSegment* segs = NULL;
+  const CurveSegment* segs = NULL;
+  CompiledCurve* curve = NULL;
   float* dx = NULL;
   float* dy = NULL;
 
@@ -189,7 +296,11 @@ void AccelFilterInterpreter::ConsumeGesture(const Gesture& gs) {
         scale_out_x = dx = &copy.details.swipe.dx;
         scale_out_y = dy = &copy.details.swipe.dy;
       }
-      if (use_mouse_point_curves_.val_ && use_custom_mouse_curve_.val_) {
+      if (use_mouse_point_curves_.val_ && use_mouse_accel_points_.val_) {
+        segs = mouse_accel_points_curve_;
+        max_segs = arraysize(mouse_accel_points_curve_);
+      } else if (use_mouse_point_curves_.val_ &&
+                 use_custom_mouse_curve_.val_) {
         segs = mouse_custom_point_;
         max_segs = kMaxCustomCurveSegs;
       } else if (!use_mouse_point_curves_.val_ &&
@@ -199,13 +310,15 @@ void AccelFilterInterpreter::ConsumeGesture(const Gesture& gs) {
       } else {
         if (use_mouse_point_curves_.val_) {
           if (use_old_mouse_point_curves_.val_)
-            segs = old_mouse_point_curves_[pointer_sensitivity_.val_ - 1];
+            segs = curves_->old_mouse_point_curves[
+                pointer_sensitivity_.val_ - 1];
           else
-            segs = mouse_point_curves_[pointer_sensitivity_.val_ - 1];
+            segs = curves_->mouse_point_curves[pointer_sensitivity_.val_ - 1];
         } else {
-          segs = point_curves_[pointer_sensitivity_.val_ - 1];
+          segs = curves_->point_curves[pointer_sensitivity_.val_ - 1];
         }
       }
+      curve = &point_curve_;
       x_scale = point_x_out_scale_.val_;
       y_scale = point_y_out_scale_.val_;
       break;
@@ -232,11 +345,12 @@ void AccelFilterInterpreter::ConsumeGesture(const Gesture& gs) {
         return;
       }
       if (!use_custom_tp_scroll_curve_.val_) {
-        segs = scroll_curves_[scroll_sensitivity_.val_ - 1];
+        segs = curves_->scroll_curves[scroll_sensitivity_.val_ - 1];
       } else {
         segs = tp_custom_scroll_;
         max_segs = kMaxCustomCurveSegs;
       }
+      curve = &scroll_curve_;
       x_scale = scroll_x_out_scale_.val_;
       y_scale = scroll_y_out_scale_.val_;
       break;
@@ -277,23 +391,24 @@ void AccelFilterInterpreter::ConsumeGesture(const Gesture& gs) {
     last_end_time_ = gs.end_time;
   }
 
-  for (size_t i = 0; i < max_segs; ++i) {
-    if (mag > segs[i].x_)
-      continue;
-    float ratio = segs[i].sqr_ * mag + segs[i].mul_ + segs[i].int_ / mag;
-    *scale_out_x *= ratio * x_scale;
-    *scale_out_y *= ratio * y_scale;
-    if (copy.type == kGestureTypeFling ||
-        copy.type == kGestureTypeScroll) {
-      // We don't accelerate the ordinal values as we do for normal ones
-      // because this is how the Chrome needs it.
-      *scale_out_x_ordinal *= x_scale;
-      *scale_out_y_ordinal *= y_scale;
-    }
-    ProduceGesture(copy);
+  if (curve->source_ != segs)
+    curve->Compile(segs, max_segs);
+  const CurveSegment* seg = curve->Find(mag);
+  if (!seg) {
+    Err("Overflowed acceleration curve!");
     return;
   }
-  Err("Overflowed acceleration curve!");
+  float ratio = seg->sqr_ * mag + seg->mul_ + seg->int_ / mag;
+  *scale_out_x *= ratio * x_scale;
+  *scale_out_y *= ratio * y_scale;
+  if (copy.type == kGestureTypeFling ||
+      copy.type == kGestureTypeScroll) {
+    // We don't accelerate the ordinal values as we do for normal ones
+    // because this is how the Chrome needs it.
+    *scale_out_x_ordinal *= x_scale;
+    *scale_out_y_ordinal *= y_scale;
+  }
+  ProduceGesture(copy);
 }
 
 }  // namespace gestures
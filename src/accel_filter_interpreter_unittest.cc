@@ -4,6 +4,7 @@
 
 #include <deque>
 #include <math.h>
+#include <string.h>
 #include <utility>
 #include <vector>
 
@@ -374,4 +375,116 @@ TEST(AccelFilterInterpreterTest, CustomAccelTest) {
   }
 }
 
+TEST(AccelFilterInterpreterTest, SharedCurvesTest) {
+  SharedResources resources;
+  AccelFilterInterpreter first(
+      NULL, new AccelFilterInterpreterTestInterpreter, NULL, &resources);
+  AccelFilterInterpreter second(
+      NULL, new AccelFilterInterpreterTestInterpreter, NULL, &resources);
+  AccelFilterInterpreter third(
+      NULL, new AccelFilterInterpreterTestInterpreter, NULL);
+  EXPECT_EQ(first.curves_.get(), second.curves_.get());
+  EXPECT_NE(first.curves_.get(), third.curves_.get());
+  EXPECT_EQ(0, memcmp(first.curves_.get(), third.curves_.get(),
+                      sizeof(*first.curves_)));
+}
+
+// Lookups in a compiled curve must find the same segment as a scan.
+TEST(AccelFilterInterpreterTest, CompiledCurveTest) {
+  typedef AccelFilterInterpreter::CurveSegment CurveSegment;
+  // Uneven segment widths, so buckets hold several boundaries or none
+  CurveSegment segs[] = {
+    CurveSegment(0.5, 0.0, 1.0, 0.0),
+    CurveSegment(0.6, 0.0, 1.0, 0.0),
+    CurveSegment(3.0, 0.0, 1.0, 0.0),
+    CurveSegment(3.0, 0.0, 1.0, 0.0),
+    CurveSegment(40.0, 0.0, 1.0, 0.0),
+    CurveSegment(41.0, 0.0, 1.0, 0.0),
+    CurveSegment(INFINITY, 0.0, 1.0, 0.0),
+    // Never used
+    CurveSegment(50.0, 0.0, 1.0, 0.0),
+  };
+  AccelFilterInterpreter::CompiledCurve curve;
+  curve.Compile(segs, arraysize(segs));
+  EXPECT_EQ(segs, curve.source_);
+
+  std::vector<float> mags;
+  for (size_t i = 0; i < arraysize(segs); i++) {
+    float boundary = segs[i].x_;
+    mags.push_back(boundary);
+    mags.push_back(nextafterf(boundary, 0.0));
+    mags.push_back(nextafterf(boundary, INFINITY));
+  }
+  for (float mag = 0.0; mag < 60.0; mag += 0.01)
+    mags.push_back(mag);
+  for (size_t i = 0; i < mags.size(); i++) {
+    size_t expected = 0;
+    while (mags[i] > segs[expected].x_)
+      expected++;
+    const CurveSegment* seg = curve.Find(mags[i]);
+    ASSERT_NE(reinterpret_cast<const CurveSegment*>(NULL), seg)
+        << "mag=" << mags[i];
+    EXPECT_EQ(segs[expected].x_, seg->x_) << "mag=" << mags[i];
+  }
+
+  // Without a last segment to infinity, fast speeds fall off the end.
+  curve.Compile(segs, 3);
+  EXPECT_DOUBLE_EQ(3.0, curve.Find(3.0)->x_);
+  EXPECT_EQ(reinterpret_cast<const CurveSegment*>(NULL), curve.Find(3.5));
+  EXPECT_EQ(reinterpret_cast<const CurveSegment*>(NULL), curve.Find(INFINITY));
+
+  // Only a segment to infinity
+  CurveSegment flat;
+  curve.Compile(&flat, 1);
+  EXPECT_EQ(INFINITY, curve.Find(0.0)->x_);
+  EXPECT_EQ(INFINITY, curve.Find(1000.0)->x_);
+}
+
+TEST(AccelFilterInterpreterTest, AccelPointsTest) {
+  AccelFilterInterpreterTestInterpreter* base_interpreter =
+      new AccelFilterInterpreterTestInterpreter;
+  AccelFilterInterpreter accel_interpreter(NULL, base_interpreter, NULL);
+  TestInterpreterWrapper interpreter(&accel_interpreter);
+  accel_interpreter.min_reasonable_dt_.val_ = 0.0;
+  accel_interpreter.max_reasonable_dt_.val_ = INFINITY;
+  accel_interpreter.use_mouse_point_curves_.val_ = 1;
+  accel_interpreter.use_mouse_accel_points_.val_ = 1;
+
+  // Without points, there's no acceleration.
+  base_interpreter->return_values_.push_back(
+      Gesture(kGestureMove, 1, 2, 30.0, 0));
+  Gesture* out = interpreter.SyncInterpret(NULL, NULL);
+  ASSERT_NE(reinterpret_cast<Gesture*>(NULL), out);
+  EXPECT_FLOAT_EQ(30.0, out->details.move.dx);
+
+  // The points end at the first one that doesn't go faster.
+  const double kPoints[] = { 10.0, 5.0, 20.0, 25.0, 15.0, 100.0 };
+  memcpy(accel_interpreter.mouse_accel_points_, kPoints, sizeof(kPoints));
+  accel_interpreter.DoubleArrayWasWritten(
+      &accel_interpreter.mouse_accel_points_prop_);
+
+  // Moves over one second, so distances are speeds
+  float move_in[]  = { 4.0, 10.0, 15.0, 20.0, 30.0 };
+  float move_out[] = { 2.0,  5.0, 15.0, 25.0, 45.0 };
+  for (size_t i = 0; i < arraysize(move_in); ++i) {
+    base_interpreter->return_values_.push_back(
+        Gesture(kGestureMove, 1, 2, move_in[i], 0));
+    out = interpreter.SyncInterpret(NULL, NULL);
+    ASSERT_NE(reinterpret_cast<Gesture*>(NULL), out) << "i=" << i;
+    EXPECT_EQ(kGestureTypeMove, out->type) << "i=" << i;
+    EXPECT_FLOAT_EQ(move_out[i], out->details.move.dx) << "i=" << i;
+  }
+
+  // The other mouse curves apply when the points are turned off.
+  accel_interpreter.use_mouse_accel_points_.val_ = 0;
+  accel_interpreter.use_custom_mouse_curve_.val_ = 1;
+  accel_interpreter.DoubleArrayWasWritten(
+      &accel_interpreter.mouse_custom_point_prop_);
+  base_interpreter->return_values_.push_back(
+      Gesture(kGestureMove, 1, 2, 30.0, 0));
+  out = interpreter.SyncInterpret(NULL, NULL);
+  ASSERT_NE(reinterpret_cast<Gesture*>(NULL), out);
+  EXPECT_FLOAT_EQ(30.0, out->details.move.dx);
+}
+
 }  // namespace gestures
@@ -359,9 +359,9 @@ Json::Value ActivityLog::EncodePropRegistry() {
   if (!prop_reg_)
     return ret;
 
-  const set<Property*>& props = prop_reg_->props();
-  for (set<Property*>::const_iterator it = props.begin(), e = props.end();
-       it != e; ++it) {
+  const std::vector<Property*>& props = prop_reg_->props();
+  for (std::vector<Property*>::const_iterator it = props.begin(),
+           e = props.end(); it != e; ++it) {
     ret[(*it)->name()] = (*it)->NewValue();
   }
   return ret;
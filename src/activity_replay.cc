@@ -98,9 +98,9 @@ bool ActivityReplay::ParseProperties(const Json::Value& dict,
                                      const std::set<string>& honor_props) {
   if (!prop_reg_)
     return true;
-  ::set<Property*> props = prop_reg_->props();
-  for (::set<Property*>::const_iterator it = props.begin(), e = props.end();
-       it != e; ++it) {
+  const std::vector<Property*>& props = prop_reg_->props();
+  for (std::vector<Property*>::const_iterator it = props.begin(),
+           e = props.end(); it != e; ++it) {
     const char* key = (*it)->name();
 
     // TODO(clchiou): This is just a emporary workaround for property changes.
@@ -711,15 +711,7 @@ bool ActivityReplay::ReplayPropChange(
     Err("Missing prop registry.");
     return false;
   }
-  ::set<Property*> props = prop_reg_->props();
-  Property* prop = NULL;
-  for (::set<Property*>::iterator it = props.begin(), e = props.end(); it != e;
-       ++it) {
-    prop = *it;
-    if (strcmp(prop->name(), entry.name) == 0)
-      break;
-    prop = NULL;
-  }
+  Property* prop = prop_reg_->GetProperty(entry.name);
   if (!prop) {
     Err("Unable to find prop %s to set.", entry.name);
     return false;
@@ -0,0 +1,128 @@
+// Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "gestures/include/assignment_solver.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+#include "gestures/include/logging.h"
+
+namespace gestures {
+
+const size_t AssignmentSolver::kMaxSize;
+const int AssignmentSolver::kUnassigned;
+
+AssignmentSolver::AssignmentSolver() {
+  Reset(0, 0);
+}
+
+void AssignmentSolver::Reset(size_t rows, size_t cols) {
+  if (rows > kMaxSize || cols > kMaxSize) {
+    Err("Assignment problem too large: %zu x %zu", rows, cols);
+    rows = std::min(rows, kMaxSize);
+    cols = std::min(cols, kMaxSize);
+  }
+  rows_ = rows;
+  cols_ = cols;
+  for (size_t i = 0; i < rows_; i++)
+    for (size_t j = 0; j < cols_; j++)
+      allowed_[i][j] = false;
+  std::fill(col_for_row_, col_for_row_ + kMaxSize, kUnassigned);
+  std::fill(row_for_col_, row_for_col_ + kMaxSize, kUnassigned);
+}
+
+void AssignmentSolver::SetCost(size_t row, size_t col, float cost) {
+  if (row >= rows_ || col >= cols_ || !(cost >= 0.0)) {
+    Err("Bad assignment cost %f at (%zu, %zu)", cost, row, col);
+    return;
+  }
+  cost_[row][col] = cost;
+  allowed_[row][col] = true;
+}
+
+size_t AssignmentSolver::Solve() {
+  std::fill(col_for_row_, col_for_row_ + kMaxSize, kUnassigned);
+  std::fill(row_for_col_, row_for_col_ + kMaxSize, kUnassigned);
+
+  // Make the matrix square, and give forbidden pairs a cost above that of
+  // any set of allowed ones, so a pairing with more allowed pairs always
+  // costs less than one with fewer.
+  const size_t n = std::max(rows_, cols_);
+  double max_cost = 0.0;
+  for (size_t i = 0; i < rows_; i++)
+    for (size_t j = 0; j < cols_; j++)
+      if (allowed_[i][j])
+        max_cost = std::max(max_cost, static_cast<double>(cost_[i][j]));
+  const double forbidden = n * max_cost + 1.0;
+
+  // Potentials for rows (u) and columns (v), and for each column the row
+  // it's paired with (p). Both are 1-based; column 0 is a sentinel.
+  double u[kMaxSize + 1], v[kMaxSize + 1], min_slack[kMaxSize + 1];
+  size_t p[kMaxSize + 1], way[kMaxSize + 1];
+  bool used[kMaxSize + 1];
+  for (size_t j = 0; j <= n; j++) {
+    u[j] = v[j] = 0.0;
+    p[j] = way[j] = 0;
+  }
+  for (size_t i = 1; i <= n; i++) {
+    // Add row i, finding the cheapest augmenting path for it.
+    p[0] = i;
+    size_t j0 = 0;
+    for (size_t j = 0; j <= n; j++) {
+      min_slack[j] = INFINITY;
+      used[j] = false;
+    }
+    do {
+      used[j0] = true;
+      const size_t i0 = p[j0];
+      double delta = INFINITY;
+      size_t j1 = 0;
+      for (size_t j = 1; j <= n; j++) {
+        if (used[j])
+          continue;
+        double cost = (i0 <= rows_ && j <= cols_ && allowed_[i0 - 1][j - 1]) ?
+            cost_[i0 - 1][j - 1] : forbidden;
+        double slack = cost - u[i0] - v[j];
+        if (slack < min_slack[j]) {
+          min_slack[j] = slack;
+          way[j] = j0;
+        }
+        if (min_slack[j] < delta) {
+          delta = min_slack[j];
+          j1 = j;
+        }
+      }
+      for (size_t j = 0; j <= n; j++) {
+        if (used[j]) {
+          u[p[j]] += delta;
+          v[j] -= delta;
+        } else {
+          min_slack[j] -= delta;
+        }
+      }
+      j0 = j1;
+    } while (p[j0] != 0);
+    // Flip the pairs along the path.
+    do {
+      const size_t j1 = way[j0];
+      p[j0] = p[j1];
+      j0 = j1;
+    } while (j0);
+  }
+
+  size_t pairs = 0;
+  for (size_t j = 1; j <= cols_; j++) {
+    const size_t i = p[j];
+    if (i == 0 || i > rows_ || !allowed_[i - 1][j - 1])
+      continue;
+    col_for_row_[i - 1] = j - 1;
+    row_for_col_[j - 1] = i - 1;
+    pairs++;
+  }
+  return pairs;
+}
+
+}  // namespace gestures
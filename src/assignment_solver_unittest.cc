@@ -0,0 +1,136 @@
+// Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include "gestures/include/assignment_solver.h"
+
+namespace gestures {
+
+class AssignmentSolverTest : public ::testing::Test {};
+
+namespace {
+struct BruteForceResult {
+  size_t pairs;
+  float cost;
+};
+
+// Tries every way to pair the rows with columns (or nothing).
+void BruteForce(const float cost[][4], size_t rows, size_t cols,
+                size_t row, bool* col_used, size_t pairs, float total,
+                BruteForceResult* best) {
+  if (row == rows) {
+    if (pairs > best->pairs ||
+        (pairs == best->pairs && total < best->cost)) {
+      best->pairs = pairs;
+      best->cost = total;
+    }
+    return;
+  }
+  BruteForce(cost, rows, cols, row + 1, col_used, pairs, total, best);
+  for (size_t j = 0; j < cols; j++) {
+    if (col_used[j] || cost[row][j] < 0.0)
+      continue;
+    col_used[j] = true;
+    BruteForce(cost, rows, cols, row + 1, col_used, pairs + 1,
+               total + cost[row][j], best);
+    col_used[j] = false;
+  }
+}
+}  // namespace {}
+
+TEST(AssignmentSolverTest, SimpleTest) {
+  AssignmentSolver solver;
+  // Taking row 0's cheapest column first leaves row 1 with a costly one.
+  solver.Reset(2, 2);
+  solver.SetCost(0, 0, 1.0);
+  solver.SetCost(0, 1, 2.0);
+  solver.SetCost(1, 0, 1.5);
+  solver.SetCost(1, 1, 10.0);
+  EXPECT_EQ(2U, solver.Solve());
+  EXPECT_EQ(1, solver.ColForRow(0));
+  EXPECT_EQ(0, solver.ColForRow(1));
+  EXPECT_EQ(1, solver.RowForCol(0));
+  EXPECT_EQ(0, solver.RowForCol(1));
+
+  // More pairs beat cheaper ones.
+  solver.Reset(2, 2);
+  solver.SetCost(0, 0, 0.0);
+  solver.SetCost(0, 1, 100.0);
+  solver.SetCost(1, 0, 100.0);
+  EXPECT_EQ(2U, solver.Solve());
+  EXPECT_EQ(1, solver.ColForRow(0));
+  EXPECT_EQ(0, solver.ColForRow(1));
+
+  // Rectangular, with a row that can't be paired.
+  solver.Reset(3, 1);
+  solver.SetCost(1, 0, 3.0);
+  solver.SetCost(2, 0, 2.0);
+  EXPECT_EQ(1U, solver.Solve());
+  EXPECT_EQ(AssignmentSolver::kUnassigned, solver.ColForRow(0));
+  EXPECT_EQ(AssignmentSolver::kUnassigned, solver.ColForRow(1));
+  EXPECT_EQ(0, solver.ColForRow(2));
+
+  solver.Reset(0, 3);
+  EXPECT_EQ(0U, solver.Solve());
+  solver.Reset(2, 2);
+  EXPECT_EQ(0U, solver.Solve());
+  EXPECT_EQ(AssignmentSolver::kUnassigned, solver.ColForRow(0));
+  EXPECT_EQ(AssignmentSolver::kUnassigned, solver.RowForCol(1));
+}
+
+TEST(AssignmentSolverTest, BruteForceTest) {
+  AssignmentSolver solver;
+  unsigned seed = 1;
+  for (size_t iter = 0; iter < 500; iter++) {
+    size_t rows = iter % 5, cols = (iter / 5) % 5;
+    float cost[4][4];
+    solver.Reset(rows, cols);
+    for (size_t i = 0; i < rows; i++) {
+      for (size_t j = 0; j < cols; j++) {
+        seed = seed * 1103515245 + 12345;
+        unsigned val = (seed >> 16) % 40;
+        // About a quarter of the pairs are forbidden.
+        cost[i][j] = val < 10 ? -1.0 : val * 0.25;
+        if (cost[i][j] >= 0.0)
+          solver.SetCost(i, j, cost[i][j]);
+      }
+    }
+    BruteForceResult expected = { 0, 0.0 };
+    bool col_used[4] = { false, false, false, false };
+    BruteForce(cost, rows, cols, 0, col_used, 0, 0.0, &expected);
+
+    EXPECT_EQ(expected.pairs, solver.Solve()) << "iter=" << iter;
+    float total = 0.0;
+    for (size_t i = 0; i < rows; i++) {
+      int j = solver.ColForRow(i);
+      if (j == AssignmentSolver::kUnassigned)
+        continue;
+      ASSERT_LT(static_cast<size_t>(j), cols);
+      EXPECT_GE(cost[i][j], 0.0) << "iter=" << iter;
+      EXPECT_EQ(static_cast<int>(i), solver.RowForCol(j));
+      total += cost[i][j];
+    }
+    EXPECT_FLOAT_EQ(expected.cost, total) << "iter=" << iter;
+  }
+}
+
+TEST(AssignmentSolverTest, FullSizeTest) {
+  const size_t kSize = AssignmentSolver::kMaxSize;
+  AssignmentSolver solver;
+  // Contacts on a line, each moved a little to the right: the solver should
+  // follow each one rather than let them swap.
+  solver.Reset(kSize, kSize);
+  for (size_t i = 0; i < kSize; i++) {
+    for (size_t j = 0; j < kSize; j++) {
+      float dist = 10.0 * j + 3.0 - 10.0 * i;
+      solver.SetCost(i, j, dist * dist);
+    }
+  }
+  EXPECT_EQ(kSize, solver.Solve());
+  for (size_t i = 0; i < kSize; i++)
+    EXPECT_EQ(static_cast<int>(i), solver.ColForRow(i));
+}
+
+}  // namespace gestures
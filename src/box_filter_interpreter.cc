@@ -15,8 +15,10 @@ BoxFilterInterpreter::BoxFilterInterpreter(PropRegistry* prop_reg,
                                            Tracer* tracer)
     : FilterInterpreter(NULL, next, tracer, false),
       box_width_(prop_reg, "Box Width", 0.0),
-      box_height_(prop_reg, "Box Height", 0.0) {
+      box_height_(prop_reg, "Box Height", 0.0),
+      output_history_(1) {
   InitName();
+  output_history_.Reset(kMaxFingers);
 }
 
 void BoxFilterInterpreter::SyncInterpretImpl(HardwareState* hwstate,
@@ -25,17 +27,15 @@ void BoxFilterInterpreter::SyncInterpretImpl(HardwareState* hwstate,
     next_->SyncInterpret(hwstate, timeout);
     return;
   }
-  RemoveMissingIdsFromMap(&previous_output_, *hwstate);
-
   const float kHalfWidth = box_width_.val_ * 0.5;
   const float kHalfHeight = box_height_.val_ * 0.5;
 
   for (size_t i = 0; i < hwstate->finger_cnt; i++) {
     FingerState& fs = hwstate->fingers[i];
     // If it's new, pass it through
-    if (!MapContainsKey(previous_output_, fs.tracking_id))
+    const FingerState* prev_out = output_history_.GetFinger(0, fs.tracking_id);
+    if (!prev_out)
       continue;
-    const FingerState& prev_out = previous_output_[fs.tracking_id];
     float FingerState::*fields[] = { &FingerState::position_x,
                                      &FingerState::position_y };
     const float kBounds[] = { kHalfWidth, kHalfHeight };
@@ -45,7 +45,7 @@ void BoxFilterInterpreter::SyncInterpretImpl(HardwareState* hwstate,
       if (fs.flags & warp[f_idx])  // If warping, just move to the new point
         continue;
       float FingerState::*field = fields[f_idx];
-      float prev_out_val = prev_out.*field;
+      float prev_out_val = prev_out->*field;
       float val = fs.*field;
       float bound = kBounds[f_idx];
 
@@ -60,8 +60,7 @@ void BoxFilterInterpreter::SyncInterpretImpl(HardwareState* hwstate,
     }
   }
 
-  for (size_t i = 0; i < hwstate->finger_cnt; i++)
-    previous_output_[hwstate->fingers[i].tracking_id] = hwstate->fingers[i];
+  output_history_.PushState(*hwstate);
 
   next_->SyncInterpret(hwstate, timeout);
 }
@@ -0,0 +1,367 @@
+// Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "gestures/include/config_profile.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "gestures/include/eintr_wrapper.h"
+#include "gestures/include/logging.h"
+#include "gestures/include/prop_registry.h"
+
+using std::string;
+
+namespace gestures {
+
+namespace {
+const size_t kValueAlignment = sizeof(double);
+
+class FingerprintHash {
+ public:
+  FingerprintHash() : hash_(2166136261u) {}  // FNV-1a
+  void Add(const void* data, size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; i++) {
+      hash_ ^= bytes[i];
+      hash_ *= 16777619u;
+    }
+  }
+  void AddFloat(float val) { Add(&val, sizeof(val)); }
+  uint32_t hash() const { return hash_; }
+ private:
+  uint32_t hash_;
+};
+}  // namespace {}
+
+const uint32_t ConfigProfile::kMagic;
+const uint32_t ConfigProfile::kVersion;
+const uint32_t ConfigProfile::kAnyDevice;
+
+ConfigProfile::~ConfigProfile() {
+  if (data_)
+    munmap(const_cast<char*>(data_), size_);
+}
+
+bool ConfigProfile::Open(const char* path) {
+  if (data_) {
+    Err("Config profile already open");
+    return false;
+  }
+  int fd = HANDLE_EINTR(open(path, O_RDONLY));
+  if (fd < 0) {
+    Err("Unable to open config profile %s", path);
+    return false;
+  }
+  struct stat st;
+  void* mapped = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size > 0)
+    mapped = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  IGNORE_EINTR(close(fd));
+  if (mapped == MAP_FAILED) {
+    Err("Unable to map config profile %s", path);
+    return false;
+  }
+  data_ = static_cast<const char*>(mapped);
+  size_ = st.st_size;
+  if (!Validate()) {
+    Err("Invalid config profile %s", path);
+    munmap(mapped, size_);
+    data_ = NULL;
+    size_ = 0;
+    return false;
+  }
+  return true;
+}
+
+bool ConfigProfile::Validate() const {
+  if (size_ < sizeof(Header))
+    return false;
+  const Header* head = header();
+  if (head->magic != kMagic || head->version != kVersion ||
+      head->size != size_)
+    return false;
+  // 64 bits, so that huge counts can't wrap around.
+  uint64_t tables_end = sizeof(Header) +
+      static_cast<uint64_t>(head->entry_count) * sizeof(Entry) +
+      static_cast<uint64_t>(head->setting_count) * sizeof(Setting);
+  uint64_t values_end = head->values_offset +
+      static_cast<uint64_t>(head->value_count) * sizeof(double);
+  if (tables_end > head->values_offset ||
+      head->values_offset % kValueAlignment ||
+      values_end > head->strings_offset ||
+      head->strings_offset > size_)
+    return false;
+  // Then every string runs into a NUL before the end of the file.
+  if (head->strings_offset < size_ && data_[size_ - 1] != '\0')
+    return false;
+
+  for (size_t i = 0; i < head->entry_count; i++) {
+    const Entry& entry = entries()[i];
+    if (static_cast<uint64_t>(entry.first_setting) + entry.setting_count >
+        head->setting_count)
+      return false;
+  }
+  for (size_t i = 0; i < head->setting_count; i++) {
+    const Setting& setting = settings()[i];
+    if (setting.name_offset < head->strings_offset ||
+        setting.name_offset >= size_)
+      return false;
+    switch (setting.type) {
+      case GESTURES_PROP_STRING:
+        if (setting.count || setting.value < head->strings_offset ||
+            setting.value >= size_)
+          return false;
+        break;
+      case GESTURES_PROP_INT:
+      case GESTURES_PROP_BOOL:
+      case GESTURES_PROP_REAL:
+        if (static_cast<uint64_t>(setting.value) +
+            (setting.count ? setting.count : 1) > head->value_count)
+          return false;
+        break;
+      default:
+        return false;
+    }
+  }
+  return true;
+}
+
+size_t ConfigProfile::Apply(GestureInterpreterDeviceClass cls,
+                            uint32_t fingerprint,
+                            PropRegistry* prop_reg) const {
+  if (!data_)
+    return 0;
+  size_t applied = 0;
+  // Class-wide entries first, so the device's own ones win.
+  for (size_t i = 0; i < header()->entry_count; i++) {
+    const Entry& entry = entries()[i];
+    if (entry.device_class == static_cast<uint32_t>(cls) &&
+        entry.fingerprint == kAnyDevice)
+      applied += ApplyEntry(entry, prop_reg);
+  }
+  if (fingerprint == kAnyDevice)
+    return applied;
+  for (size_t i = 0; i < header()->entry_count; i++) {
+    const Entry& entry = entries()[i];
+    if (entry.device_class == static_cast<uint32_t>(cls) &&
+        entry.fingerprint == fingerprint)
+      applied += ApplyEntry(entry, prop_reg);
+  }
+  return applied;
+}
+
+size_t ConfigProfile::ApplyEntry(const Entry& entry,
+                                 PropRegistry* prop_reg) const {
+  size_t applied = 0;
+  for (size_t i = 0; i < entry.setting_count; i++) {
+    const Setting& setting = settings()[entry.first_setting + i];
+    const char* name = data_ + setting.name_offset;
+    Property* prop = prop_reg->GetProperty(name);
+    if (!prop) {
+      Err("Config profile sets unknown property %s", name);
+      continue;
+    }
+    if (!prop->SetValue(SettingValue(setting))) {
+      Err("Config profile has a bad value for property %s", name);
+      continue;
+    }
+    prop->HandleGesturesPropWritten();
+    applied++;
+  }
+  return applied;
+}
+
+Json::Value ConfigProfile::SettingValue(const Setting& setting) const {
+  if (setting.type == GESTURES_PROP_STRING)
+    return Json::Value(data_ + setting.value);
+  size_t count = setting.count ? setting.count : 1;
+  Json::Value list(Json::arrayValue);
+  for (size_t i = 0; i < count; i++) {
+    double val = values()[setting.value + i];
+    Json::Value elt;
+    if (setting.type == GESTURES_PROP_BOOL)
+      elt = Json::Value(val != 0.0);
+    else if (setting.type == GESTURES_PROP_INT)
+      elt = Json::Value(static_cast<int>(val));
+    else
+      elt = Json::Value(val);
+    if (!setting.count)
+      return elt;
+    list.append(elt);
+  }
+  return list;
+}
+
+uint32_t ConfigProfile::Fingerprint(const HardwareProperties& hwprops) {
+  // Field by field, since the struct has padding and bitfields. Screen DPI
+  // describes the display, not the device, so it's left out.
+  FingerprintHash hash;
+  hash.AddFloat(hwprops.left);
+  hash.AddFloat(hwprops.top);
+  hash.AddFloat(hwprops.right);
+  hash.AddFloat(hwprops.bottom);
+  hash.AddFloat(hwprops.res_x);
+  hash.AddFloat(hwprops.res_y);
+  hash.AddFloat(hwprops.orientation_minimum);
+  hash.AddFloat(hwprops.orientation_maximum);
+  hash.Add(&hwprops.max_finger_cnt, sizeof(hwprops.max_finger_cnt));
+  hash.Add(&hwprops.max_touch_cnt, sizeof(hwprops.max_touch_cnt));
+  unsigned char flags = hwprops.supports_t5r2 |
+      hwprops.support_semi_mt << 1 |
+      hwprops.is_button_pad << 2 |
+      hwprops.has_wheel << 3;
+  hash.Add(&flags, sizeof(flags));
+  return hash.hash() == kAnyDevice ? 1 : hash.hash();
+}
+
+bool ConfigProfileBuilder::ScalarType(const Json::Value& value,
+                                      uint32_t* type) {
+  switch (value.type()) {
+    case Json::booleanValue:
+      *type = GESTURES_PROP_BOOL;
+      return true;
+    case Json::intValue:
+    case Json::uintValue:
+      *type = GESTURES_PROP_INT;
+      return true;
+    case Json::realValue:
+      *type = GESTURES_PROP_REAL;
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool ConfigProfileBuilder::ParseValue(const Json::Value& value,
+                                      ConfigProfile::Setting* setting,
+                                      std::vector<double>* values) {
+  setting->count = 0;
+  if (value.type() == Json::stringValue) {
+    setting->type = GESTURES_PROP_STRING;
+    return true;
+  }
+  if (value.type() != Json::arrayValue) {
+    if (!ScalarType(value, &setting->type))
+      return false;
+    values->push_back(value.type() == Json::booleanValue ?
+                      value.asBool() : value.asDouble());
+    return true;
+  }
+  if (!value.size() || !ScalarType(value[0], &setting->type))
+    return false;
+  setting->count = value.size();
+  for (Json::Value::ArrayIndex i = 0; i < value.size(); i++) {
+    uint32_t type;
+    if (!ScalarType(value[i], &type))
+      return false;
+    // Arrays mixing ints and reals are reals.
+    if (type != setting->type) {
+      if (type == GESTURES_PROP_BOOL || setting->type == GESTURES_PROP_BOOL)
+        return false;
+      setting->type = GESTURES_PROP_REAL;
+    }
+    values->push_back(value[i].type() == Json::booleanValue ?
+                      value[i].asBool() : value[i].asDouble());
+  }
+  return true;
+}
+
+bool ConfigProfileBuilder::AddEntry(GestureInterpreterDeviceClass cls,
+                                    uint32_t fingerprint,
+                                    const Json::Value& props) {
+  if (props.type() != Json::objectValue) {
+    Err("Config profile entry must be an object");
+    return false;
+  }
+  std::vector<PendingSetting> settings;
+  std::vector<double> values;
+  Json::Value::Members names = props.getMemberNames();
+  for (size_t i = 0; i < names.size(); i++) {
+    const Json::Value& value = props[names[i]];
+    PendingSetting pending;
+    pending.name = names[i];
+    pending.setting.value = values_.size() + values.size();
+    if (!ParseValue(value, &pending.setting, &values)) {
+      Err("Unsupported value for property %s", names[i].c_str());
+      return false;
+    }
+    if (pending.setting.type == GESTURES_PROP_STRING)
+      pending.string_val = value.asString();
+    settings.push_back(pending);
+  }
+  ConfigProfile::Entry entry;
+  entry.device_class = cls;
+  entry.fingerprint = fingerprint;
+  entry.first_setting = settings_.size();
+  entry.setting_count = settings.size();
+  entries_.push_back(entry);
+  settings_.insert(settings_.end(), settings.begin(), settings.end());
+  values_.insert(values_.end(), values.begin(), values.end());
+  return true;
+}
+
+string ConfigProfileBuilder::Build() const {
+  ConfigProfile::Header head;
+  head.magic = ConfigProfile::kMagic;
+  head.version = ConfigProfile::kVersion;
+  head.entry_count = entries_.size();
+  head.setting_count = settings_.size();
+  size_t tables_end = sizeof(head) +
+      entries_.size() * sizeof(ConfigProfile::Entry) +
+      settings_.size() * sizeof(ConfigProfile::Setting);
+  head.values_offset =
+      (tables_end + kValueAlignment - 1) / kValueAlignment * kValueAlignment;
+  head.value_count = values_.size();
+  head.strings_offset = head.values_offset + values_.size() * sizeof(double);
+
+  string strings;
+  std::vector<ConfigProfile::Setting> settings;
+  for (size_t i = 0; i < settings_.size(); i++) {
+    ConfigProfile::Setting setting = settings_[i].setting;
+    setting.name_offset = head.strings_offset + strings.size();
+    strings.append(settings_[i].name.c_str(), settings_[i].name.size() + 1);
+    if (setting.type == GESTURES_PROP_STRING) {
+      setting.value = head.strings_offset + strings.size();
+      strings.append(settings_[i].string_val.c_str(),
+                     settings_[i].string_val.size() + 1);
+    }
+    settings.push_back(setting);
+  }
+  head.size = head.strings_offset + strings.size();
+
+  string ret(reinterpret_cast<const char*>(&head), sizeof(head));
+  if (!entries_.empty())
+    ret.append(reinterpret_cast<const char*>(&entries_[0]),
+               entries_.size() * sizeof(entries_[0]));
+  if (!settings.empty())
+    ret.append(reinterpret_cast<const char*>(&settings[0]),
+               settings.size() * sizeof(settings[0]));
+  ret.resize(head.values_offset, '\0');
+  if (!values_.empty())
+    ret.append(reinterpret_cast<const char*>(&values_[0]),
+               values_.size() * sizeof(values_[0]));
+  ret.append(strings);
+  return ret;
+}
+
+}  // namespace gestures
+
+// C API:
+
+GesturesConfigProfile* NewGesturesConfigProfile(const char* path) {
+  gestures::ConfigProfile* profile = new gestures::ConfigProfile();
+  if (!profile->Open(path)) {
+    delete profile;
+    return NULL;
+  }
+  return profile;
+}
+
+void DeleteGesturesConfigProfile(GesturesConfigProfile* profile) {
+  delete profile;
+}
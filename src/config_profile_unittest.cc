@@ -0,0 +1,191 @@
+// Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <string>
+
+#include <gtest/gtest.h>
+#include <json/value.h>
+
+#include "gestures/include/config_profile.h"
+#include "gestures/include/file_util.h"
+#include "gestures/include/gestures.h"
+#include "gestures/include/prop_registry.h"
+
+using std::string;
+
+namespace gestures {
+
+class ConfigProfileTest : public ::testing::Test {};
+
+namespace {
+HardwareProperties hwprops = {
+  0, 0, 100, 60,  // left, top, right, bottom
+  10, 10, 133, 133,  // res, dpi
+  0, 0,  // orientation minimum, maximum
+  5, 5, 0, 0, 1, 0  // max fingers, max_touch, t5r2, semi_mt, button pad, wheel
+};
+
+// Writes |contents| to a new temporary file, whose path goes in |path|.
+bool WriteTempFile(const string& contents, string* path) {
+  char temp[] = "/tmp/config_profile_unittest_XXXXXX";
+  int fd = mkstemp(temp);
+  if (fd < 0)
+    return false;
+  close(fd);
+  *path = temp;
+  return WriteFile(temp, contents.data(), contents.size()) ==
+      static_cast<int>(contents.size());
+}
+}  // namespace {}
+
+TEST(ConfigProfileTest, BuildAndApplyTest) {
+  Json::Value defaults(Json::objectValue);
+  defaults["Int"] = 3;
+  defaults["Double"] = 2;
+  defaults["Short"] = 4;
+  defaults["Bools"] = Json::Value(Json::arrayValue);
+  defaults["Bools"].append(true);
+  defaults["Bools"].append(false);
+  defaults["Curve"] = Json::Value(Json::arrayValue);
+  defaults["Curve"].append(1);
+  defaults["Curve"].append(2.5);
+  defaults["String"] = "abc";
+  Json::Value device(Json::objectValue);
+  device["Int"] = 5;
+  device["Unknown"] = 1;
+  // Wrong type for the property
+  device["String"] = 1.5;
+
+  ConfigProfileBuilder builder;
+  uint32_t fingerprint = ConfigProfile::Fingerprint(hwprops);
+  EXPECT_TRUE(builder.AddEntry(GESTURES_DEVCLASS_TOUCHPAD,
+                               ConfigProfile::kAnyDevice, defaults));
+  EXPECT_TRUE(builder.AddEntry(GESTURES_DEVCLASS_TOUCHPAD, fingerprint,
+                               device));
+  Json::Value bad(Json::objectValue);
+  bad["Object"] = Json::Value(Json::objectValue);
+  EXPECT_FALSE(builder.AddEntry(GESTURES_DEVCLASS_MOUSE,
+                                ConfigProfile::kAnyDevice, bad));
+  string path;
+  ASSERT_TRUE(WriteTempFile(builder.Build(), &path));
+  ConfigProfile profile;
+  ASSERT_TRUE(profile.Open(path.c_str()));
+  unlink(path.c_str());
+
+  PropRegistry reg;
+  IntProperty int_prop(&reg, "Int", 0);
+  DoubleProperty double_prop(&reg, "Double", 0.0);
+  ShortProperty short_prop(&reg, "Short", 0);
+  GesturesPropBool bools[] = { false, true };
+  BoolArrayProperty bools_prop(&reg, "Bools", bools, arraysize(bools));
+  double curve[] = { 0.0, 0.0 };
+  DoubleArrayProperty curve_prop(&reg, "Curve", curve, arraysize(curve));
+  StringProperty string_prop(&reg, "String", "");
+
+  EXPECT_EQ(0, profile.Apply(GESTURES_DEVCLASS_MOUSE, fingerprint, &reg));
+  EXPECT_EQ(6, profile.Apply(GESTURES_DEVCLASS_TOUCHPAD,
+                             ConfigProfile::kAnyDevice, &reg));
+  EXPECT_EQ(3, int_prop.val_);
+  EXPECT_DOUBLE_EQ(2.0, double_prop.val_);
+  EXPECT_EQ(4, short_prop.val_);
+  EXPECT_TRUE(bools[0]);
+  EXPECT_FALSE(bools[1]);
+  EXPECT_DOUBLE_EQ(1.0, curve[0]);
+  EXPECT_DOUBLE_EQ(2.5, curve[1]);
+  EXPECT_STREQ("abc", string_prop.val_);
+
+  // The device's own entry goes on top; its bad settings are skipped.
+  EXPECT_EQ(7, profile.Apply(GESTURES_DEVCLASS_TOUCHPAD, fingerprint, &reg));
+  EXPECT_EQ(5, int_prop.val_);
+  EXPECT_STREQ("abc", string_prop.val_);
+}
+
+TEST(ConfigProfileTest, InvalidFileTest) {
+  EXPECT_EQ(NULL, NewGesturesConfigProfile("/nonexistent/profile"));
+
+  Json::Value props(Json::objectValue);
+  props["Int"] = 3;
+  props["String"] = "abc";
+  ConfigProfileBuilder builder;
+  EXPECT_TRUE(builder.AddEntry(GESTURES_DEVCLASS_TOUCHPAD,
+                               ConfigProfile::kAnyDevice, props));
+  string contents = builder.Build();
+
+  string bad_files[] = {
+    contents.substr(0, contents.size() - 1),  // truncated
+    contents.substr(0, 8),
+    string("XXXX") + contents.substr(4),  // magic
+    contents,
+  };
+  // A name that runs off the end of the file
+  bad_files[3][bad_files[3].size() - 1] = 'x';
+  for (size_t i = 0; i < arraysize(bad_files); i++) {
+    string path;
+    ASSERT_TRUE(WriteTempFile(bad_files[i], &path));
+    ConfigProfile profile;
+    EXPECT_FALSE(profile.Open(path.c_str())) << "file " << i;
+    unlink(path.c_str());
+  }
+
+  string path;
+  ASSERT_TRUE(WriteTempFile(contents, &path));
+  GesturesConfigProfile* profile = NewGesturesConfigProfile(path.c_str());
+  EXPECT_TRUE(profile);
+  DeleteGesturesConfigProfile(profile);
+  unlink(path.c_str());
+}
+
+TEST(ConfigProfileTest, FingerprintTest) {
+  HardwareProperties other = hwprops;
+  EXPECT_EQ(ConfigProfile::Fingerprint(hwprops),
+            ConfigProfile::Fingerprint(other));
+  EXPECT_NE(ConfigProfile::kAnyDevice, ConfigProfile::Fingerprint(hwprops));
+  // The display's DPI doesn't matter.
+  other.screen_x_dpi = 96;
+  EXPECT_EQ(ConfigProfile::Fingerprint(hwprops),
+            ConfigProfile::Fingerprint(other));
+  other.is_button_pad = 0;
+  EXPECT_NE(ConfigProfile::Fingerprint(hwprops),
+            ConfigProfile::Fingerprint(other));
+  other = hwprops;
+  other.right = 101;
+  EXPECT_NE(ConfigProfile::Fingerprint(hwprops),
+            ConfigProfile::Fingerprint(other));
+}
+
+// Profile values are in place before the provider's properties are created,
+// so the provider sees them as initial values.
+TEST(ConfigProfileTest, GestureInterpreterTest) {
+  Json::Value props(Json::objectValue);
+  props["Pointer Sensitivity"] = 5;
+  ConfigProfileBuilder builder;
+  EXPECT_TRUE(builder.AddEntry(GESTURES_DEVCLASS_MOUSE,
+                               ConfigProfile::Fingerprint(hwprops), props));
+  string path;
+  ASSERT_TRUE(WriteTempFile(builder.Build(), &path));
+  GesturesConfigProfile* profile = NewGesturesConfigProfile(path.c_str());
+  unlink(path.c_str());
+  ASSERT_TRUE(profile);
+
+  GestureInterpreter* gi = NewGestureInterpreter();
+  GestureInterpreterSetConfigProfile(gi, profile, &hwprops);
+  GestureInterpreterInitialize(gi, GESTURES_DEVCLASS_MOUSE);
+  Property* sensitivity = gi->prop_reg()->GetProperty("Pointer Sensitivity");
+  ASSERT_TRUE(sensitivity);
+  EXPECT_EQ(5, sensitivity->NewValue().asInt());
+
+  // Some other device
+  GestureInterpreterSetConfigProfile(gi, profile, NULL);
+  GestureInterpreterInitialize(gi, GESTURES_DEVCLASS_MOUSE);
+  sensitivity = gi->prop_reg()->GetProperty("Pointer Sensitivity");
+  ASSERT_TRUE(sensitivity);
+  EXPECT_EQ(3, sensitivity->NewValue().asInt());
+  DeleteGestureInterpreter(gi);
+  DeleteGesturesConfigProfile(profile);
+}
+
+}  // namespace gestures
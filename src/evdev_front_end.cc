@@ -0,0 +1,200 @@
+// Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "gestures/include/evdev_front_end.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "gestures/include/eintr_wrapper.h"
+#include "gestures/include/logging.h"
+
+namespace gestures {
+
+EvdevFrontEnd::EvdevFrontEnd(const HardwareProperties& hwprops)
+    : hwprops_(hwprops),
+      slot_count_(hwprops.max_finger_cnt ? hwprops.max_finger_cnt : 1),
+      slots_(new Slot[slot_count_]),
+      fingers_(new FingerState[slot_count_]),
+      current_slot_(0),
+      tool_touch_cnt_(0),
+      buttons_down_(0),
+      rel_x_(0.0),
+      rel_y_(0.0),
+      rel_wheel_(0.0),
+      rel_hwheel_(0.0),
+      dropping_(false),
+      buffered_bytes_(0) {
+  memset(slots_.get(), 0, slot_count_ * sizeof(Slot));
+  memset(fingers_.get(), 0, slot_count_ * sizeof(FingerState));
+  for (size_t i = 0; i < slot_count_; i++)
+    slots_[i].finger.tracking_id = -1;
+  memset(&hwstate_, 0, sizeof(hwstate_));
+  hwstate_.fingers = fingers_.get();
+}
+
+int EvdevFrontEnd::ReadEvents(int fd, FrameCallback callback, void* data) {
+  char* base = reinterpret_cast<char*>(buffer_);
+  ssize_t len = HANDLE_EINTR(read(fd, base + buffered_bytes_,
+                                  sizeof(buffer_) - buffered_bytes_));
+  if (len < 0) {
+    if (errno == EAGAIN || errno == EWOULDBLOCK)
+      return 0;
+    Err("read failed: %s", strerror(errno));
+    return -1;
+  }
+  if (len == 0)
+    return 0;
+  size_t total = buffered_bytes_ + len;
+  size_t count = total / sizeof(struct input_event);
+  for (size_t i = 0; i < count; i++)
+    if (ProcessEvent(buffer_[i]) && callback)
+      callback(data, &hwstate_);
+  buffered_bytes_ = total - count * sizeof(struct input_event);
+  if (buffered_bytes_)
+    memmove(base, base + count * sizeof(struct input_event), buffered_bytes_);
+  return count;
+}
+
+bool EvdevFrontEnd::ProcessEvent(const struct input_event& event) {
+  if (event.type == EV_SYN) {
+    if (event.code == SYN_DROPPED) {
+      Err("Events dropped; discarding until the next SYN_REPORT");
+      dropping_ = true;
+    } else if (event.code == SYN_REPORT) {
+      if (dropping_) {
+        dropping_ = false;
+        return false;
+      }
+      FinishFrame(StimeFromTimeval(&event.time));
+      return true;
+    }
+    return false;
+  }
+  if (dropping_)
+    return false;
+  switch (event.type) {
+    case EV_ABS: HandleAbs(event); break;
+    case EV_KEY: HandleKey(event); break;
+    case EV_REL: HandleRel(event); break;
+  }
+  return false;
+}
+
+void EvdevFrontEnd::HandleAbs(const struct input_event& event) {
+  if (event.code == ABS_MT_SLOT) {
+    // Out of range slots are ignored until the next ABS_MT_SLOT
+    current_slot_ = event.value < 0 ? slot_count_ : event.value;
+    return;
+  }
+  if (current_slot_ >= slot_count_)
+    return;
+  Slot* slot = &slots_[current_slot_];
+  FingerState* finger = &slot->finger;
+  switch (event.code) {
+    case ABS_MT_TRACKING_ID:
+      slot->active = event.value >= 0;
+      if (slot->active)
+        finger->tracking_id = event.value;
+      break;
+    case ABS_MT_POSITION_X: finger->position_x = event.value; break;
+    case ABS_MT_POSITION_Y: finger->position_y = event.value; break;
+    case ABS_MT_PRESSURE: finger->pressure = event.value; break;
+    case ABS_MT_TOUCH_MAJOR: finger->touch_major = event.value; break;
+    case ABS_MT_TOUCH_MINOR: finger->touch_minor = event.value; break;
+    case ABS_MT_WIDTH_MAJOR: finger->width_major = event.value; break;
+    case ABS_MT_WIDTH_MINOR: finger->width_minor = event.value; break;
+    case ABS_MT_ORIENTATION: finger->orientation = event.value; break;
+  }
+}
+
+void EvdevFrontEnd::HandleKey(const struct input_event& event) {
+  int button = 0;
+  unsigned short tool_cnt = 0;
+  switch (event.code) {
+    case BTN_LEFT: button = GESTURES_BUTTON_LEFT; break;
+    case BTN_MIDDLE: button = GESTURES_BUTTON_MIDDLE; break;
+    case BTN_RIGHT: button = GESTURES_BUTTON_RIGHT; break;
+    case BTN_SIDE:  // fallthrough
+    case BTN_BACK: button = GESTURES_BUTTON_BACK; break;
+    case BTN_EXTRA:  // fallthrough
+    case BTN_FORWARD: button = GESTURES_BUTTON_FORWARD; break;
+    case BTN_TOOL_FINGER: tool_cnt = 1; break;
+    case BTN_TOOL_DOUBLETAP: tool_cnt = 2; break;
+    case BTN_TOOL_TRIPLETAP: tool_cnt = 3; break;
+    case BTN_TOOL_QUADTAP: tool_cnt = 4; break;
+    case BTN_TOOL_QUINTTAP: tool_cnt = 5; break;
+  }
+  if (button) {
+    if (event.value)
+      buttons_down_ |= button;
+    else
+      buttons_down_ &= ~button;
+  } else if (tool_cnt) {
+    if (event.value)
+      tool_touch_cnt_ = tool_cnt;
+    else if (tool_touch_cnt_ == tool_cnt)
+      tool_touch_cnt_ = 0;
+  }
+}
+
+void EvdevFrontEnd::HandleRel(const struct input_event& event) {
+  switch (event.code) {
+    case REL_X: rel_x_ += event.value; break;
+    case REL_Y: rel_y_ += event.value; break;
+    case REL_WHEEL: rel_wheel_ += event.value; break;
+    case REL_HWHEEL: rel_hwheel_ += event.value; break;
+  }
+}
+
+void EvdevFrontEnd::FinishFrame(stime_t timestamp) {
+  unsigned short finger_cnt = 0;
+  for (size_t i = 0; i < slot_count_; i++) {
+    if (!slots_[i].active)
+      continue;
+    fingers_[finger_cnt] = slots_[i].finger;
+    fingers_[finger_cnt].flags = 0;
+    finger_cnt++;
+  }
+  hwstate_.timestamp = timestamp;
+  hwstate_.buttons_down = buttons_down_;
+  hwstate_.finger_cnt = finger_cnt;
+  hwstate_.touch_cnt = finger_cnt;
+  // T5R2 and semi-MT pads know how many fingers there are, but can't report
+  // them all.
+  if ((hwprops_.supports_t5r2 || hwprops_.support_semi_mt) &&
+      tool_touch_cnt_ > finger_cnt)
+    hwstate_.touch_cnt = tool_touch_cnt_;
+  hwstate_.fingers = fingers_.get();
+  hwstate_.rel_x = rel_x_;
+  hwstate_.rel_y = rel_y_;
+  hwstate_.rel_wheel = rel_wheel_;
+  hwstate_.rel_hwheel = rel_hwheel_;
+  rel_x_ = rel_y_ = rel_wheel_ = rel_hwheel_ = 0.0;
+}
+
+void EvdevFrontEnd::PushToGestureInterpreter(void* data,
+                                             HardwareState* hwstate) {
+  reinterpret_cast<GestureInterpreter*>(data)->PushHardwareState(hwstate);
+}
+
+}  // namespace gestures
+
+// C API:
+
+GesturesEvdevFrontEnd* NewGesturesEvdevFrontEnd(
+    const struct HardwareProperties* hwprops) {
+  return new gestures::EvdevFrontEnd(*hwprops);
+}
+
+void DeleteGesturesEvdevFrontEnd(GesturesEvdevFrontEnd* front_end) {
+  delete front_end;
+}
+
+int GesturesEvdevFrontEndRead(GesturesEvdevFrontEnd* front_end, int fd,
+                              GestureInterpreter* gi) {
+  return front_end->ReadEvents(
+      fd, gestures::EvdevFrontEnd::PushToGestureInterpreter, gi);
+}
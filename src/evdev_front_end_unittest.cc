@@ -0,0 +1,195 @@
+// Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "gestures/include/evdev_front_end.h"
+#include "gestures/include/gestures.h"
+
+namespace gestures {
+
+class EvdevFrontEndTest : public ::testing::Test {};
+
+namespace {
+
+struct input_event Event(stime_t time, int type, int code, int value) {
+  struct input_event ev;
+  memset(&ev, 0, sizeof(ev));
+  ev.time.tv_sec = static_cast<time_t>(time);
+  ev.time.tv_usec = static_cast<suseconds_t>(
+      (time - ev.time.tv_sec) * 1000000.0 + 0.5);
+  ev.type = type;
+  ev.code = code;
+  ev.value = value;
+  return ev;
+}
+
+struct FrameRecord {
+  FrameRecord() : frames(0) {}
+  void Record(const HardwareState& hs) {
+    frames++;
+    last = hs;
+    last_fingers.assign(hs.fingers, hs.fingers + hs.finger_cnt);
+  }
+  int frames;
+  HardwareState last;
+  std::vector<FingerState> last_fingers;
+};
+
+void RecordFrame(void* data, HardwareState* hwstate) {
+  reinterpret_cast<FrameRecord*>(data)->Record(*hwstate);
+}
+
+// Writes |events| to an unlinked temporary file and returns its fd, rewound.
+int WriteEventsToFile(const std::vector<struct input_event>& events) {
+  char path[] = "/tmp/evdev_front_end_unittest_XXXXXX";
+  int fd = mkstemp(path);
+  if (fd < 0)
+    return -1;
+  unlink(path);
+  size_t size = events.size() * sizeof(struct input_event);
+  if (write(fd, &events[0], size) != static_cast<ssize_t>(size) ||
+      lseek(fd, 0, SEEK_SET) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+HardwareProperties TouchpadProps(unsigned short slots, bool t5r2,
+                                 bool semi_mt) {
+  HardwareProperties hwprops = {
+    0, 0, 1000, 1000,  // left, top, right, bottom
+    10, 10, 133, 133,  // res, dpi
+    -1, 2,  // orientation minimum, maximum
+    slots, 5,  // max fingers, max_touch
+    t5r2, semi_mt, 1, 0  // t5r2, semi_mt, is button pad, wheel
+  };
+  return hwprops;
+}
+
+}  // namespace {}
+
+TEST(EvdevFrontEndTest, SlotTrackingTest) {
+  std::vector<struct input_event> events;
+  // One finger down
+  events.push_back(Event(1.0, EV_ABS, ABS_MT_SLOT, 0));
+  events.push_back(Event(1.0, EV_ABS, ABS_MT_TRACKING_ID, 10));
+  events.push_back(Event(1.0, EV_ABS, ABS_MT_POSITION_X, 100));
+  events.push_back(Event(1.0, EV_ABS, ABS_MT_POSITION_Y, 200));
+  events.push_back(Event(1.0, EV_ABS, ABS_MT_PRESSURE, 30));
+  events.push_back(Event(1.0, EV_KEY, BTN_TOUCH, 1));
+  events.push_back(Event(1.0, EV_KEY, BTN_TOOL_FINGER, 1));
+  events.push_back(Event(1.0, EV_SYN, SYN_REPORT, 0));
+  // Second finger in slot 2, first finger moves, button goes down
+  events.push_back(Event(1.01, EV_ABS, ABS_MT_POSITION_X, 110));
+  events.push_back(Event(1.01, EV_ABS, ABS_MT_SLOT, 2));
+  events.push_back(Event(1.01, EV_ABS, ABS_MT_TRACKING_ID, 11));
+  events.push_back(Event(1.01, EV_ABS, ABS_MT_POSITION_X, 500));
+  events.push_back(Event(1.01, EV_ABS, ABS_MT_POSITION_Y, 600));
+  events.push_back(Event(1.01, EV_KEY, BTN_TOOL_FINGER, 0));
+  events.push_back(Event(1.01, EV_KEY, BTN_TOOL_DOUBLETAP, 1));
+  events.push_back(Event(1.01, EV_KEY, BTN_LEFT, 1));
+  events.push_back(Event(1.01, EV_SYN, SYN_REPORT, 0));
+  // First finger lifts. Events for slots we don't have are ignored.
+  events.push_back(Event(1.02, EV_ABS, ABS_MT_SLOT, 0));
+  events.push_back(Event(1.02, EV_ABS, ABS_MT_TRACKING_ID, -1));
+  events.push_back(Event(1.02, EV_ABS, ABS_MT_SLOT, 7));
+  events.push_back(Event(1.02, EV_ABS, ABS_MT_TRACKING_ID, 12));
+  events.push_back(Event(1.02, EV_SYN, SYN_REPORT, 0));
+
+  int fd = WriteEventsToFile(events);
+  ASSERT_LE(0, fd);
+  EvdevFrontEnd front_end(TouchpadProps(3, false, false));
+  FrameRecord record;
+  int processed = 0;
+  int rc;
+  while ((rc = front_end.ReadEvents(fd, RecordFrame, &record)) > 0) {
+    processed += rc;
+    if (record.frames == 1) {
+      EXPECT_DOUBLE_EQ(1.0, record.last.timestamp);
+      EXPECT_EQ(1, record.last.finger_cnt);
+      EXPECT_EQ(1, record.last.touch_cnt);
+      EXPECT_EQ(10, record.last_fingers[0].tracking_id);
+      EXPECT_FLOAT_EQ(100, record.last_fingers[0].position_x);
+      EXPECT_FLOAT_EQ(200, record.last_fingers[0].position_y);
+      EXPECT_FLOAT_EQ(30, record.last_fingers[0].pressure);
+    }
+  }
+  close(fd);
+  EXPECT_EQ(0, rc);
+  EXPECT_EQ(static_cast<int>(events.size()), processed);
+  EXPECT_EQ(3, record.frames);
+  // Last frame
+  EXPECT_DOUBLE_EQ(1.02, record.last.timestamp);
+  EXPECT_EQ(GESTURES_BUTTON_LEFT, record.last.buttons_down);
+  ASSERT_EQ(1, record.last.finger_cnt);
+  EXPECT_EQ(1, record.last.touch_cnt);
+  EXPECT_EQ(11, record.last_fingers[0].tracking_id);
+  EXPECT_FLOAT_EQ(500, record.last_fingers[0].position_x);
+}
+
+TEST(EvdevFrontEndTest, T5R2Test) {
+  for (int t5r2 = 0; t5r2 < 2; t5r2++) {
+    EvdevFrontEnd front_end(TouchpadProps(2, t5r2, false));
+    front_end.ProcessEvent(Event(2.0, EV_ABS, ABS_MT_SLOT, 0));
+    front_end.ProcessEvent(Event(2.0, EV_ABS, ABS_MT_TRACKING_ID, 1));
+    front_end.ProcessEvent(Event(2.0, EV_ABS, ABS_MT_SLOT, 1));
+    front_end.ProcessEvent(Event(2.0, EV_ABS, ABS_MT_TRACKING_ID, 2));
+    front_end.ProcessEvent(Event(2.0, EV_KEY, BTN_TOOL_TRIPLETAP, 1));
+    EXPECT_TRUE(front_end.ProcessEvent(Event(2.0, EV_SYN, SYN_REPORT, 0)));
+    EXPECT_EQ(2, front_end.hwstate()->finger_cnt);
+    EXPECT_EQ(t5r2 ? 3 : 2, front_end.hwstate()->touch_cnt);
+  }
+}
+
+TEST(EvdevFrontEndTest, DroppedAndRelTest) {
+  EvdevFrontEnd front_end(TouchpadProps(2, false, false));
+  front_end.ProcessEvent(Event(3.0, EV_REL, REL_X, 3));
+  front_end.ProcessEvent(Event(3.0, EV_REL, REL_X, 2));
+  front_end.ProcessEvent(Event(3.0, EV_REL, REL_WHEEL, -1));
+  EXPECT_TRUE(front_end.ProcessEvent(Event(3.0, EV_SYN, SYN_REPORT, 0)));
+  EXPECT_FLOAT_EQ(5, front_end.hwstate()->rel_x);
+  EXPECT_FLOAT_EQ(-1, front_end.hwstate()->rel_wheel);
+
+  // Everything up to and including the SYN_REPORT after SYN_DROPPED is lost
+  front_end.ProcessEvent(Event(3.1, EV_SYN, SYN_DROPPED, 0));
+  front_end.ProcessEvent(Event(3.1, EV_KEY, BTN_LEFT, 1));
+  EXPECT_FALSE(front_end.ProcessEvent(Event(3.1, EV_SYN, SYN_REPORT, 0)));
+  EXPECT_TRUE(front_end.ProcessEvent(Event(3.2, EV_SYN, SYN_REPORT, 0)));
+  EXPECT_EQ(0, front_end.hwstate()->buttons_down);
+  // Relative motion doesn't carry over between frames
+  EXPECT_FLOAT_EQ(0, front_end.hwstate()->rel_x);
+}
+
+TEST(EvdevFrontEndTest, PartialReadTest) {
+  std::vector<struct input_event> events;
+  events.push_back(Event(4.0, EV_REL, REL_Y, 7));
+  events.push_back(Event(4.0, EV_SYN, SYN_REPORT, 0));
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+  const char* bytes = reinterpret_cast<const char*>(&events[0]);
+  size_t split = sizeof(struct input_event) + 5;
+  size_t total = events.size() * sizeof(struct input_event);
+
+  EvdevFrontEnd front_end(TouchpadProps(2, false, false));
+  FrameRecord record;
+  EXPECT_EQ(static_cast<ssize_t>(split), write(fds[1], bytes, split));
+  EXPECT_EQ(1, front_end.ReadEvents(fds[0], RecordFrame, &record));
+  EXPECT_EQ(0, record.frames);
+  EXPECT_EQ(static_cast<ssize_t>(total - split),
+            write(fds[1], bytes + split, total - split));
+  EXPECT_EQ(1, front_end.ReadEvents(fds[0], RecordFrame, &record));
+  EXPECT_EQ(1, record.frames);
+  EXPECT_FLOAT_EQ(7, record.last.rel_y);
+  close(fds[0]);
+  close(fds[1]);
+}
+
+}  // namespace gestures
@@ -0,0 +1,112 @@
+// Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "gestures/include/frame_geometry.h"
+
+#include <algorithm>
+
+#include "gestures/include/util.h"
+
+namespace gestures {
+
+FrameGeometry::FrameGeometry()
+    : has_previous_(false),
+      distances_valid_(false),
+      deltas_valid_(false) {
+  current_.timestamp = -1.0;
+  current_.finger_cnt = 0;
+}
+
+float FrameGeometry::DistSq(const HardwareState& hwstate, size_t i,
+                            size_t j) {
+  if (i >= kMaxFingers || j >= kMaxFingers)
+    return gestures::DistSq(hwstate.fingers[i], hwstate.fingers[j]);
+  Sync(hwstate);
+  if (!distances_valid_)
+    ComputeDistances();
+  return dist_sq_[i][j];
+}
+
+Vector2 FrameGeometry::Delta(const HardwareState& hwstate, size_t i) {
+  if (i >= kMaxFingers)
+    return Vector2();
+  Sync(hwstate);
+  if (!deltas_valid_)
+    ComputeDeltas();
+  return deltas_[i];
+}
+
+Vector2 FrameGeometry::Velocity(const HardwareState& hwstate, size_t i) {
+  Vector2 delta = Delta(hwstate, i);
+  if (!has_previous_)
+    return Vector2();
+  stime_t dt = current_.timestamp - previous_.timestamp;
+  return Vector2(delta.x / dt, delta.y / dt);
+}
+
+void FrameGeometry::Sync(const HardwareState& hwstate) {
+  if (Matches(current_, hwstate))
+    return;
+  if (hwstate.timestamp > current_.timestamp) {
+    previous_ = current_;
+    has_previous_ = current_.timestamp >= 0.0;
+  }
+  Take(hwstate, &current_);
+  distances_valid_ = deltas_valid_ = false;
+}
+
+bool FrameGeometry::Matches(const Snapshot& snapshot,
+                            const HardwareState& hwstate) {
+  if (snapshot.timestamp != hwstate.timestamp ||
+      snapshot.finger_cnt != hwstate.finger_cnt)
+    return false;
+  for (size_t i = 0; i < snapshot.finger_cnt && i < kMaxFingers; i++) {
+    const FingerState& fs = hwstate.fingers[i];
+    if (snapshot.tracking_ids[i] != fs.tracking_id ||
+        snapshot.positions[i] != Vector2(fs))
+      return false;
+  }
+  return true;
+}
+
+void FrameGeometry::Take(const HardwareState& hwstate, Snapshot* snapshot) {
+  snapshot->timestamp = hwstate.timestamp;
+  snapshot->finger_cnt = hwstate.finger_cnt;
+  for (size_t i = 0; i < hwstate.finger_cnt && i < kMaxFingers; i++) {
+    snapshot->tracking_ids[i] = hwstate.fingers[i].tracking_id;
+    snapshot->positions[i] = Vector2(hwstate.fingers[i]);
+  }
+}
+
+void FrameGeometry::ComputeDistances() {
+  size_t finger_cnt = std::min(current_.finger_cnt, kMaxFingers);
+  for (size_t i = 0; i < finger_cnt; i++) {
+    dist_sq_[i][i] = 0.0;
+    for (size_t j = i + 1; j < finger_cnt; j++) {
+      float dist_sq =
+          Sub(current_.positions[i], current_.positions[j]).MagSq();
+      dist_sq_[i][j] = dist_sq_[j][i] = dist_sq;
+    }
+  }
+  distances_valid_ = true;
+}
+
+void FrameGeometry::ComputeDeltas() {
+  size_t finger_cnt = std::min(current_.finger_cnt, kMaxFingers);
+  size_t previous_cnt = std::min(previous_.finger_cnt, kMaxFingers);
+  for (size_t i = 0; i < finger_cnt; i++) {
+    deltas_[i] = Vector2();
+    if (!has_previous_)
+      continue;
+    for (size_t j = 0; j < previous_cnt; j++) {
+      if (previous_.tracking_ids[j] == current_.tracking_ids[i]) {
+        deltas_[i] = Sub(current_.positions[i], previous_.positions[j]);
+        break;
+      }
+    }
+  }
+  deltas_valid_ = true;
+}
+
+}  // namespace gestures
@@ -0,0 +1,74 @@
+// Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include "gestures/include/filter_interpreter.h"
+#include "gestures/include/frame_geometry.h"
+#include "gestures/include/gestures.h"
+#include "gestures/include/lookahead_filter_interpreter.h"
+#include "gestures/include/util.h"
+
+namespace gestures {
+
+class FrameGeometryTest : public ::testing::Test {};
+
+class FrameGeometryTestInterpreter : public Interpreter {
+ public:
+  FrameGeometryTestInterpreter() : Interpreter(NULL, NULL, false) {}
+};
+
+TEST(FrameGeometryTest, CacheTest) {
+  FrameGeometry geometry;
+  FingerState fs[] = {
+    // TM, Tm, WM, Wm, Press, Orientation, X, Y, TrID
+    { 0, 0, 0, 0, 50, 0, 10, 10, 1, 0 },
+    { 0, 0, 0, 0, 50, 0, 13, 14, 2, 0 },
+    { 0, 0, 0, 0, 50, 0, 10, 20, 3, 0 },
+  };
+  HardwareState hs = { 1.0, 0, 3, 3, fs, 0, 0, 0, 0 };
+  for (size_t i = 0; i < arraysize(fs); i++)
+    for (size_t j = 0; j < arraysize(fs); j++)
+      EXPECT_FLOAT_EQ(DistSq(fs[i], fs[j]), geometry.DistSq(hs, i, j));
+  EXPECT_TRUE(geometry.distances_valid_);
+  // No previous frame yet
+  EXPECT_EQ(Vector2(), geometry.Delta(hs, 1));
+  EXPECT_EQ(Vector2(), geometry.Velocity(hs, 1));
+
+  // Asking again about the same positions doesn't recompute them.
+  geometry.DistSq(hs, 0, 1);
+  EXPECT_TRUE(geometry.distances_valid_);
+
+  // A filter moves a finger within the frame.
+  fs[1].position_x = 10;
+  EXPECT_FLOAT_EQ(16.0, geometry.DistSq(hs, 0, 1));
+  EXPECT_FLOAT_EQ(16.0, geometry.DistSq(hs, 1, 0));
+
+  // The next frame: finger 1 moves, finger 2 leaves and finger 4 arrives.
+  FingerState next_fs[] = {
+    { 0, 0, 0, 0, 50, 0, 11, 12, 1, 0 },
+    { 0, 0, 0, 0, 50, 0, 30, 30, 4, 0 },
+    { 0, 0, 0, 0, 50, 0, 10, 20, 3, 0 },
+  };
+  HardwareState next_hs = { 1.5, 0, 3, 3, next_fs, 0, 0, 0, 0 };
+  EXPECT_FALSE(geometry.deltas_valid_ && geometry.distances_valid_);
+  EXPECT_EQ(Vector2(1, 2), geometry.Delta(next_hs, 0));
+  EXPECT_EQ(Vector2(), geometry.Delta(next_hs, 1));
+  EXPECT_EQ(Vector2(), geometry.Delta(next_hs, 2));
+  EXPECT_EQ(Vector2(2, 4), geometry.Velocity(next_hs, 0));
+  EXPECT_FLOAT_EQ(DistSq(next_fs[0], next_fs[1]),
+                  geometry.DistSq(next_hs, 0, 1));
+}
+
+TEST(FrameGeometryTest, SharedTest) {
+  FrameGeometryTestInterpreter* base = new FrameGeometryTestInterpreter;
+  LookaheadFilterInterpreter* lookahead =
+      new LookaheadFilterInterpreter(NULL, base, NULL);
+  FilterInterpreter top(NULL, lookahead, NULL, false);
+  EXPECT_EQ(lookahead->geometry(), top.geometry());
+  // Frames reach the interpreters below the lookahead later.
+  EXPECT_NE(base->geometry(), lookahead->geometry());
+}
+
+}  // namespace gestures
@@ -0,0 +1,105 @@
+// Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "gestures/include/gesture_ring.h"
+
+#include <algorithm>
+
+#include "gestures/include/logging.h"
+
+namespace gestures {
+
+GestureRing::GestureRing(size_t capacity, bool coalesce)
+    : mask_(0),
+      coalesce_(coalesce),
+      head_(0),
+      pushed_any_(false),
+      dropped_(0),
+      coalesced_(0),
+      tail_(0) {
+  // At least two slots, so the newest gesture and the one being written
+  // are never the same slot.
+  size_t size = 2;
+  while (size < capacity)
+    size <<= 1;
+  mask_ = size - 1;
+  slots_.reset(new Slot[size]);
+  for (size_t i = 0; i < size; i++)
+    slots_[i].state.store(kSlotEmpty);
+}
+
+bool GestureRing::Push(const Gesture& gesture, bool* was_empty) {
+  if (was_empty)
+    *was_empty = false;
+  if (coalesce_ && pushed_any_ &&
+      (gesture.type == kGestureTypeMove ||
+       gesture.type == kGestureTypeScroll) &&
+      TryCoalesce(gesture)) {
+    coalesced_++;
+    return true;
+  }
+  Slot* slot = &slots_[head_ & mask_];
+  if (slot->state.load() != kSlotEmpty) {
+    if (!dropped_)
+      Err("GestureRing::Push: out of space!");
+    dropped_++;
+    return false;
+  }
+  slot->gesture = gesture;
+  slot->state.store(kSlotReady);
+  // Check the previous slot only after publishing. If the consumer hadn't
+  // claimed it by now, it will see the new gesture when it gets here.
+  if (was_empty)
+    *was_empty = !pushed_any_ ||
+        slots_[(head_ - 1) & mask_].state.load() != kSlotReady;
+  head_++;
+  pushed_any_ = true;
+  return true;
+}
+
+bool GestureRing::TryCoalesce(const Gesture& gesture) {
+  Slot* slot = &slots_[(head_ - 1) & mask_];
+  // Only the producer writes gestures, so reading the type of a published
+  // slot is safe even while the consumer copies it.
+  if (slot->gesture.type != gesture.type)
+    return false;
+  int expected = kSlotReady;
+  if (!slot->state.compare_exchange_strong(expected, kSlotWriting))
+    return false;  // Already consumed or being read
+  Gesture* dst = &slot->gesture;
+  if (gesture.type == kGestureTypeMove) {
+    dst->details.move.dx += gesture.details.move.dx;
+    dst->details.move.dy += gesture.details.move.dy;
+    dst->details.move.ordinal_dx += gesture.details.move.ordinal_dx;
+    dst->details.move.ordinal_dy += gesture.details.move.ordinal_dy;
+  } else {
+    dst->details.scroll.dx += gesture.details.scroll.dx;
+    dst->details.scroll.dy += gesture.details.scroll.dy;
+    dst->details.scroll.ordinal_dx += gesture.details.scroll.ordinal_dx;
+    dst->details.scroll.ordinal_dy += gesture.details.scroll.ordinal_dy;
+    dst->details.scroll.stop_fling |= gesture.details.scroll.stop_fling;
+  }
+  dst->start_time = std::min(dst->start_time, gesture.start_time);
+  dst->end_time = std::max(dst->end_time, gesture.end_time);
+  slot->state.store(kSlotReady);
+  return true;
+}
+
+bool GestureRing::Pop(Gesture* out) {
+  Slot* slot = &slots_[tail_ & mask_];
+  int expected = kSlotReady;
+  while (!slot->state.compare_exchange_weak(expected, kSlotReading)) {
+    // The producer only holds a slot in kSlotWriting for a handful of
+    // additions while coalescing, so wait it out rather than report empty.
+    if (expected != kSlotWriting && expected != kSlotReady)
+      return false;
+    expected = kSlotReady;
+  }
+  *out = slot->gesture;
+  slot->state.store(kSlotEmpty);
+  tail_++;
+  return true;
+}
+
+}  // namespace gestures
@@ -0,0 +1,126 @@
+// Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "gestures/include/gesture_ring.h"
+#include "gestures/include/gestures.h"
+
+namespace gestures {
+
+class GestureRingTest : public ::testing::Test {};
+
+TEST(GestureRingTest, SimpleTest) {
+  GestureRing ring(3, false);
+  EXPECT_EQ(4, ring.capacity());
+
+  Gesture out;
+  EXPECT_FALSE(ring.Pop(&out));
+
+  bool was_empty = false;
+  EXPECT_TRUE(ring.Push(Gesture(kGestureMove, 1.0, 1.1, 1, 2), &was_empty));
+  EXPECT_TRUE(was_empty);
+  EXPECT_TRUE(ring.Push(Gesture(kGestureMove, 1.1, 1.2, 3, 4), &was_empty));
+  EXPECT_FALSE(was_empty);
+  EXPECT_TRUE(ring.Push(Gesture(kGestureButtonsChange, 1.2, 1.2,
+                                GESTURES_BUTTON_LEFT, 0), &was_empty));
+  EXPECT_TRUE(ring.Push(Gesture(kGestureScroll, 1.2, 1.3, 0, 5), NULL));
+  // Full
+  EXPECT_FALSE(ring.Push(Gesture(kGestureScroll, 1.3, 1.4, 0, 5), NULL));
+  EXPECT_EQ(1, ring.dropped());
+
+  EXPECT_TRUE(ring.Pop(&out));
+  EXPECT_EQ(Gesture(kGestureMove, 1.0, 1.1, 1, 2), out);
+  EXPECT_TRUE(ring.Pop(&out));
+  EXPECT_EQ(Gesture(kGestureMove, 1.1, 1.2, 3, 4), out);
+  EXPECT_TRUE(ring.Pop(&out));
+  EXPECT_EQ(kGestureTypeButtonsChange, out.type);
+  EXPECT_TRUE(ring.Pop(&out));
+  EXPECT_EQ(kGestureTypeScroll, out.type);
+  EXPECT_FALSE(ring.Pop(&out));
+
+  // Drained, so the next push should ask for a wakeup again.
+  EXPECT_TRUE(ring.Push(Gesture(kGestureMove, 2.0, 2.1, 1, 1), &was_empty));
+  EXPECT_TRUE(was_empty);
+}
+
+TEST(GestureRingTest, CoalesceTest) {
+  GestureRing ring(4, true);
+  Gesture out;
+
+  ring.Push(Gesture(kGestureMove, 1.0, 1.1, 1, 2), NULL);
+  ring.Push(Gesture(kGestureMove, 1.1, 1.2, 3, 4), NULL);
+  ring.Push(Gesture(kGestureButtonsChange, 1.2, 1.2,
+                    GESTURES_BUTTON_LEFT, 0), NULL);
+  ring.Push(Gesture(kGestureScroll, 1.2, 1.3, 0, 5), NULL);
+  Gesture stop = Gesture(kGestureScroll, 1.3, 1.4, 1, 6);
+  stop.details.scroll.stop_fling = 1;
+  ring.Push(stop, NULL);
+  EXPECT_EQ(2, ring.coalesced());
+  EXPECT_EQ(0, ring.dropped());
+
+  EXPECT_TRUE(ring.Pop(&out));
+  EXPECT_EQ(Gesture(kGestureMove, 1.0, 1.2, 4, 6), out);
+  EXPECT_FLOAT_EQ(4, out.details.move.ordinal_dx);
+  EXPECT_FLOAT_EQ(6, out.details.move.ordinal_dy);
+  EXPECT_TRUE(ring.Pop(&out));
+  EXPECT_EQ(kGestureTypeButtonsChange, out.type);
+  EXPECT_TRUE(ring.Pop(&out));
+  EXPECT_EQ(Gesture(kGestureScroll, 1.2, 1.4, 1, 11), out);
+  EXPECT_EQ(1, out.details.scroll.stop_fling);
+
+  // Once the reader has taken a gesture, new ones aren't merged into it.
+  ring.Push(Gesture(kGestureScroll, 1.4, 1.5, 0, 1), NULL);
+  EXPECT_TRUE(ring.Pop(&out));
+  ring.Push(Gesture(kGestureScroll, 1.5, 1.6, 0, 1), NULL);
+  EXPECT_TRUE(ring.Pop(&out));
+  EXPECT_EQ(Gesture(kGestureScroll, 1.5, 1.6, 0, 1), out);
+  EXPECT_FALSE(ring.Pop(&out));
+}
+
+TEST(GestureRingTest, ThreadedTest) {
+  const int kCount = 100000;
+  GestureRing ring(16, true);
+  float consumed_dx = 0.0;
+  int buttons = 0;
+  bool done = false;
+
+  std::thread consumer([&ring, &consumed_dx, &buttons, &done, kCount]() {
+    Gesture out;
+    while (buttons < kCount / 100) {
+      if (!ring.Pop(&out))
+        continue;
+      if (out.type == kGestureTypeMove)
+        consumed_dx += out.details.move.dx;
+      else if (out.type == kGestureTypeButtonsChange)
+        buttons++;
+    }
+    done = true;
+  });
+  float pushed_dx = 0.0;
+  int pushed_buttons = 0;
+  for (int i = 1; i <= kCount; i++) {
+    bool ok;
+    if (i % 100 == 0) {
+      do {
+        ok = ring.Push(Gesture(kGestureButtonsChange, i, i,
+                               GESTURES_BUTTON_LEFT, 0), NULL);
+      } while (!ok);
+      pushed_buttons++;
+    } else {
+      do {
+        ok = ring.Push(Gesture(kGestureMove, i, i, 1, 0), NULL);
+      } while (!ok);
+      pushed_dx += 1.0;
+    }
+  }
+  consumer.join();
+  EXPECT_TRUE(done);
+  EXPECT_EQ(pushed_buttons, buttons);
+  EXPECT_FLOAT_EQ(pushed_dx, consumed_dx);
+}
+
+}  // namespace gestures
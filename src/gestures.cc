@@ -10,9 +10,11 @@
 #include "gestures/include/accel_filter_interpreter.h"
 #include "gestures/include/box_filter_interpreter.h"
 #include "gestures/include/click_wiggle_filter_interpreter.h"
+#include "gestures/include/config_profile.h"
 #include "gestures/include/finger_merge_filter_interpreter.h"
 #include "gestures/include/finger_metrics.h"
 #include "gestures/include/fling_stop_filter_interpreter.h"
+#include "gestures/include/gesture_ring.h"
 #include "gestures/include/iir_filter_interpreter.h"
 #include "gestures/include/immediate_interpreter.h"
 #include "gestures/include/integral_gesture_filter_interpreter.h"
@@ -24,16 +26,20 @@
 #include "gestures/include/multitouch_mouse_interpreter.h"
 #include "gestures/include/non_linearity_filter_interpreter.h"
 #include "gestures/include/palm_classifying_filter_interpreter.h"
+#include "gestures/include/prediction_filter_interpreter.h"
 #include "gestures/include/prop_registry.h"
 #include "gestures/include/scaling_filter_interpreter.h"
 #include "gestures/include/stationary_wiggle_filter_interpreter.h"
 #include "gestures/include/cr48_profile_sensor_filter_interpreter.h"
 #include "gestures/include/sensor_jump_filter_interpreter.h"
+#include "gestures/include/shadow_stack.h"
+#include "gestures/include/shared_resources.h"
 #include "gestures/include/split_correcting_filter_interpreter.h"
 #include "gestures/include/string_util.h"
 #include "gestures/include/stuck_button_inhibitor_filter_interpreter.h"
 #include "gestures/include/fling_to_scroll_filter_interpreter.h"
 #include "gestures/include/t5r2_correcting_filter_interpreter.h"
+#include "gestures/include/timer_scheduler.h"
 #include "gestures/include/trace_marker.h"
 #include "gestures/include/tracer.h"
 #include "gestures/include/trend_classifying_filter_interpreter.h"
@@ -352,6 +358,19 @@ void GestureInterpreterSetCallback(GestureInterpreter* obj,
   obj->set_callback(fn, user_data);
 }
 
+void GestureInterpreterEnableGestureRing(GestureInterpreter* obj,
+                                         size_t capacity,
+                                         int coalesce,
+                                         GestureRingNotifyFunction notify,
+                                         void* notify_data) {
+  obj->EnableGestureRing(capacity, coalesce != 0, notify, notify_data);
+}
+
+int GestureInterpreterPollGesture(GestureInterpreter* obj,
+                                  struct Gesture* out) {
+  return obj->PollGesture(out) ? 1 : 0;
+}
+
 void GestureInterpreterSetTimerProvider(GestureInterpreter* obj,
                                         GesturesTimerProvider* tp,
                                         void* data) {
@@ -364,11 +383,47 @@ void GestureInterpreterSetPropProvider(GestureInterpreter* obj,
   obj->SetPropProvider(pp, data);
 }
 
+void GestureInterpreterSetBulkPropProvider(GestureInterpreter* obj,
+                                           GesturesBulkPropProvider* pp,
+                                           void* data) {
+  obj->SetBulkPropProvider(pp, data);
+}
+
 void GestureInterpreterInitialize(GestureInterpreter* obj,
                                   enum GestureInterpreterDeviceClass cls) {
   obj->Initialize(cls);
 }
 
+void GestureInterpreterSetSharedResources(GestureInterpreter* obj,
+                                          GesturesSharedResources* resources) {
+  obj->SetSharedResources(resources);
+}
+
+void GestureInterpreterSetConfigProfile(
+    GestureInterpreter* obj,
+    GesturesConfigProfile* profile,
+    const struct HardwareProperties* hwprops) {
+  obj->SetConfigProfile(profile, hwprops);
+}
+
+int GestureInterpreterGetShadowStats(GestureInterpreter* obj,
+                                     GesturesShadowStats* out) {
+  return obj->GetShadowStats(out);
+}
+
+void GestureInterpreterSetDeferredProps(GestureInterpreter* obj,
+                                        int deferred) {
+  obj->prop_reg()->SetDeferred(deferred);
+}
+
+void GestureInterpreterBeginPropUpdate(GestureInterpreter* obj) {
+  obj->prop_reg()->BeginUpdate();
+}
+
+void GestureInterpreterEndPropUpdate(GestureInterpreter* obj) {
+  obj->prop_reg()->EndUpdate();
+}
+
 // C++ API:
 namespace gestures {
 class GestureInterpreterConsumer : public GestureConsumer {
@@ -376,15 +431,37 @@ class GestureInterpreterConsumer : public GestureConsumer {
   GestureInterpreterConsumer(GestureReadyFunction callback,
                              void* callback_data)
       : callback_(callback),
-        callback_data_(callback_data) {}
+        callback_data_(callback_data),
+        ring_(NULL),
+        ring_notify_(NULL),
+        ring_notify_data_(NULL),
+        summary_(NULL) {}
 
   void SetCallback(GestureReadyFunction callback, void* callback_data) {
     callback_ = callback;
     callback_data_ = callback_data;
   }
 
+  void SetRing(GestureRing* ring, GestureRingNotifyFunction notify,
+               void* notify_data) {
+    ring_ = ring;
+    ring_notify_ = notify;
+    ring_notify_data_ = notify_data;
+  }
+
+  // Also adds every gesture to |summary|, if not NULL.
+  void SetSummary(GestureSummary* summary) { summary_ = summary; }
+
   void ConsumeGesture(const Gesture& gesture) {
     AssertWithReturn(gesture.type != kGestureTypeNull);
+    if (summary_)
+      summary_->Add(gesture);
+    if (ring_) {
+      bool was_empty = false;
+      if (ring_->Push(gesture, &was_empty) && was_empty && ring_notify_)
+        ring_notify_(ring_notify_data_);
+      return;
+    }
     if (callback_)
       callback_(callback_data_, &gesture);
   }
@@ -392,17 +469,40 @@ class GestureInterpreterConsumer : public GestureConsumer {
  private:
   GestureReadyFunction callback_;
   void* callback_data_;
+  GestureRing* ring_;
+  GestureRingNotifyFunction ring_notify_;
+  void* ring_notify_data_;
+  GestureSummary* summary_;
 };
 }
 
 GestureInterpreter::GestureInterpreter(int version)
     : callback_(NULL),
       callback_data_(NULL),
+      ring_notify_(NULL),
+      ring_notify_data_(NULL),
+      shared_resources_(NULL),
+      config_profile_(NULL),
+      config_fingerprint_(ConfigProfile::kAnyDevice),
       timer_provider_(NULL),
       timer_provider_data_(NULL),
-      interpret_timer_(NULL) {
+      interpret_timer_(NULL),
+      timers_(new TimerScheduler),
+      armed_deadline_(0.0),
+      contact_capacity_(kMaxFingers),
+      prev_fingers_(new FingerState[kMaxFingers]),
+      have_prev_hwstate_(false),
+      idle_frame_pending_(false),
+      last_interpreted_time_(0.0),
+      idle_frames_skipped_(0) {
   prop_reg_.reset(new PropRegistry);
   tracer_.reset(new Tracer(prop_reg_.get(), TraceMarker::StaticTraceWrite));
+  skip_idle_frames_.reset(
+      new BoolProperty(prop_reg_.get(), "Skip Idle Frames", false));
+  idle_frame_max_skip_.reset(
+      new DoubleProperty(prop_reg_.get(), "Idle Frame Max Skip Time", 0.1));
+  memset(&prev_hwstate_, 0, sizeof(prev_hwstate_));
+  prev_hwstate_.fingers = prev_fingers_.get();
   TraceMarker::CreateTraceMarker();
 }
 
@@ -413,6 +513,9 @@ GestureInterpreter::~GestureInterpreter() {
 }
 
 namespace {
+// Ids for timers_
+const int kInterpreterTimer = 0;
+
 stime_t InternalTimerCallback(stime_t now, void* callback_data) {
   Log("TimerCallback called");
   GestureInterpreter* gi = reinterpret_cast<GestureInterpreter*>(callback_data);
@@ -427,22 +530,76 @@ void GestureInterpreter::PushHardwareState(HardwareState* hwstate) {
     Err("Filters are not composed yet!");
     return;
   }
+  prop_reg_->Commit();
+  if (hwstate->finger_cnt > contact_capacity_) {
+    Log("Dropping %zu of %d fingers", hwstate->finger_cnt - contact_capacity_,
+        hwstate->finger_cnt);
+    hwstate->finger_cnt = contact_capacity_;
+  }
+  if (IsIdleFrame(*hwstate)) {
+    prev_hwstate_.timestamp = hwstate->timestamp;
+    idle_frame_pending_ = true;
+    idle_frames_skipped_++;
+    return;
+  }
   stime_t timeout = -1.0;
-  interpreter_->SyncInterpret(hwstate, &timeout);
-  if (timer_provider_ && interpret_timer_) {
-    if (timeout <= 0.0) {
-      timer_provider_->cancel_fn(timer_provider_data_, interpret_timer_);
-    } else {
-      timer_provider_->set_fn(timer_provider_data_,
-                              interpret_timer_,
-                              timeout,
-                              InternalTimerCallback,
-                              this);
-      Log("Setting timer for %f s out.", timeout);
-    }
-  } else {
+  if (idle_frame_pending_) {
+    // Let the chain see the last skipped frame first, so that time deltas
+    // (and thus velocities) for this frame come out the same as if nothing
+    // had been skipped. Nothing was pending, so any timeout is superseded
+    // by the one for this frame.
+    idle_frame_pending_ = false;
+    SyncInterpret(&prev_hwstate_, &timeout);
+    timeout = -1.0;
+  }
+  // The chain modifies |hwstate| in place, so copy it first.
+  have_prev_hwstate_ = true;
+  prev_hwstate_.DeepCopy(*hwstate, kMaxFingers);
+  last_interpreted_time_ = hwstate->timestamp;
+  SyncInterpret(hwstate, &timeout);
+  if (timeout > 0.0)
+    timers_->SetDeadline(kInterpreterTimer, hwstate->timestamp + timeout);
+  else
+    timers_->Cancel(kInterpreterTimer);
+  ArmTimer(hwstate->timestamp);
+}
+
+bool GestureInterpreter::IsIdleFrame(const HardwareState& hwstate) const {
+  if (!skip_idle_frames_->val_ || !have_prev_hwstate_ || !timers_->empty())
+    return false;
+  if (hwstate.timestamp - last_interpreted_time_ > idle_frame_max_skip_->val_)
+    return false;
+  if (hwstate.buttons_down != prev_hwstate_.buttons_down ||
+      hwstate.rel_x != 0.0 || hwstate.rel_y != 0.0 ||
+      hwstate.rel_wheel != 0.0 || hwstate.rel_hwheel != 0.0 ||
+      !hwstate.SameFingersAs(prev_hwstate_))
+    return false;
+  for (size_t i = 0; i < hwstate.finger_cnt; i++)
+    if (!hwstate.fingers[i].NonFlagsEquals(prev_hwstate_.fingers[i]))
+      return false;
+  return true;
+}
+
+void GestureInterpreter::ArmTimer(stime_t now) {
+  if (!timer_provider_ || !interpret_timer_) {
     Err("No timer!");
+    return;
+  }
+  stime_t next = timers_->NextDeadline();
+  if (TimerScheduler::SameDeadline(next, armed_deadline_))
+    return;
+  if (next == 0.0) {
+    timer_provider_->cancel_fn(timer_provider_data_, interpret_timer_);
+  } else {
+    stime_t delay = std::max(next - now, 0.0);
+    timer_provider_->set_fn(timer_provider_data_,
+                            interpret_timer_,
+                            delay,
+                            InternalTimerCallback,
+                            this);
+    Log("Setting timer for %f s out.", delay);
   }
+  armed_deadline_ = next;
 }
 
 void GestureInterpreter::SetHardwareProperties(
@@ -451,9 +608,41 @@ void GestureInterpreter::SetHardwareProperties(
     Err("Filters are not composed yet!");
     return;
   }
+  prop_reg_->Commit();
   hwprops_ = hwprops;
+  size_t contacts = std::max(hwprops.max_finger_cnt, hwprops.max_touch_cnt);
+  if (contacts > kMaxFingers)
+    Err("Device reports %zu contacts, but only %zu are supported",
+        contacts, kMaxFingers);
+  contact_capacity_ = contacts ? std::min(contacts, kMaxFingers) : kMaxFingers;
+  have_prev_hwstate_ = false;
+  idle_frame_pending_ = false;
   if (consumer_)
     interpreter_->Initialize(&hwprops_, NULL, mprops_.get(), consumer_.get());
+  if (shadow_.get())
+    shadow_->SetHardwareProperties(hwprops_);
+}
+
+void GestureInterpreter::SyncInterpret(HardwareState* hwstate,
+                                       stime_t* timeout) {
+  if (shadow_.get())
+    shadow_->SyncInterpret(interpreter_.get(), hwstate, timeout);
+  else
+    interpreter_->SyncInterpret(hwstate, timeout);
+}
+
+void GestureInterpreter::HandleTimer(stime_t now, stime_t* timeout) {
+  if (shadow_.get())
+    shadow_->HandleTimer(interpreter_.get(), now, timeout);
+  else
+    interpreter_->HandleTimer(now, timeout);
+}
+
+bool GestureInterpreter::GetShadowStats(GesturesShadowStats* out) {
+  if (!shadow_.get())
+    return false;
+  *out = shadow_->stats();
+  return true;
 }
 
 void GestureInterpreter::TimerCallback(stime_t now, stime_t* timeout) {
@@ -461,7 +650,28 @@ void GestureInterpreter::TimerCallback(stime_t now, stime_t* timeout) {
     Err("Filters are not composed yet!");
     return;
   }
-  interpreter_->HandleTimer(now, timeout);
+  prop_reg_->Commit();
+  // The provider fired for armed_deadline_, so anything due by then is due
+  // now, even if |now| comes in a hair early.
+  stime_t fired_at = std::max(now, armed_deadline_);
+  armed_deadline_ = 0.0;
+  if (timers_->IsDue(kInterpreterTimer, fired_at)) {
+    timers_->Cancel(kInterpreterTimer);
+    stime_t next_timeout = -1.0;
+    HandleTimer(now, &next_timeout);
+    if (next_timeout >= 0.0)
+      timers_->SetDeadline(kInterpreterTimer, now + next_timeout);
+  } else {
+    // Typically a callback that was already in flight when a newer
+    // PushHardwareState() moved or cancelled the deadline.
+    Log("Skipping spurious timer callback at %f", now);
+  }
+  stime_t next = timers_->NextDeadline();
+  if (next == 0.0)
+    return;
+  // The provider re-arms the timer with the value we return.
+  *timeout = std::max(next - now, 0.0);
+  armed_deadline_ = next;
 }
 
 void GestureInterpreter::SetTimerProvider(GesturesTimerProvider* tp,
@@ -476,6 +686,7 @@ void GestureInterpreter::SetTimerProvider(GesturesTimerProvider* tp,
     Log("How was interpret_timer_ not NULL?!");
   timer_provider_ = tp;
   timer_provider_data_ = data;
+  armed_deadline_ = 0.0;
   if (timer_provider_)
     interpret_timer_ = timer_provider_->create_fn(timer_provider_data_);
 }
@@ -485,6 +696,18 @@ void GestureInterpreter::SetPropProvider(GesturesPropProvider* pp,
   prop_reg_->SetPropProvider(pp, data);
 }
 
+void GestureInterpreter::SetBulkPropProvider(GesturesBulkPropProvider* pp,
+                                             void* data) {
+  prop_reg_->SetBulkPropProvider(pp, data);
+}
+
+void GestureInterpreter::SetConfigProfile(ConfigProfile* profile,
+                                          const HardwareProperties* hwprops) {
+  config_profile_ = profile;
+  config_fingerprint_ = hwprops ? ConfigProfile::Fingerprint(*hwprops) :
+      ConfigProfile::kAnyDevice;
+}
+
 void GestureInterpreter::set_callback(GestureReadyFunction callback,
                   void* client_data) {
   callback_ = callback;
@@ -494,75 +717,112 @@ void GestureInterpreter::set_callback(GestureReadyFunction callback,
     consumer_->SetCallback(callback, client_data);
 }
 
-void GestureInterpreter::InitializeTouchpad(void) {
+void GestureInterpreter::EnableGestureRing(size_t capacity, bool coalesce,
+                                           GestureRingNotifyFunction notify,
+                                           void* notify_data) {
+  if (consumer_)
+    consumer_->SetRing(NULL, NULL, NULL);
+  ring_.reset(capacity ? new GestureRing(capacity, coalesce) : NULL);
+  ring_notify_ = notify;
+  ring_notify_data_ = notify_data;
+  if (consumer_)
+    consumer_->SetRing(ring_.get(), ring_notify_, ring_notify_data_);
+}
+
+bool GestureInterpreter::PollGesture(Gesture* out) {
+  if (!ring_.get()) {
+    Err("Gesture ring is not enabled!");
+    return false;
+  }
+  return ring_->Pop(out);
+}
+
+void GestureInterpreter::ReadTouchpadStackVersions(int* version,
+                                                   int* shadow_version) {
+  *version = 1;
+  *shadow_version = 0;
   if (prop_reg_.get()) {
     IntProperty stack_version(prop_reg_.get(), "Touchpad Stack Version", 2);
-    if (stack_version.val_ == 2) {
-      InitializeTouchpad2();
-      return;
-    }
+    IntProperty shadow_stack_version(prop_reg_.get(),
+                                     "Shadow Touchpad Stack Version", 0);
+    *version = stack_version.val_;
+    *shadow_version = shadow_stack_version.val_;
   }
-  Interpreter* temp = new ImmediateInterpreter(prop_reg_.get(), tracer_.get());
-  temp = new FlingToScrollFilterInterpreter(prop_reg_.get(), temp, tracer_.get());  
-  temp = new FlingStopFilterInterpreter(prop_reg_.get(), temp, tracer_.get());
-  temp = new ClickWiggleFilterInterpreter(prop_reg_.get(), temp, tracer_.get());
-  temp = new PalmClassifyingFilterInterpreter(prop_reg_.get(), temp,
-                                              tracer_.get());
-  temp = new IirFilterInterpreter(prop_reg_.get(), temp, tracer_.get());
-  temp = new LookaheadFilterInterpreter(prop_reg_.get(), temp, tracer_.get());
-  temp = new BoxFilterInterpreter(prop_reg_.get(), temp, tracer_.get());
-  temp = new StationaryWiggleFilterInterpreter(prop_reg_.get(), temp,
-                                               tracer_.get());
-  temp = new SensorJumpFilterInterpreter(prop_reg_.get(), temp, tracer_.get());
-  temp = new AccelFilterInterpreter(prop_reg_.get(), temp, tracer_.get());
-  temp = new SplitCorrectingFilterInterpreter(prop_reg_.get(), temp,
-                                              tracer_.get());
-  temp = new TrendClassifyingFilterInterpreter(prop_reg_.get(), temp,
-                                               tracer_.get());
-  temp = new MetricsFilterInterpreter(prop_reg_.get(), temp, tracer_.get(),
-                                      GESTURES_DEVCLASS_TOUCHPAD);
-  temp = new ScalingFilterInterpreter(prop_reg_.get(), temp, tracer_.get(),
-                                      GESTURES_DEVCLASS_TOUCHPAD);
-  temp = new FingerMergeFilterInterpreter(prop_reg_.get(), temp, tracer_.get());
-  temp = new StuckButtonInhibitorFilterInterpreter(temp, tracer_.get());
-  temp = new T5R2CorrectingFilterInterpreter(prop_reg_.get(), temp,
-                                             tracer_.get());
-  temp = new Cr48ProfileSensorFilterInterpreter(prop_reg_.get(), temp,
-                                                tracer_.get());
-  temp = new NonLinearityFilterInterpreter(prop_reg_.get(), temp,
-                                           tracer_.get());
-  interpreter_.reset(temp);
-  temp = NULL;
 }
 
-void GestureInterpreter::InitializeTouchpad2(void) {
-  Interpreter* temp = new ImmediateInterpreter(prop_reg_.get(), tracer_.get());
-  temp = new FlingToScrollFilterInterpreter(prop_reg_.get(), temp, tracer_.get());  
-  temp = new FlingStopFilterInterpreter(prop_reg_.get(), temp, tracer_.get());
-  temp = new ClickWiggleFilterInterpreter(prop_reg_.get(), temp, tracer_.get());
-  temp = new PalmClassifyingFilterInterpreter(prop_reg_.get(), temp,
-                                              tracer_.get());
-  temp = new LookaheadFilterInterpreter(prop_reg_.get(), temp, tracer_.get());
-  temp = new BoxFilterInterpreter(prop_reg_.get(), temp, tracer_.get());
-  temp = new StationaryWiggleFilterInterpreter(prop_reg_.get(), temp,
-                                               tracer_.get());
-  temp = new AccelFilterInterpreter(prop_reg_.get(), temp, tracer_.get());
-  temp = new TrendClassifyingFilterInterpreter(prop_reg_.get(), temp,
-                                               tracer_.get());
-  temp = new MetricsFilterInterpreter(prop_reg_.get(), temp, tracer_.get(),
+void GestureInterpreter::InitializeTouchpad(int version, int shadow_version) {
+  interpreter_.reset(NewTouchpadStack(version, prop_reg_.get(),
+                                      tracer_.get()));
+  if (shadow_version && prop_reg_.get()) {
+    // The shadow stack gets properties of its own, not exported through the
+    // provider. Initialize() copies the primary's values into them.
+    PropRegistry* shadow_reg = new PropRegistry;
+    MetricsProperties* shadow_mprops = new MetricsProperties(shadow_reg);
+    Interpreter* shadow = NewTouchpadStack(shadow_version, shadow_reg, NULL);
+    shadow_.reset(new ShadowStack(shadow_reg, shadow_mprops, shadow));
+  }
+}
+
+gestures::Interpreter* GestureInterpreter::NewTouchpadStack(
+    int version, PropRegistry* prop_reg, Tracer* tracer) {
+  if (version == 2)
+    return NewTouchpadStack2(prop_reg, tracer);
+  Interpreter* temp = new ImmediateInterpreter(prop_reg, tracer);
+  temp = new FlingToScrollFilterInterpreter(prop_reg, temp, tracer);
+  temp = new FlingStopFilterInterpreter(prop_reg, temp, tracer);
+  temp = new ClickWiggleFilterInterpreter(prop_reg, temp, tracer);
+  temp = new PalmClassifyingFilterInterpreter(prop_reg, temp, tracer);
+  temp = new PredictionFilterInterpreter(prop_reg, temp, tracer);
+  temp = new IirFilterInterpreter(prop_reg, temp, tracer);
+  temp = new LookaheadFilterInterpreter(prop_reg, temp, tracer);
+  temp = new BoxFilterInterpreter(prop_reg, temp, tracer);
+  temp = new StationaryWiggleFilterInterpreter(prop_reg, temp, tracer);
+  temp = new SensorJumpFilterInterpreter(prop_reg, temp, tracer);
+  temp = new AccelFilterInterpreter(prop_reg, temp, tracer,
+                                    shared_resources_);
+  temp = new SplitCorrectingFilterInterpreter(prop_reg, temp, tracer);
+  temp = new TrendClassifyingFilterInterpreter(prop_reg, temp, tracer);
+  temp = new MetricsFilterInterpreter(prop_reg, temp, tracer,
                                       GESTURES_DEVCLASS_TOUCHPAD);
-  temp = new ScalingFilterInterpreter(prop_reg_.get(), temp, tracer_.get(),
+  temp = new ScalingFilterInterpreter(prop_reg, temp, tracer,
                                       GESTURES_DEVCLASS_TOUCHPAD);
-  temp = new FingerMergeFilterInterpreter(prop_reg_.get(), temp, tracer_.get());
-  temp = new StuckButtonInhibitorFilterInterpreter(temp, tracer_.get());
-  interpreter_.reset(temp);
-  temp = NULL;
+  temp = new FingerMergeFilterInterpreter(prop_reg, temp, tracer);
+  temp = new StuckButtonInhibitorFilterInterpreter(temp, tracer);
+  temp = new T5R2CorrectingFilterInterpreter(prop_reg, temp, tracer);
+  temp = new Cr48ProfileSensorFilterInterpreter(prop_reg, temp, tracer);
+  temp = new NonLinearityFilterInterpreter(prop_reg, temp, tracer,
+                                           shared_resources_);
+  return temp;
+}
+
+gestures::Interpreter* GestureInterpreter::NewTouchpadStack2(
+    PropRegistry* prop_reg, Tracer* tracer) {
+  Interpreter* temp = new ImmediateInterpreter(prop_reg, tracer);
+  temp = new FlingToScrollFilterInterpreter(prop_reg, temp, tracer);
+  temp = new FlingStopFilterInterpreter(prop_reg, temp, tracer);
+  temp = new ClickWiggleFilterInterpreter(prop_reg, temp, tracer);
+  temp = new PalmClassifyingFilterInterpreter(prop_reg, temp, tracer);
+  temp = new PredictionFilterInterpreter(prop_reg, temp, tracer);
+  temp = new LookaheadFilterInterpreter(prop_reg, temp, tracer);
+  temp = new BoxFilterInterpreter(prop_reg, temp, tracer);
+  temp = new StationaryWiggleFilterInterpreter(prop_reg, temp, tracer);
+  temp = new AccelFilterInterpreter(prop_reg, temp, tracer,
+                                    shared_resources_);
+  temp = new TrendClassifyingFilterInterpreter(prop_reg, temp, tracer);
+  temp = new MetricsFilterInterpreter(prop_reg, temp, tracer,
+                                      GESTURES_DEVCLASS_TOUCHPAD);
+  temp = new ScalingFilterInterpreter(prop_reg, temp, tracer,
+                                      GESTURES_DEVCLASS_TOUCHPAD);
+  temp = new FingerMergeFilterInterpreter(prop_reg, temp, tracer);
+  temp = new StuckButtonInhibitorFilterInterpreter(temp, tracer);
+  return temp;
 }
 
 void GestureInterpreter::InitializeMouse(void) {
   Interpreter* temp = new MouseInterpreter(prop_reg_.get(), tracer_.get());
   // TODO(clchiou;chromium-os:36321): Use mouse acceleration algorithm for mice
-  temp = new AccelFilterInterpreter(prop_reg_.get(), temp, tracer_.get());
+  temp = new AccelFilterInterpreter(prop_reg_.get(), temp, tracer_.get(),
+                                    shared_resources_);
   temp = new ScalingFilterInterpreter(prop_reg_.get(), temp, tracer_.get(),
                                       GESTURES_DEVCLASS_MOUSE);
   temp = new MetricsFilterInterpreter(prop_reg_.get(), temp, tracer_.get(),
@@ -580,7 +840,8 @@ void GestureInterpreter::InitializeMultitouchMouse(void) {
   temp = new LookaheadFilterInterpreter(prop_reg_.get(), temp, tracer_.get());
   temp = new BoxFilterInterpreter(prop_reg_.get(), temp, tracer_.get());
   // TODO(clchiou;chromium-os:36321): Use mouse acceleration algorithm for mice
-  temp = new AccelFilterInterpreter(prop_reg_.get(), temp, tracer_.get());
+  temp = new AccelFilterInterpreter(prop_reg_.get(), temp, tracer_.get(),
+                                    shared_resources_);
   temp = new ScalingFilterInterpreter(prop_reg_.get(), temp, tracer_.get(),
                                       GESTURES_DEVCLASS_MULTITOUCH_MOUSE);
   temp = new MetricsFilterInterpreter(prop_reg_.get(), temp, tracer_.get(),
@@ -588,15 +849,26 @@ void GestureInterpreter::InitializeMultitouchMouse(void) {
   temp = new IntegralGestureFilterInterpreter(temp, tracer_.get());
   temp = new StuckButtonInhibitorFilterInterpreter(temp, tracer_.get());
   temp = new NonLinearityFilterInterpreter(prop_reg_.get(), temp,
-                                           tracer_.get());
+                                           tracer_.get(), shared_resources_);
   interpreter_.reset(temp);
   temp = NULL;
 }
 
 void GestureInterpreter::Initialize(GestureInterpreterDeviceClass cls) {
-  if (cls == GESTURES_DEVCLASS_TOUCHPAD ||
-      cls == GESTURES_DEVCLASS_TOUCHSCREEN)
-    InitializeTouchpad();
+  shadow_.reset();
+  bool touchpad = cls == GESTURES_DEVCLASS_TOUCHPAD ||
+      cls == GESTURES_DEVCLASS_TOUCHSCREEN;
+  // Read before holding creation, since the provider configures these.
+  int version = 0;
+  int shadow_version = 0;
+  if (touchpad)
+    ReadTouchpadStackVersions(&version, &shadow_version);
+
+  // The provider only sees the new chain's properties once it's complete
+  // and any old chain is gone.
+  prop_reg_->HoldCreation();
+  if (touchpad)
+    InitializeTouchpad(version, shadow_version);
   else if (cls == GESTURES_DEVCLASS_MOUSE)
     InitializeMouse();
   else if (cls == GESTURES_DEVCLASS_MULTITOUCH_MOUSE)
@@ -605,8 +877,17 @@ void GestureInterpreter::Initialize(GestureInterpreterDeviceClass cls) {
     Err("Couldn't recognize device class: %d", cls);
 
   mprops_.reset(new MetricsProperties(prop_reg_.get()));
+  if (config_profile_)
+    config_profile_->Apply(cls, config_fingerprint_, prop_reg_.get());
+  prop_reg_->CreateHeldProps();
+
   consumer_.reset(new GestureInterpreterConsumer(callback_,
                                                    callback_data_));
+  consumer_->SetRing(ring_.get(), ring_notify_, ring_notify_data_);
+  if (shadow_.get()) {
+    shadow_->CopyProperties(*prop_reg_);
+    consumer_->SetSummary(shadow_->primary_summary());
+  }
 }
 
 const GestureMove kGestureMove = { 0, 0, 0, 0 };
@@ -6,8 +6,10 @@
 #include <memory>
 #include <stdio.h>
 
+#include "gestures/include/finger_metrics.h"
 #include "gestures/include/macros.h"
 #include "gestures/include/gestures.h"
+#include "gestures/include/prop_registry.h"
 
 namespace gestures {
 
@@ -338,4 +340,152 @@ TEST(GesturesTest, HardwareStateToStringTest) {
   return;
 }
 
+namespace {
+struct FakeTimerProvider {
+  FakeTimerProvider() : set_count(0), cancel_count(0), delay(-1.0) {}
+  int set_count;
+  int cancel_count;
+  stime_t delay;
+};
+
+GesturesTimer* FakeTimerCreate(void* data) {
+  return reinterpret_cast<GesturesTimer*>(data);
+}
+
+void FakeTimerSet(void* data, GesturesTimer* timer, stime_t delay,
+                  GesturesTimerCallback callback, void* callback_data) {
+  FakeTimerProvider* provider = reinterpret_cast<FakeTimerProvider*>(data);
+  provider->set_count++;
+  provider->delay = delay;
+}
+
+void FakeTimerCancel(void* data, GesturesTimer* timer) {
+  reinterpret_cast<FakeTimerProvider*>(data)->cancel_count++;
+}
+
+void FakeTimerFree(void* data, GesturesTimer* timer) {}
+
+GesturesTimerProvider fake_timer_provider = {
+  FakeTimerCreate, FakeTimerSet, FakeTimerCancel, FakeTimerFree
+};
+}  // namespace {}
+
+// Frames that don't ask for a timeout shouldn't touch the provider's timer.
+TEST(GesturesTest, TimerChurnTest) {
+  HardwareProperties hwprops = {
+    0, 0, 0, 0,  // left, top, right, bottom
+    1, 1, 133, 133,  // res, dpi
+    0, 0,  // orientation minimum, maximum
+    0, 0, 0, 0, 0, 0  // max fingers, max_touch, t5r2, semi_mt, button pad, wheel
+  };
+  FakeTimerProvider provider;
+  GestureInterpreter gi(GESTURES_VERSION);
+  gi.SetTimerProvider(&fake_timer_provider, &provider);
+  gi.Initialize(GESTURES_DEVCLASS_MOUSE);
+  gi.SetHardwareProperties(hwprops);
+
+  for (int i = 0; i < 5; i++) {
+    HardwareState hs = { 1.0 + i * 0.01, 0, 0, 0, NULL, 1, 0, 0, 0 };
+    gi.PushHardwareState(&hs);
+  }
+  EXPECT_EQ(0, provider.set_count);
+  EXPECT_EQ(0, provider.cancel_count);
+
+  // Nothing was scheduled, so a stray callback shouldn't reach the chain or
+  // ask to be called again.
+  stime_t timeout = -1.0;
+  gi.TimerCallback(1.1, &timeout);
+  EXPECT_DOUBLE_EQ(-1.0, timeout);
+}
+
+namespace {
+void CountGestures(void* data, const struct Gesture* gesture) {
+  (*reinterpret_cast<int*>(data))++;
+}
+}  // namespace {}
+
+TEST(GesturesTest, SkipIdleFramesTest) {
+  HardwareProperties hwprops = {
+    0, 0, 0, 0,  // left, top, right, bottom
+    1, 1, 133, 133,  // res, dpi
+    0, 0,  // orientation minimum, maximum
+    0, 0, 0, 0, 0, 0  // max fingers, max_touch, t5r2, semi_mt, button pad, wheel
+  };
+  FakeTimerProvider provider;
+  GestureInterpreter gi(GESTURES_VERSION);
+  gi.SetTimerProvider(&fake_timer_provider, &provider);
+  gi.Initialize(GESTURES_DEVCLASS_MOUSE);
+  gi.SetHardwareProperties(hwprops);
+  int gesture_cnt = 0;
+  gi.set_callback(CountGestures, &gesture_cnt);
+
+  // Off by default
+  for (int i = 0; i < 3; i++) {
+    HardwareState hs = { 1.0 + i * 0.01, 0, 0, 0, NULL, 0, 0, 0, 0 };
+    gi.PushHardwareState(&hs);
+  }
+  EXPECT_EQ(0, gi.idle_frames_skipped());
+
+  Property* skip = gi.prop_reg()->GetProperty("Skip Idle Frames");
+  ASSERT_TRUE(skip != NULL);
+  EXPECT_TRUE(skip->SetValue(Json::Value(true)));
+
+  HardwareState hs[] = {
+    { 2.00, 0, 0, 0, NULL, 0, 0, 0, 0 },
+    { 2.01, 0, 0, 0, NULL, 0, 0, 0, 0 },  // idle
+    { 2.02, 0, 0, 0, NULL, 0, 0, 0, 0 },  // idle
+    { 2.03, 0, 0, 0, NULL, 0, 0, 0, 0 },  // idle
+    { 2.04, GESTURES_BUTTON_LEFT, 0, 0, NULL, 0, 0, 0, 0 },
+    { 2.05, GESTURES_BUTTON_LEFT, 0, 0, NULL, 0, 0, 0, 0 },  // idle
+    { 2.06, GESTURES_BUTTON_LEFT, 0, 0, NULL, 5, 0, 0, 0 },
+    { 2.07, GESTURES_BUTTON_LEFT, 0, 0, NULL, 0, 0, 0, 0 },  // idle
+    { 2.50, GESTURES_BUTTON_LEFT, 0, 0, NULL, 0, 0, 0, 0 },  // too long
+  };
+  size_t expected_skipped[] = { 0, 1, 2, 3, 3, 4, 4, 5, 5 };
+  for (size_t i = 0; i < arraysize(hs); i++) {
+    gi.PushHardwareState(&hs[i]);
+    EXPECT_EQ(expected_skipped[i], gi.idle_frames_skipped()) << "i=" << i;
+  }
+  // Skipping frames doesn't lose the button press or the motion.
+  EXPECT_LE(2, gesture_cnt);
+}
+
+// Frames with more fingers than the device can have are cut down to its
+// capacity before the chain sees them.
+TEST(GesturesTest, ContactCapacityTest) {
+  HardwareProperties hwprops = {
+    0, 0, 100, 60,  // left, top, right, bottom
+    1, 1, 133, 133,  // res, dpi
+    0, 0,  // orientation minimum, maximum
+    5, 5, 0, 0, 1, 0  // max fingers, max_touch, t5r2, semi_mt, button pad, wheel
+  };
+  FakeTimerProvider provider;
+  GestureInterpreter gi(GESTURES_VERSION);
+  gi.SetTimerProvider(&fake_timer_provider, &provider);
+  gi.Initialize(GESTURES_DEVCLASS_TOUCHPAD);
+  EXPECT_EQ(kMaxFingers, gi.contact_capacity());
+  gi.SetHardwareProperties(hwprops);
+  EXPECT_EQ(5, gi.contact_capacity());
+
+  FingerState fs[kMaxFingers + 2];
+  for (short i = 0; i < static_cast<short>(arraysize(fs)); i++) {
+    FingerState finger = { 0, 0, 0, 0, 50, 0, 10.0f + i, 30, i, 0 };
+    fs[i] = finger;
+  }
+  HardwareState hs = { 1.0, 0, 8, 8, fs, 0, 0, 0, 0 };
+  gi.PushHardwareState(&hs);
+  EXPECT_EQ(5, hs.finger_cnt);
+
+  // Devices with more contacts than the build supports get what it has.
+  hwprops.max_finger_cnt = hwprops.max_touch_cnt = kMaxFingers + 2;
+  gi.SetHardwareProperties(hwprops);
+  EXPECT_EQ(kMaxFingers, gi.contact_capacity());
+  for (size_t i = 0; i < 3; i++) {
+    HardwareState hs = { 1.01 + i * 0.01, 0, kMaxFingers + 2, kMaxFingers + 2,
+                         fs, 0, 0, 0, 0 };
+    gi.PushHardwareState(&hs);
+    EXPECT_EQ(kMaxFingers, hs.finger_cnt);
+  }
+}
+
 }  // namespace gestures
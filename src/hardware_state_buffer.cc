@@ -0,0 +1,47 @@
+// Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "gestures/include/hardware_state_buffer.h"
+
+#include <string.h>
+
+namespace gestures {
+
+HardwareStateBuffer::HardwareStateBuffer(size_t size)
+    : states_(new HardwareState[size]),
+      newest_index_(0), size_(size), depth_(0), max_finger_cnt_(0) {
+  for (size_t i = 0; i < size_; i++) {
+    memset(&states_[i], 0, sizeof(HardwareState));
+  }
+}
+
+void HardwareStateBuffer::Reset(size_t max_finger_cnt) {
+  max_finger_cnt_ = max_finger_cnt;
+  depth_ = 0;
+  if (max_finger_cnt_) {
+    fingers_.reset(new FingerState[size_ * max_finger_cnt_]);
+    memset(fingers_.get(), 0, sizeof(FingerState) * size_ * max_finger_cnt_);
+  } else {
+    fingers_.reset();
+  }
+  for (size_t i = 0; i < size_; i++) {
+    states_[i].fingers =
+        max_finger_cnt_ ? &fingers_[i * max_finger_cnt_] : NULL;
+  }
+}
+
+void HardwareStateBuffer::PushState(const HardwareState& state) {
+  newest_index_ = (newest_index_ + size_ - 1) % size_;
+  Get(0)->DeepCopy(state, max_finger_cnt_);
+  if (depth_ < size_)
+    depth_++;
+}
+
+void HardwareStateBuffer::PopState() {
+  newest_index_ = (newest_index_ + 1) % size_;
+  if (depth_)
+    depth_--;
+}
+
+}  // namespace gestures
@@ -0,0 +1,57 @@
+// Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include "gestures/include/gestures.h"
+#include "gestures/include/hardware_state_buffer.h"
+
+namespace gestures {
+
+class HardwareStateBufferTest : public ::testing::Test {};
+
+TEST(HardwareStateBufferTest, SimpleTest) {
+  HardwareStateBuffer buffer(3);
+  buffer.Reset(2);
+  EXPECT_EQ(0U, buffer.Depth());
+  EXPECT_EQ(static_cast<const FingerState*>(NULL),
+            buffer.GetFinger(0, 1));
+
+  for (size_t i = 0; i < 5; i++) {
+    FingerState fs[] = {
+      // TM, Tm, WM, Wm, Press, Orientation, X, Y, TrID
+      { 0, 0, 0, 0, 50, 0, 10.0f + i, 10, 1, 0 },
+      { 0, 0, 0, 0, 50, 0, 20.0f + i, 20, static_cast<short>(2 + i), 0 },
+    };
+    HardwareState hs = { 0.01 * i, 0, 2, 2, fs, 0, 0, 0, 0 };
+    buffer.PushState(hs);
+    // The buffer keeps its own copy.
+    fs[0].position_x = -1.0;
+  }
+  EXPECT_EQ(3U, buffer.Depth());
+  for (size_t age = 0; age < 3; age++) {
+    const FingerState* fs = buffer.GetFinger(age, 1);
+    ASSERT_NE(static_cast<const FingerState*>(NULL), fs) << "age=" << age;
+    EXPECT_FLOAT_EQ(14.0 - age, fs->position_x) << "age=" << age;
+    EXPECT_DOUBLE_EQ(0.04 - 0.01 * age, buffer.Get(age)->timestamp);
+  }
+  // Too old
+  EXPECT_EQ(static_cast<const FingerState*>(NULL),
+            buffer.GetFinger(3, 1));
+  // Only in an older frame
+  EXPECT_EQ(static_cast<const FingerState*>(NULL),
+            buffer.GetFinger(0, 5));
+  EXPECT_NE(static_cast<const FingerState*>(NULL), buffer.GetFinger(1, 5));
+
+  buffer.PopState();
+  EXPECT_EQ(2U, buffer.Depth());
+  EXPECT_FLOAT_EQ(13.0, buffer.GetFinger(0, 1)->position_x);
+
+  buffer.Reset(2);
+  EXPECT_EQ(0U, buffer.Depth());
+  EXPECT_EQ(static_cast<const FingerState*>(NULL),
+            buffer.GetFinger(0, 1));
+}
+
+}  // namespace gestures
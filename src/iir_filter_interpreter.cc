@@ -4,27 +4,15 @@
 
 #include "gestures/include/iir_filter_interpreter.h"
 
-#include <utility>
+#include <string.h>
 
-namespace gestures {
+#include <algorithm>
 
-void IirFilterInterpreter::IoHistory::Increment() {
-  out_head = NextOutHead();
-  in_head = NextInHead();
-}
+#include "gestures/include/logging.h"
 
-// Uses exact comparisions, rather than approximate float comparisions,
-// for operator==
-bool IirFilterInterpreter::IoHistory::operator==(
-    const IirFilterInterpreter::IoHistory& that) const {
-  for (size_t i = 0; i < kInSize; i++)
-    if (in[i] != that.in[i])
-      return false;
-  for (size_t i = 0; i < kOutSize; i++)
-    if (out[i] != that.out[i])
-      return false;
-  return true;
-}
+namespace gestures {
+
+const size_t IirFilterInterpreter::kMaxCascadeStages;
 
 // The default filter is a low-pass 2nd order Butterworth IIR filter with a
 // normalized cutoff frequency of 0.2.
@@ -32,58 +20,99 @@ IirFilterInterpreter::IirFilterInterpreter(PropRegistry* prop_reg,
                                            Interpreter* next,
                                            Tracer* tracer)
     : FilterInterpreter(NULL, next, tracer, false),
+      num_stages_(1),
       b0_(prop_reg, "IIR b0", 0.0674552738890719, this),
       b1_(prop_reg, "IIR b1", 0.134910547778144, this),
       b2_(prop_reg, "IIR b2", 0.0674552738890719, this),
       b3_(prop_reg, "IIR b3", 0.0, this),
       a1_(prop_reg, "IIR a1", -1.1429805025399, this),
       a2_(prop_reg, "IIR a2", 0.412801598096189, this),
+      cascade_coeffs_(),
+      cascade_coeffs_prop_(prop_reg, "IIR Cascade Coefficients",
+                           cascade_coeffs_, arraysize(cascade_coeffs_), this),
+      iir_cascade_stages_(prop_reg, "IIR Cascade Stages", 0, this),
       iir_dist_thresh_(prop_reg, "IIR Distance Threshold", 10, this),
       adjust_iir_on_warp_(prop_reg, "Adjust IIR History On Warp", 0),
       using_iir_(true) {
   InitName();
+  memset(state_, 0, sizeof(state_));
+  memset(values_, 0, sizeof(values_));
+  UpdateCoefficients();
 }
 
 void IirFilterInterpreter::SyncInterpretImpl(HardwareState* hwstate,
                                              stime_t* timeout) {
-  // Delete old entries from map
-  short dead_ids[histories_.size()];
+  // Find each finger's slot, and free the slots of fingers that have left.
+  size_t finger_cnt = std::min(static_cast<size_t>(hwstate->finger_cnt),
+                               kMaxFingers);
+  size_t finger_slots[kMaxFingers];
+  bool new_finger[kMaxFingers];
+  bool slot_seen[kMaxFingers];
+  memset(new_finger, 0, sizeof(new_finger));
+  memset(slot_seen, 0, sizeof(slot_seen));
+  for (size_t i = 0; i < finger_cnt; i++) {
+    FingerSlotMap::const_iterator it =
+        slots_.find(hwstate->fingers[i].tracking_id);
+    finger_slots[i] = it == slots_.end() ? kMaxFingers : it->second;
+    if (it != slots_.end())
+      slot_seen[it->second] = true;
+  }
+  short dead_ids[kMaxFingers];
   size_t dead_ids_len = 0;
-  for (map<short, IoHistory, kMaxFingers>::iterator it = histories_.begin(),
-           e = histories_.end(); it != e; ++it)
-    if (!hwstate->GetFingerState((*it).first))
-      dead_ids[dead_ids_len++] = (*it).first;
-  for (size_t i = 0; i < dead_ids_len; ++i)
-    histories_.erase(dead_ids[i]);
-
-  // Modify current hwstate
-  for (size_t i = 0; i < hwstate->finger_cnt; i++) {
+  for (FingerSlotMap::const_iterator it = slots_.begin(), e = slots_.end();
+       it != e; ++it)
+    if (!slot_seen[it->second])
+      dead_ids[dead_ids_len++] = it->first;
+  for (size_t i = 0; i < dead_ids_len; ++i) {
+    slot_used_[slots_[dead_ids[i]]] = false;
+    slots_.erase(dead_ids[i]);
+  }
+
+  // Gather the inputs. Lanes that can't be filtered this frame have their
+  // outputs overridden once the cascade has run.
+  size_t override_lanes[kMaxLanes];
+  float override_values[kMaxLanes];
+  size_t overrides_len = 0;
+  size_t lanes = 0;
+  const StageState& last = state_[num_stages_ - 1];
+  for (size_t i = 0; i < finger_cnt; i++) {
     FingerState* fs = &hwstate->fingers[i];
-    map<short, IoHistory, kMaxFingers>::iterator history =
-        histories_.find(fs->tracking_id);
-    if (history == histories_.end()) {
+    size_t slot = finger_slots[i];
+    if (slot == kMaxFingers) {
       // new finger
-      IoHistory hist(*fs);
-      histories_[fs->tracking_id] = hist;
+      slot = std::find(slot_used_, slot_used_ + kMaxFingers, false) -
+          slot_used_;
+      if (slot == kMaxFingers) {
+        Err("Finger slots out of space");
+        continue;
+      }
+      slot_used_[slot] = true;
+      slots_[fs->tracking_id] = slot;
+      finger_slots[i] = slot;
+      new_finger[i] = true;
       continue;
     }
     // existing finger, apply filter
-    IoHistory* hist = &(*history).second;
+    size_t x_lane = Lane(slot, kChannelX);
+    size_t y_lane = Lane(slot, kChannelY);
+    size_t pressure_lane = Lane(slot, kChannelPressure);
+    lanes = std::max(lanes, Lane(slot + 1, 0));
+    values_[x_lane] = fs->position_x;
+    values_[y_lane] = fs->position_y;
+    values_[pressure_lane] = fs->pressure;
 
     // Finger WARP detected, adjust the IO history
-    if (adjust_iir_on_warp_.val_) {
-      float dx = 0.0, dy = 0.0;
-
-      if (fs->flags & GESTURES_FINGER_WARP_X_MOVE)
-        dx = fs->position_x - hist->PrevIn(0)->position_x;
-      if (fs->flags & GESTURES_FINGER_WARP_Y_MOVE)
-        dy = fs->position_y - hist->PrevIn(0)->position_y;
-
-      hist->WarpBy(dx, dy);
-    }
-
-    float dx = fs->position_x - hist->PrevOut(0)->position_x;
-    float dy = fs->position_y - hist->PrevOut(0)->position_y;
+    bool warp_x = adjust_iir_on_warp_.val_ &&
+        (fs->flags & GESTURES_FINGER_WARP_X_MOVE);
+    bool warp_y = adjust_iir_on_warp_.val_ &&
+        (fs->flags & GESTURES_FINGER_WARP_Y_MOVE);
+    if (warp_x)
+      WarpLane(x_lane, fs->position_x - state_[0].in1[x_lane]);
+    if (warp_y)
+      WarpLane(y_lane, fs->position_y - state_[0].in1[y_lane]);
+
+    float dx = fs->position_x - last.out1[x_lane];
+    float dy = fs->position_y - last.out1[y_lane];
 
     // IIR filter is too smooth for a quick finger movement. We do a simple
     // rolling average if the position change between current and previous
@@ -93,75 +122,132 @@ void IirFilterInterpreter::SyncInterpretImpl(HardwareState* hwstate,
     else
       using_iir_ = true;
 
-    // TODO(adlr): consider applying filter to other fields
-    float FingerState::*fields[] = { &FingerState::position_x,
-                                     &FingerState::position_y,
-                                     &FingerState::pressure };
-    for (size_t f_idx = 0; f_idx < arraysize(fields); f_idx++) {
-      float FingerState::*field = fields[f_idx];
+    for (size_t channel = 0; channel < kNumChannels; channel++) {
+      size_t lane = Lane(slot, channel);
+      float value = values_[lane];
       // Keep the current pressure reading, so we could make sure the pressure
       // values will be same if there is two fingers on a SemiMT device.
-      if (hwprops_ && hwprops_->support_semi_mt &&
-          (field == &FingerState::pressure)) {
-        hist->NextOut()->pressure = fs->pressure;
+      bool keep = (channel == kChannelPressure && hwprops_ &&
+                   hwprops_->support_semi_mt) ||
+          (channel == kChannelX && warp_x) ||
+          (channel == kChannelY && warp_y);
+      if (!keep && !using_iir_)
+        value = 0.5 * (value + last.out1[lane]);
+      else if (!keep)
         continue;
-      }
+      override_lanes[overrides_len] = lane;
+      override_values[overrides_len++] = value;
+    }
+  }
 
-      if (adjust_iir_on_warp_.val_) {
-        if (field == &FingerState::position_x &&
-            (fs->flags & GESTURES_FINGER_WARP_X_MOVE)) {
-          hist->NextOut()->position_x = fs->position_x;
-          continue;
-        }
-
-        if (field == &FingerState::position_y &&
-            (fs->flags & GESTURES_FINGER_WARP_Y_MOVE)) {
-          hist->NextOut()->position_y = fs->position_y;
-          continue;
-        }
-      }
+  // Lanes of slots that aren't being filtered this frame go through the
+  // cascade too; they're reset before they are used again.
+  for (size_t stage = 0; stage < num_stages_; stage++)
+    RunStage(stage, lanes);
+  for (size_t i = 0; i < overrides_len; i++)
+    SetLaneOutput(override_lanes[i], override_values[i]);
 
-      if (using_iir_) {
-        hist->NextOut()->*field =
-            b3_.val_ * hist->PrevIn(2)->*field +
-            b2_.val_ * hist->PrevIn(1)->*field +
-            b1_.val_ * hist->PrevIn(0)->*field +
-            b0_.val_ * fs->*field -
-            a2_.val_ * hist->PrevOut(1)->*field -
-            a1_.val_ * hist->PrevOut(0)->*field;
-      } else {
-        hist->NextOut()->*field = 0.5 * (fs->*field + hist->PrevOut(0)->*field);
-      }
+  for (size_t i = 0; i < finger_cnt; i++) {
+    size_t slot = finger_slots[i];
+    if (slot == kMaxFingers)
+      continue;
+    FingerState* fs = &hwstate->fingers[i];
+    if (new_finger[i]) {
+      // The filter starts from the finger's first position.
+      ResetLane(Lane(slot, kChannelX), fs->position_x);
+      ResetLane(Lane(slot, kChannelY), fs->position_y);
+      ResetLane(Lane(slot, kChannelPressure), fs->pressure);
+      continue;
     }
-    float FingerState::*pass_fields[] = { &FingerState::touch_major,
-                                          &FingerState::touch_minor,
-                                          &FingerState::width_major,
-                                          &FingerState::width_minor,
-                                          &FingerState::orientation };
-    for (size_t f_idx = 0; f_idx < arraysize(pass_fields); f_idx++)
-      hist->NextOut()->*pass_fields[f_idx] = fs->*pass_fields[f_idx];
-    hist->NextOut()->flags = fs->flags;
-    *hist->NextIn() = *fs;
-    *fs = *hist->NextOut();
-    hist->Increment();
+    fs->position_x = values_[Lane(slot, kChannelX)];
+    fs->position_y = values_[Lane(slot, kChannelY)];
+    fs->pressure = values_[Lane(slot, kChannelPressure)];
   }
   next_->SyncInterpret(hwstate, timeout);
 }
 
-void IirFilterInterpreter::DoubleWasWritten(DoubleProperty* prop) {
-  histories_.clear();
+void IirFilterInterpreter::RunStage(size_t stage, size_t lanes) {
+  const Coefficients& c = coeffs_[stage];
+  StageState* s = &state_[stage];
+  for (size_t i = 0; i < lanes; i++) {
+    float in = values_[i];
+    float out = c.b0 * in + c.b1 * s->in1[i] + c.b2 * s->in2[i] +
+        c.b3 * s->in3[i] - c.a1 * s->out1[i] - c.a2 * s->out2[i];
+    s->in3[i] = s->in2[i];
+    s->in2[i] = s->in1[i];
+    s->in1[i] = in;
+    s->out2[i] = s->out1[i];
+    s->out1[i] = out;
+    values_[i] = out;
+  }
 }
 
-void IirFilterInterpreter::IoHistory::WarpBy(float dx, float dy) {
-  for (size_t i = 0; i < kInSize; i++) {
-    PrevIn(i)->position_x += dx;
-    PrevIn(i)->position_y += dy;
+void IirFilterInterpreter::ResetLane(size_t lane, float value) {
+  for (size_t stage = 0; stage < kMaxStages; stage++) {
+    StageState* s = &state_[stage];
+    s->in1[lane] = s->in2[lane] = s->in3[lane] = value;
+    s->out1[lane] = s->out2[lane] = value;
   }
+}
+
+void IirFilterInterpreter::SetLaneOutput(size_t lane, float value) {
+  state_[0].out1[lane] = value;
+  for (size_t stage = 1; stage < num_stages_; stage++)
+    state_[stage].in1[lane] = state_[stage].out1[lane] = value;
+  values_[lane] = value;
+}
 
-  for (size_t i = 0; i < kOutSize; i++) {
-    PrevOut(i)->position_x += dx;
-    PrevOut(i)->position_y += dy;
+void IirFilterInterpreter::WarpLane(size_t lane, float delta) {
+  for (size_t stage = 0; stage < num_stages_; stage++) {
+    StageState* s = &state_[stage];
+    s->in1[lane] += delta;
+    s->in2[lane] += delta;
+    s->in3[lane] += delta;
+    s->out1[lane] += delta;
+    s->out2[lane] += delta;
   }
 }
 
+void IirFilterInterpreter::UpdateCoefficients() {
+  Coefficients main = { static_cast<float>(b0_.val_),
+                        static_cast<float>(b1_.val_),
+                        static_cast<float>(b2_.val_),
+                        static_cast<float>(b3_.val_),
+                        static_cast<float>(a1_.val_),
+                        static_cast<float>(a2_.val_) };
+  coeffs_[0] = main;
+  size_t cascade_stages = std::min(
+      static_cast<size_t>(std::max(iir_cascade_stages_.val_, 0)),
+      kMaxCascadeStages);
+  if (cascade_stages != static_cast<size_t>(iir_cascade_stages_.val_))
+    Err("IIR Cascade Stages must be from 0 to %zu", kMaxCascadeStages);
+  for (size_t i = 0; i < cascade_stages; i++) {
+    const double* c = &cascade_coeffs_[5 * i];
+    Coefficients biquad = { static_cast<float>(c[0]),
+                            static_cast<float>(c[1]),
+                            static_cast<float>(c[2]),
+                            0.0,
+                            static_cast<float>(c[3]),
+                            static_cast<float>(c[4]) };
+    coeffs_[i + 1] = biquad;
+  }
+  num_stages_ = cascade_stages + 1;
+
+  // The old histories don't fit the new filter.
+  slots_.clear();
+  memset(slot_used_, 0, sizeof(slot_used_));
+}
+
+void IirFilterInterpreter::DoubleWasWritten(DoubleProperty* prop) {
+  UpdateCoefficients();
+}
+
+void IirFilterInterpreter::DoubleArrayWasWritten(DoubleArrayProperty* prop) {
+  UpdateCoefficients();
+}
+
+void IirFilterInterpreter::IntWasWritten(IntProperty* prop) {
+  UpdateCoefficients();
+}
+
 }  // namespace gestures
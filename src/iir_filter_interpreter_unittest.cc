@@ -2,6 +2,8 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <string.h>
+
 #include <gtest/gtest.h>
 
 #include "gestures/include/gestures.h"
@@ -37,6 +39,13 @@ class IirFilterInterpreterTestInterpreter : public Interpreter {
   size_t sync_interpret_cnt_;
 };
 
+class IirFilterInterpreterNullInterpreter : public Interpreter {
+ public:
+  IirFilterInterpreterNullInterpreter() : Interpreter(NULL, NULL, false) {}
+
+  virtual void SyncInterpret(HardwareState* hwstate, stime_t* timeout) {}
+};
+
 TEST(IirFilterInterpreterTest, SimpleTest) {
   IirFilterInterpreterTestInterpreter* base_interpreter =
       new IirFilterInterpreterTestInterpreter;
@@ -155,4 +164,67 @@ TEST(IirFilterInterpreterTest, SemiMTIIRTest) {
   EXPECT_EQ(fs_semi_mt[n - 1].pressure, kTestPressure);
 }
 
+// Every finger is filtered on its own, by the main filter then the cascade.
+TEST(IirFilterInterpreterTest, CascadeTest) {
+  IirFilterInterpreter interpreter(
+      NULL, new IirFilterInterpreterNullInterpreter, NULL);
+  TestInterpreterWrapper wrapper(&interpreter);
+  // A 2nd order Butterworth low-pass section, cutoff 0.1
+  const double kBiquad[] = { 0.0200833655642112, 0.0401667311284225,
+                             0.0200833655642112, -1.56101807580072,
+                             0.641351538057563 };
+  for (size_t i = 0; i < arraysize(kBiquad); i++)
+    interpreter.cascade_coeffs_[i] = kBiquad[i];
+  interpreter.iir_cascade_stages_.val_ = 1;
+  interpreter.IntWasWritten(&interpreter.iir_cascade_stages_);
+  EXPECT_EQ(2U, interpreter.num_stages_);
+
+  // Reference filter state for each finger: inputs and outputs of the main
+  // filter, then of the biquad, most recent first.
+  const size_t kFingers = 2;
+  double in[kFingers][2][3], out[kFingers][2][2];
+  const double kMain[] = { interpreter.b0_.val_, interpreter.b1_.val_,
+                           interpreter.b2_.val_, interpreter.a1_.val_,
+                           interpreter.a2_.val_ };
+  const double* coeffs[] = { kMain, kBiquad };
+  for (size_t frame = 0; frame < 20; frame++) {
+    FingerState fs[kFingers];
+    memset(fs, 0, sizeof(fs));
+    for (size_t i = 0; i < kFingers; i++) {
+      // Small steps, so the rolling average never kicks in
+      fs[i].position_x = 10.0 * i + 0.5 * frame;
+      fs[i].position_y = 40.0 - 0.25 * frame * i;
+      fs[i].pressure = 30.0 + (frame % 3);
+      fs[i].tracking_id = 10 + i;
+    }
+    double expected[kFingers];
+    for (size_t i = 0; i < kFingers; i++) {
+      double value = fs[i].position_x;
+      for (size_t stage = 0; stage < 2; stage++) {
+        double* x = in[i][stage];
+        double* y = out[i][stage];
+        if (frame == 0) {
+          x[0] = x[1] = x[2] = y[0] = y[1] = value;
+          continue;
+        }
+        const double* c = coeffs[stage];
+        double result = c[0] * value + c[1] * x[0] + c[2] * x[1] -
+            c[3] * y[0] - c[4] * y[1];
+        x[2] = x[1];
+        x[1] = x[0];
+        x[0] = value;
+        y[1] = y[0];
+        y[0] = result;
+        value = result;
+      }
+      expected[i] = value;
+    }
+    HardwareState hs = { 0.01 * frame, 0, kFingers, kFingers, fs, 0, 0, 0, 0 };
+    wrapper.SyncInterpret(&hs, NULL);
+    for (size_t i = 0; i < kFingers; i++)
+      EXPECT_NEAR(expected[i], fs[i].position_x, 1e-3) << "frame=" << frame;
+    EXPECT_TRUE(interpreter.using_iir_);
+  }
+}
+
 }  // namespace gestures
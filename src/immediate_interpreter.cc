@@ -307,46 +307,6 @@ void ScrollEventBuffer::GetSpeedSq(size_t num_events, float* dist_sq,
   *dist_sq = dx * dx + dy * dy;
 }
 
-HardwareStateBuffer::HardwareStateBuffer(size_t size)
-    : states_(new HardwareState[size]),
-      newest_index_(0), size_(size), max_finger_cnt_(0) {
-  for (size_t i = 0; i < size_; i++) {
-    memset(&states_[i], 0, sizeof(HardwareState));
-  }
-}
-
-HardwareStateBuffer::~HardwareStateBuffer() {
-  for (size_t i = 0; i < size_; i++) {
-    delete[] states_[i].fingers;
-  }
-}
-
-void HardwareStateBuffer::Reset(size_t max_finger_cnt) {
-  max_finger_cnt_ = max_finger_cnt;
-  for (size_t i = 0; i < size_; i++) {
-    delete[] states_[i].fingers;
-  }
-  if (max_finger_cnt_) {
-    for (size_t i = 0; i < size_; i++) {
-      states_[i].fingers = new FingerState[max_finger_cnt_];
-      memset(states_[i].fingers, 0, sizeof(FingerState) * max_finger_cnt_);
-    }
-  } else {
-    for (size_t i = 0; i < size_; i++) {
-      states_[i].fingers = NULL;
-    }
-  }
-}
-
-void HardwareStateBuffer::PushState(const HardwareState& state) {
-  newest_index_ = (newest_index_ + size_ - 1) % size_;
-  Get(0)->DeepCopy(state, max_finger_cnt_);
-}
-
-void HardwareStateBuffer::PopState() {
-  newest_index_ = (newest_index_ + 1) % size_;
-}
-
 ScrollManager::ScrollManager(PropRegistry* prop_reg)
     : prev_result_suppress_finger_movement_(false),
       did_generate_scroll_(false),
@@ -1595,7 +1555,7 @@ void ImmediateInterpreter::SortFingersByProximity(
       if (!SetContainsValue(finger_ids, fs2.tracking_id))
         continue;
       DistSqElt elt = {
-        DistSq(fs1, fs2),
+        geometry_->DistSq(hwstate, i, j),
         { fs1.tracking_id, fs2.tracking_id }
       };
       if (dist_sq_len >= dist_sq_capacity) {
@@ -25,6 +25,7 @@ Interpreter::Interpreter(PropRegistry* prop_reg,
                          bool force_logging)
     : requires_metrics_(false),
       initialized_(false),
+      geometry_(new FrameGeometry),
       name_(NULL),
       tracer_(tracer) {
 #ifdef DEEP_LOGS
@@ -41,6 +41,9 @@ LookaheadFilterInterpreter::LookaheadFilterInterpreter(
       delay_on_possible_liftoff_(prop_reg, "Delay On Possible Liftoff", 0),
       liftoff_speed_increase_threshold_(prop_reg, "Liftoff Speed Factor", 5.0) {
   InitName();
+  // Interpreters below see frames later than those above, so they keep
+  // their own geometry.
+  geometry_.reset(new FrameGeometry);
 }
 
 void LookaheadFilterInterpreter::SyncInterpretImpl(HardwareState* hwstate,
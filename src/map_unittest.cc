@@ -179,4 +179,38 @@ TEST(MapTest, StdMapEraseIteratorTest) {
   DoMapEraseIteratorTest(&std_map);
 }
 
+// Maps keyed by tracking id look them up through a hash table.
+TEST(MapTest, TrackingIdTest) {
+  const size_t kMax = 40;
+  map<short, int, kMax> the_map;
+  // Ids that wrap around and collide in the table
+  for (size_t i = 0; i < kMax; i++)
+    the_map[static_cast<short>(i * 1024 - 7)] = i;
+  EXPECT_EQ(kMax, the_map.size());
+  for (size_t i = 0; i < kMax; i += 2)
+    EXPECT_EQ(1, the_map.erase(static_cast<short>(i * 1024 - 7)));
+  EXPECT_EQ(kMax / 2, the_map.size());
+  for (size_t i = 0; i < kMax; i++) {
+    map<short, int, kMax>::iterator it =
+        the_map.find(static_cast<short>(i * 1024 - 7));
+    if (i % 2 == 0) {
+      EXPECT_TRUE(it == the_map.end());
+      continue;
+    }
+    ASSERT_TRUE(it != the_map.end());
+    EXPECT_EQ(i, it->second);
+  }
+  // Insertion order is kept.
+  EXPECT_EQ(1, the_map.begin()->second);
+
+  map<short, int, kMax / 2> small;
+  small = the_map;
+  EXPECT_TRUE(small == the_map);
+  EXPECT_EQ(3, small[3 * 1024 - 7]);
+  small[3 * 1024 - 7] = 0;
+  EXPECT_TRUE(small != the_map);
+  small.clear();
+  EXPECT_TRUE(small.find(3 * 1024 - 7) == small.end());
+}
+
 }  // namespace gestures
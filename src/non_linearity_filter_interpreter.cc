@@ -4,11 +4,25 @@
 
 #include "gestures/include/non_linearity_filter_interpreter.h"
 
-#include <linux/in.h>
+#include <fcntl.h>
+#include <math.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "gestures/include/eintr_wrapper.h"
+#include "gestures/include/logging.h"
 
 namespace {
 const size_t kIntPackedSize = 4;
 const size_t kDoublePackedSize = 8;
+// How far points may be from an even spacing, as a fraction of the step,
+// for an axis to be looked up by direct indexing. Find() corrects for the
+// rounding that allows.
+const double kUniformTolerance = 1e-3;
 }
 
 namespace gestures {
@@ -16,105 +30,225 @@ namespace gestures {
 NonLinearityFilterInterpreter::NonLinearityFilterInterpreter(
                                                         PropRegistry* prop_reg,
                                                         Interpreter* next,
-                                                        Tracer* tracer)
+                                                        Tracer* tracer,
+                                                        SharedResources*
+                                                            resources)
     : FilterInterpreter(NULL, next, tracer, false),
+      resources_(resources),
       enabled_(prop_reg, "Enable non-linearity correction", false),
-      data_location_(prop_reg, "Non-linearity correction data file", "None"),
-      x_range_len_(0), y_range_len_(0), p_range_len_(0) {
+      data_location_(prop_reg, "Non-linearity correction data file", "None",
+                     this) {
   InitName();
   LoadData();
 }
 
-unsigned int NonLinearityFilterInterpreter::ErrorIndex(size_t x_index,
-                                                       size_t y_index,
-                                                       size_t p_index) const {
-  unsigned int index = x_index * y_range_len_ * p_range_len_ +
-                       y_index * p_range_len_ + p_index;
+const uint32_t NonLinearityFilterInterpreter::kDataMagic;
+const uint32_t NonLinearityFilterInterpreter::kDataVersion;
 
-  if (index >= x_range_len_ * y_range_len_ * p_range_len_)
-    index = 0;
-  return index;
+void NonLinearityFilterInterpreter::StringWasWritten(StringProperty* prop) {
+  LoadData();
 }
 
-int NonLinearityFilterInterpreter::ReadObject(void* buf, size_t object_size,
-                                            FILE* fd) {
-  int objs_read = fread(buf, object_size, 1, fd);
-  /* If this machine is big endian, reverse the bytes in the object */
-  if (object_size == kDoublePackedSize)
-    __le64_to_cpu(*static_cast<double*>(buf));
-  if (object_size == kIntPackedSize)
-    __le32_to_cpu(*static_cast<int32_t*>(buf));
-
-  return objs_read;
+NonLinearityFilterInterpreter::Grid::~Grid() {
+  if (mapped)
+    munmap(const_cast<char*>(mapped), mapped_size);
 }
 
-bool NonLinearityFilterInterpreter::LoadRange(std::unique_ptr<double[]>& arr,
-                                              size_t& len, FILE* fd) {
-  int tmp;
-  if (!ReadObject(&tmp, kIntPackedSize, fd))
+bool NonLinearityFilterInterpreter::Grid::SetPayload(const float* payload,
+                                                     size_t x_len,
+                                                     size_t y_len,
+                                                     size_t p_len) {
+  x.points = payload;
+  x.len = x_len;
+  y.points = x.points + x_len;
+  y.len = y_len;
+  p.points = y.points + y_len;
+  p.len = p_len;
+  err = reinterpret_cast<const Error*>(p.points + p_len);
+  if (!x.Prepare() || !y.Prepare() || !p.Prepare()) {
+    Err("Non-linearity filter data points must be increasing");
     return false;
-  len = tmp;
+  }
+  for (size_t i = 0; i < arraysize(corner_offsets); i++)
+    corner_offsets[i] = ErrorIndex(i >> 2, (i >> 1) & 1, i & 1);
+  return true;
+}
 
-  arr.reset(new double[len]);
-  for (size_t i = 0; i < len; i++) {
-    double tmp;
-    if (!ReadObject(&tmp, kDoublePackedSize, fd))
+bool NonLinearityFilterInterpreter::Axis::Prepare() {
+  for (size_t i = 1; i < len; i++)
+    if (!(points[i - 1] < points[i]))
       return false;
-    else
-      arr[i] = tmp;
+  uniform = false;
+  if (len < 2)
+    return true;
+  double step = (points[len - 1] - points[0]) / (len - 1);
+  for (size_t i = 1; i < len - 1; i++)
+    if (fabs(points[i] - (points[0] + i * step)) > kUniformTolerance * step)
+      return true;
+  uniform = true;
+  origin = points[0];
+  inv_step = 1.0 / step;
+  return true;
+}
+
+bool NonLinearityFilterInterpreter::Axis::Find(float value, size_t* lo,
+                                               float* frac) const {
+  if (len < 2 || !(points[0] <= value) || !(value < points[len - 1]))
+    return false;
+  size_t idx;
+  if (uniform) {
+    idx = std::min(static_cast<size_t>((value - origin) * inv_step), len - 2);
+    if (points[idx] > value)
+      idx--;
+    else if (points[idx + 1] <= value)
+      idx++;
+  } else {
+    idx = std::upper_bound(points, points + len, value) - points - 1;
   }
+  *lo = idx;
+  *frac = (value - points[idx]) / (points[idx + 1] - points[idx]);
   return true;
 }
 
 void NonLinearityFilterInterpreter::LoadData() {
-  FILE* data_fd = fopen(data_location_.val_, "rb");
-  if (!data_fd) {
-    Log("Unable to open non-linearity filter data '%s'", data_location_.val_);
+  void* path = const_cast<char*>(data_location_.val_);
+  if (!resources_) {
+    grid_.reset(NewGrid(path));
     return;
   }
+  // Files that can't be stat()ed can't be opened either, so let NewGrid()
+  // log the failure.
+  std::string key = SharedResources::FileKey("NonLinearityFilterInterpreter",
+                                             data_location_.val_);
+  if (key.empty())
+    grid_.reset(NewGrid(path));
+  else
+    grid_ = resources_->Get<Grid>(key, NewGrid, path);
+}
+
+NonLinearityFilterInterpreter::Grid*
+NonLinearityFilterInterpreter::NewGrid(void* path) {
+  const char* filename = reinterpret_cast<const char*>(path);
+  int fd = HANDLE_EINTR(open(filename, O_RDONLY));
+  if (fd < 0) {
+    Log("Unable to open non-linearity filter data '%s'", filename);
+    return NULL;
+  }
+  struct stat st;
+  void* mapped = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size > 0)
+    mapped = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  IGNORE_EINTR(close(fd));
+  if (mapped == MAP_FAILED) {
+    Err("Unable to map non-linearity filter data '%s'", filename);
+    return NULL;
+  }
+
+  std::unique_ptr<Grid> grid(new Grid);
+  grid->mapped = static_cast<const char*>(mapped);
+  grid->mapped_size = st.st_size;
+  uint32_t magic = 0;
+  memcpy(&magic, grid->mapped, std::min(sizeof(magic), grid->mapped_size));
+  bool valid;
+  if (magic == kDataMagic) {
+    valid = UseCompiledData(grid.get(), grid->mapped, grid->mapped_size);
+  } else {
+    valid = ConvertOriginalData(grid.get(), grid->mapped, grid->mapped_size);
+    // The converted copy doesn't need the file
+    munmap(mapped, grid->mapped_size);
+    grid->mapped = NULL;
+    grid->mapped_size = 0;
+  }
+  if (!valid) {
+    Err("Invalid non-linearity filter data '%s'", filename);
+    return NULL;
+  }
+  return grid.release();
+}
+
+bool NonLinearityFilterInterpreter::UseCompiledData(Grid* grid,
+                                                    const char* data,
+                                                    size_t size) {
+  if (size < sizeof(DataHeader))
+    return false;
+  const DataHeader* header = reinterpret_cast<const DataHeader*>(data);
+  if (header->magic != kDataMagic || header->version != kDataVersion ||
+      header->size != size)
+    return false;
+  // 64 bits, so that huge dimensions can't wrap around.
+  uint64_t cells = static_cast<uint64_t>(header->x_len) * header->y_len *
+      header->p_len;
+  uint64_t payload_floats = static_cast<uint64_t>(header->x_len) +
+      header->y_len + header->p_len + 2 * cells;
+  if (sizeof(DataHeader) + payload_floats * sizeof(float) != size)
+    return false;
+  const char* payload = data + sizeof(DataHeader);
+  if (Checksum(payload, size - sizeof(DataHeader)) != header->checksum) {
+    Err("Non-linearity filter data checksum mismatch");
+    return false;
+  }
+  return grid->SetPayload(reinterpret_cast<const float*>(payload),
+                          header->x_len, header->y_len, header->p_len);
+}
 
-  // Load the ranges
-  if (!LoadRange(x_range_, x_range_len_, data_fd))
-    goto abort_load;
-  if (!LoadRange(y_range_, y_range_len_, data_fd))
-    goto abort_load;
-  if (!LoadRange(p_range_, p_range_len_, data_fd))
-    goto abort_load;
-
-  // Load the error readings themselves
-  err_.reset(new Error[x_range_len_ * y_range_len_ * p_range_len_]);
-  Error tmp;
-  for(unsigned int x = 0; x < x_range_len_; x++) {
-    for(unsigned int y = 0; y < y_range_len_; y++) {
-      for(unsigned int p = 0; p < p_range_len_; p++) {
-        if (!ReadObject(&tmp.x_error, kDoublePackedSize, data_fd) ||
-            !ReadObject(&tmp.y_error, kDoublePackedSize, data_fd)) {
-          goto abort_load;
-        }
-        err_[ErrorIndex(x, y, p)] = tmp;
-      }
+bool NonLinearityFilterInterpreter::ConvertOriginalData(Grid* grid,
+                                                        const char* data,
+                                                        size_t size) {
+  const char* end = data + size;
+  const char* ranges[3];
+  size_t lens[3];
+  for (size_t i = 0; i < arraysize(ranges); i++) {
+    int32_t len;
+    if (static_cast<size_t>(end - data) < kIntPackedSize)
+      return false;
+    memcpy(&len, data, kIntPackedSize);
+    data += kIntPackedSize;
+    if (len <= 0 ||
+        static_cast<size_t>(end - data) / kDoublePackedSize <
+        static_cast<size_t>(len))
+      return false;
+    ranges[i] = data;
+    lens[i] = len;
+    data += len * kDoublePackedSize;
+  }
+  size_t max_cells = (end - data) / (2 * kDoublePackedSize);
+  if (lens[1] > max_cells / lens[0] ||
+      lens[2] > max_cells / (lens[0] * lens[1]))
+    return false;
+  size_t cells = lens[0] * lens[1] * lens[2];
+
+  size_t range_floats = lens[0] + lens[1] + lens[2];
+  grid->converted.reset(new float[range_floats + 2 * cells]);
+  float* out = grid->converted.get();
+  for (size_t i = 0; i < arraysize(ranges); i++)
+    for (size_t j = 0; j < lens[i]; j++) {
+      double val;
+      memcpy(&val, ranges[i] + j * kDoublePackedSize, kDoublePackedSize);
+      *out++ = val;
     }
+  for (size_t i = 0; i < 2 * cells; i++) {
+    double val;
+    memcpy(&val, data + i * kDoublePackedSize, kDoublePackedSize);
+    *out++ = val;
   }
+  return grid->SetPayload(grid->converted.get(), lens[0], lens[1], lens[2]);
+}
 
-  fclose(data_fd);
-  return;
-
-abort_load:
-  x_range_.reset();
-  x_range_len_ = 0;
-  y_range_.reset();
-  y_range_len_ = 0;
-  p_range_.reset();
-  p_range_len_ = 0;
-  err_.reset();
-  fclose(data_fd);
+uint32_t NonLinearityFilterInterpreter::Checksum(const char* data,
+                                                 size_t size) {
+  uint32_t hash = 2166136261u;  // FNV-1a
+  for (size_t i = 0; i < size; i++) {
+    hash ^= static_cast<unsigned char>(data[i]);
+    hash *= 16777619u;
+  }
+  return hash;
 }
 
 void NonLinearityFilterInterpreter::SyncInterpretImpl(HardwareState* hwstate,
                                                       stime_t* timeout) {
-  if (enabled_.val_ && err_.get() && hwstate->finger_cnt == 1) {
-    FingerState* finger = &(hwstate->fingers[0]);
-    if (finger) {
+  if (enabled_.val_ && grid_) {
+    for (size_t i = 0; i < hwstate->finger_cnt; i++) {
+      FingerState* finger = &hwstate->fingers[i];
       Error error = GetError(finger->position_x, finger->position_y,
                              finger->pressure);
       finger->position_x -= error.x_error;
@@ -124,82 +258,39 @@ void NonLinearityFilterInterpreter::SyncInterpretImpl(HardwareState* hwstate,
   next_->SyncInterpret(hwstate, timeout);
 }
 
-NonLinearityFilterInterpreter::Error
-NonLinearityFilterInterpreter::LinearInterpolate(const Error& p1,
-                                                 const Error& p2,
-                                                 float percent_p1) const {
-  Error ret;
-  ret.x_error = percent_p1 * p1.x_error + (1.0 - percent_p1) * p2.x_error;
-  ret.y_error = percent_p1 * p1.y_error + (1.0 - percent_p1) * p2.y_error;
-  return ret;
-}
-
 NonLinearityFilterInterpreter::Error
 NonLinearityFilterInterpreter::GetError(float finger_x, float finger_y,
                                         float finger_p) const {
-  // First, find the 6 values surrounding the point to interpolate over
-  Bounds x_bounds = FindBounds(finger_x, x_range_, x_range_len_);
-  Bounds y_bounds = FindBounds(finger_y, y_range_, y_range_len_);
-  Bounds p_bounds = FindBounds(finger_p, p_range_, p_range_len_);
-
-  if (x_bounds.lo == -1 || x_bounds.hi == -1 || y_bounds.lo == -1 ||
-    y_bounds.hi == -1 || p_bounds.lo == -1 || p_bounds.hi == -1) {
-    Error error = { 0, 0 };
+  const Grid& grid = *grid_;
+  Error error = { 0, 0 };
+  // First, find the cell of the grid holding the point
+  size_t x, y, p;
+  float x_frac, y_frac, p_frac;
+  if (!grid.x.Find(finger_x, &x, &x_frac) ||
+      !grid.y.Find(finger_y, &y, &y_frac) ||
+      !grid.p.Find(finger_p, &p, &p_frac))
     return error;
-  }
-
-  // Interpolate along the x-axis
-  float x_hi_perc = (finger_x - x_range_[x_bounds.lo]) /
-                    (x_range_[x_bounds.hi] - x_range_[x_bounds.lo]);
-  Error e_yhi_phi = LinearInterpolate(
-                        err_[ErrorIndex(x_bounds.hi, y_bounds.hi, p_bounds.hi)],
-                        err_[ErrorIndex(x_bounds.lo, y_bounds.hi, p_bounds.hi)],
-                        x_hi_perc);
-  Error e_yhi_plo = LinearInterpolate(
-                        err_[ErrorIndex(x_bounds.hi, y_bounds.hi, p_bounds.lo)],
-                        err_[ErrorIndex(x_bounds.lo, y_bounds.hi, p_bounds.lo)],
-                        x_hi_perc);
-  Error e_ylo_phi = LinearInterpolate(
-                        err_[ErrorIndex(x_bounds.hi, y_bounds.lo, p_bounds.hi)],
-                        err_[ErrorIndex(x_bounds.lo, y_bounds.lo, p_bounds.hi)],
-                        x_hi_perc);
-  Error e_ylo_plo = LinearInterpolate(
-                        err_[ErrorIndex(x_bounds.hi, y_bounds.lo, p_bounds.lo)],
-                        err_[ErrorIndex(x_bounds.lo, y_bounds.lo, p_bounds.lo)],
-                        x_hi_perc);
-
-  // Interpolate along the y-axis
-  float y_hi_perc = (finger_y - y_range_[y_bounds.lo]) /
-                    (y_range_[y_bounds.hi] - y_range_[y_bounds.lo]);
-  Error e_plo = LinearInterpolate(e_yhi_plo, e_ylo_plo, y_hi_perc);
-  Error e_phi = LinearInterpolate(e_yhi_phi, e_ylo_phi, y_hi_perc);
-
-  // Finally, interpolate along the p-axis
-  float p_hi_perc = (finger_p - p_range_[p_bounds.lo]) /
-                    (p_range_[p_bounds.hi] - p_range_[p_bounds.lo]);
-  Error error = LinearInterpolate(e_phi, e_plo, p_hi_perc);
 
-  return error;
-}
-
-NonLinearityFilterInterpreter::Bounds
-NonLinearityFilterInterpreter::FindBounds(
-    float value,
-    const std::unique_ptr<double[]>& range,
-    size_t len) const {
-  Bounds bounds;
-  bounds.lo = bounds.hi = -1;
-
-  for (size_t i = 0; i < len; i++) {
-    if (range[i] <= value) {
-      bounds.lo = i;
-    } else {
-      bounds.hi = i;
-      break;
-    }
+  // Then interpolate over the three axes at once, weighting each corner of
+  // the cell by how close the point is to it.
+  const double x_weights[] = { 1.0 - x_frac, x_frac };
+  const double y_weights[] = { 1.0 - y_frac, y_frac };
+  const double p_weights[] = { 1.0 - p_frac, p_frac };
+  double weights[8];
+  for (size_t i = 0; i < arraysize(weights); i++)
+    weights[i] = x_weights[i >> 2] * y_weights[(i >> 1) & 1] *
+        p_weights[i & 1];
+  const Error* corner = &grid.err[grid.ErrorIndex(x, y, p)];
+  double x_error = 0.0;
+  double y_error = 0.0;
+  for (size_t i = 0; i < arraysize(weights); i++) {
+    const Error& sample = corner[grid.corner_offsets[i]];
+    x_error += weights[i] * sample.x_error;
+    y_error += weights[i] * sample.y_error;
   }
-
-  return bounds;
+  error.x_error = x_error;
+  error.y_error = y_error;
+  return error;
 }
 
 }  // namespace gestures
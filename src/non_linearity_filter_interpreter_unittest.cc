@@ -2,15 +2,26 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <string>
+
 #include <gtest/gtest.h>
 
+#include "gestures/include/file_util.h"
 #include "gestures/include/gestures.h"
 #include "gestures/include/non_linearity_filter_interpreter.h"
 #include "gestures/include/unittest_util.h"
 #include "gestures/include/util.h"
 
+using std::string;
+
 const char kTestNonlinearData[] =
     "data/non_linearity_data/testing_non_linearity_data.dat";
+// The same data, compiled by tools/convert_non_linearity_data.py
+const char kTestCompiledNonlinearData[] =
+    "data/non_linearity_data/testing_non_linearity_data.bin";
 
 namespace gestures {
 
@@ -24,6 +35,53 @@ class NonLinearityFilterInterpreterTestInterpreter : public Interpreter {
   virtual void SyncInterpret(HardwareState* hwstate, stime_t* timeout) {}
 };
 
+TEST(NonLinearityFilterInterpreterTest, AxisFindTest) {
+  const float kUniform[] = { -1.0, 0.0, 1.0, 2.0, 3.0 };
+  const float kUneven[] = { 0.0, 0.1, 0.5, 2.0 };
+  const float kDecreasing[] = { 0.0, 2.0, 1.0 };
+  NonLinearityFilterInterpreter::Axis uniform, uneven, decreasing;
+  uniform.points = kUniform;
+  uniform.len = arraysize(kUniform);
+  uneven.points = kUneven;
+  uneven.len = arraysize(kUneven);
+  decreasing.points = kDecreasing;
+  decreasing.len = arraysize(kDecreasing);
+  EXPECT_TRUE(uniform.Prepare());
+  EXPECT_TRUE(uniform.uniform);
+  EXPECT_TRUE(uneven.Prepare());
+  EXPECT_FALSE(uneven.uniform);
+  EXPECT_FALSE(decreasing.Prepare());
+
+  struct {
+    NonLinearityFilterInterpreter::Axis* axis;
+    float value;
+    bool found;
+    size_t lo;
+    float frac;
+  } records[] = {
+    { &uniform, -1.5, false, 0, 0.0 },
+    { &uniform, -1.0, true, 0, 0.0 },
+    { &uniform, 0.25, true, 1, 0.25 },
+    { &uniform, 1.0, true, 2, 0.0 },
+    { &uniform, 2.999, true, 3, 0.999 },
+    { &uniform, 3.0, false, 0, 0.0 },
+    { &uneven, 0.05, true, 0, 0.5 },
+    { &uneven, 0.5, true, 2, 0.0 },
+    { &uneven, 1.25, true, 2, 0.5 },
+    { &uneven, 2.5, false, 0, 0.0 },
+  };
+  for (size_t i = 0; i < arraysize(records); i++) {
+    size_t lo = 0;
+    float frac = 0.0;
+    EXPECT_EQ(records[i].found,
+              records[i].axis->Find(records[i].value, &lo, &frac)) << "i=" << i;
+    if (!records[i].found)
+      continue;
+    EXPECT_EQ(records[i].lo, lo) << "i=" << i;
+    EXPECT_NEAR(records[i].frac, frac, 1e-5) << "i=" << i;
+  }
+}
+
 TEST(NonLinearityFilterInterpreterTest, DisablingTest) {
   FingerState finger_state = { 0, 0, 0, 0, 35, 0, 999, 500, 1, 0 };
   HardwareState hwstate = { 200000, 0, 2, 2, &finger_state, 0, 0, 0, 0 };
@@ -91,12 +149,13 @@ TEST(NonLinearityFilterInterpreterTest, HWstateNoChangesNeededTest) {
   interpreter.data_location_.val_ = kTestNonlinearData;
   interpreter.LoadData();
 
-  // Nothing should change since 2 fingers are on the touchpad
+  // Each finger is corrected on its own; the second has errors of
+  // (0.285, -0.285)
   EXPECT_EQ(NULL, wrapper.SyncInterpret(&hwstates[0], NULL));
   EXPECT_FLOAT_EQ(hwstates[0].fingers[0].position_x, 0.5);
   EXPECT_FLOAT_EQ(hwstates[0].fingers[0].position_y, 0.5);
-  EXPECT_FLOAT_EQ(hwstates[0].fingers[1].position_x, 0.78);
-  EXPECT_FLOAT_EQ(hwstates[0].fingers[1].position_y, 0.34);
+  EXPECT_FLOAT_EQ(hwstates[0].fingers[1].position_x, 0.78 - 0.285);
+  EXPECT_FLOAT_EQ(hwstates[0].fingers[1].position_y, 0.34 + 0.285);
 
   // This finger is at (0.5, 0.5, 0.5) which has 0 error in the test readings
   EXPECT_EQ(NULL, wrapper.SyncInterpret(&hwstates[1], NULL));
@@ -104,4 +163,80 @@ TEST(NonLinearityFilterInterpreterTest, HWstateNoChangesNeededTest) {
   EXPECT_FLOAT_EQ(hwstates[1].fingers[0].position_y, 0.5);
 }
 
+TEST(NonLinearityFilterInterpreterTest, SharedGridTest) {
+  SharedResources resources;
+  NonLinearityFilterInterpreter first(
+      NULL, new NonLinearityFilterInterpreterTestInterpreter, NULL,
+      &resources);
+  NonLinearityFilterInterpreter second(
+      NULL, new NonLinearityFilterInterpreterTestInterpreter, NULL,
+      &resources);
+  EXPECT_FALSE(first.grid_);
+  first.data_location_.val_ = kTestNonlinearData;
+  first.LoadData();
+  second.data_location_.val_ = kTestNonlinearData;
+  second.LoadData();
+  ASSERT_TRUE(first.grid_);
+  EXPECT_EQ(first.grid_.get(), second.grid_.get());
+  EXPECT_EQ(1, resources.size());
+
+  // Without SharedResources, each instance has its own copy.
+  NonLinearityFilterInterpreter third(
+      NULL, new NonLinearityFilterInterpreterTestInterpreter, NULL);
+  third.data_location_.val_ = kTestNonlinearData;
+  third.LoadData();
+  ASSERT_TRUE(third.grid_);
+  EXPECT_NE(first.grid_.get(), third.grid_.get());
+}
+
+TEST(NonLinearityFilterInterpreterTest, CompiledDataTest) {
+  NonLinearityFilterInterpreter interpreter(
+      NULL, new NonLinearityFilterInterpreterTestInterpreter, NULL);
+  TestInterpreterWrapper wrapper(&interpreter);
+  interpreter.enabled_.val_ = 1;
+  interpreter.data_location_.val_ = kTestCompiledNonlinearData;
+  interpreter.LoadData();
+  ASSERT_TRUE(interpreter.grid_);
+  // Used in place
+  EXPECT_TRUE(interpreter.grid_->mapped);
+  EXPECT_FALSE(interpreter.grid_->converted);
+
+  // Corrections match those from the original file.
+  FingerState finger_state = { 0, 0, 0, 0, 0.2, 0, 0.1, 0.3, 1, 0 };
+  HardwareState hwstate = { 200000, 0, 1, 1, &finger_state, 0, 0, 0, 0 };
+  EXPECT_EQ(NULL, wrapper.SyncInterpret(&hwstate, NULL));
+  EXPECT_FLOAT_EQ(0.1 - 0.325, hwstate.fingers[0].position_x);
+  EXPECT_FLOAT_EQ(0.3 + 0.325, hwstate.fingers[0].position_y);
+
+  interpreter.data_location_.val_ = kTestNonlinearData;
+  interpreter.LoadData();
+  ASSERT_TRUE(interpreter.grid_);
+  EXPECT_FALSE(interpreter.grid_->mapped);
+  EXPECT_TRUE(interpreter.grid_->converted);
+
+  string contents;
+  ASSERT_TRUE(ReadFileToString(kTestCompiledNonlinearData, &contents));
+  string bad_files[] = {
+    contents.substr(0, contents.size() - 1),  // truncated
+    contents,
+    contents,
+  };
+  // A bit flipped in the payload fails the checksum.
+  bad_files[1][contents.size() - 1] ^= 1;
+  // Unknown version
+  bad_files[2][4] = 2;
+  for (size_t i = 0; i < arraysize(bad_files); i++) {
+    char path[] = "/tmp/non_linearity_filter_interpreter_unittest_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    close(fd);
+    ASSERT_EQ(static_cast<int>(bad_files[i].size()),
+              WriteFile(path, bad_files[i].data(), bad_files[i].size()));
+    interpreter.data_location_.val_ = path;
+    interpreter.LoadData();
+    EXPECT_FALSE(interpreter.grid_) << "file " << i;
+    unlink(path);
+  }
+}
+
 }  // namespace gestures
@@ -132,7 +132,8 @@ bool PalmClassifyingFilterInterpreter::FingerNearOtherFinger(
     bool close_enough_together =
         metrics_->CloseEnoughToGesture(Vector2(fs), Vector2(other_fs)) &&
         !SetContainsValue(palm_, other_fs.tracking_id);
-    bool too_close_together = DistSq(fs, other_fs) <
+    bool too_close_together =
+        geometry_->DistSq(hwstate, finger_idx, i) <
         palm_split_max_distance_.val_ * palm_split_max_distance_.val_;
     if (close_enough_together && !too_close_together) {
       was_near_other_fingers_.insert(fs.tracking_id);
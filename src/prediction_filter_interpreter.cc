@@ -0,0 +1,105 @@
+// Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "gestures/include/prediction_filter_interpreter.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+#include "gestures/include/util.h"
+
+namespace gestures {
+
+PredictionFilterInterpreter::PredictionFilterInterpreter(
+    PropRegistry* prop_reg, Interpreter* next, Tracer* tracer)
+    : FilterInterpreter(NULL, next, tracer, false),
+      enabled_(prop_reg, "Prediction Enable", false),
+      horizon_(prop_reg, "Prediction Horizon", 0.016),
+      max_lead_(prop_reg, "Prediction Max Lead", 2.0),
+      min_speed_(prop_reg, "Prediction Min Speed", 20.0),
+      alpha_(prop_reg, "Prediction Alpha", 0.6),
+      beta_(prop_reg, "Prediction Beta", 0.3),
+      max_interval_(prop_reg, "Prediction Max Interval", 0.05) {
+  InitName();
+}
+
+void PredictionFilterInterpreter::SyncInterpretImpl(HardwareState* hwstate,
+                                                    stime_t* timeout) {
+  if (!enabled_.val_) {
+    predictions_.clear();
+    next_->SyncInterpret(hwstate, timeout);
+    return;
+  }
+  RemoveMissingIdsFromMap(&predictions_, *hwstate);
+  for (size_t i = 0; i < hwstate->finger_cnt; i++) {
+    FingerState* fs = &hwstate->fingers[i];
+    if (!MapContainsKey(predictions_, fs->tracking_id)) {
+      ResetFinger(*fs, hwstate->timestamp, &predictions_[fs->tracking_id]);
+      continue;
+    }
+    PredictFinger(hwstate->timestamp, fs, &predictions_[fs->tracking_id]);
+  }
+  next_->SyncInterpret(hwstate, timeout);
+}
+
+// static
+void PredictionFilterInterpreter::ResetFinger(const FingerState& fs,
+                                              stime_t timestamp,
+                                              FingerPrediction* pred) {
+  pred->timestamp = timestamp;
+  pred->measured = pred->position = Vector2(fs);
+  pred->velocity = pred->lead = Vector2();
+}
+
+void PredictionFilterInterpreter::PredictFinger(stime_t timestamp,
+                                                FingerState* fs,
+                                                FingerPrediction* pred) {
+  stime_t dt = timestamp - pred->timestamp;
+  if (dt <= 0.0 || dt > max_interval_.val_ ||
+      fs->flags & (GESTURES_FINGER_WARP_X | GESTURES_FINGER_WARP_Y)) {
+    // Start over from the measured position. Dropping the lead is a jump,
+    // not movement.
+    if (pred->lead.x != 0.0)
+      fs->flags |= GESTURES_FINGER_WARP_X;
+    if (pred->lead.y != 0.0)
+      fs->flags |= GESTURES_FINGER_WARP_Y;
+    ResetFinger(*fs, timestamp, pred);
+    return;
+  }
+  Vector2 measured(*fs);
+  Vector2 predicted(pred->position.x + pred->velocity.x * dt,
+                    pred->position.y + pred->velocity.y * dt);
+  Vector2 residual = measured.Sub(predicted);
+  pred->position = Vector2(predicted.x + alpha_.val_ * residual.x,
+                           predicted.y + alpha_.val_ * residual.y);
+  pred->velocity = Vector2(pred->velocity.x + beta_.val_ * residual.x / dt,
+                           pred->velocity.y + beta_.val_ * residual.y / dt);
+
+  Vector2 lead;
+  float speed = pred->velocity.Mag();
+  if (speed >= min_speed_.val_ && speed > 0.0) {
+    float length = std::min(speed * horizon_.val_, max_lead_.val_);
+    lead = Vector2(pred->velocity.x * length / speed,
+                   pred->velocity.y * length / speed);
+  }
+
+  // Don't let a correction move the output back against the finger.
+  Vector2 moved = measured.Sub(pred->measured);
+  Vector2 output_moved = moved.Add(lead.Sub(pred->lead));
+  if (output_moved.x * moved.x < 0.0 ||
+      (moved.x == 0.0 && output_moved.x != 0.0))
+    fs->flags |= GESTURES_FINGER_WARP_X;
+  if (output_moved.y * moved.y < 0.0 ||
+      (moved.y == 0.0 && output_moved.y != 0.0))
+    fs->flags |= GESTURES_FINGER_WARP_Y;
+
+  pred->timestamp = timestamp;
+  pred->measured = measured;
+  pred->lead = lead;
+  fs->position_x += lead.x;
+  fs->position_y += lead.y;
+}
+
+}  // namespace gestures
@@ -0,0 +1,113 @@
+// Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include "gestures/include/gestures.h"
+#include "gestures/include/prediction_filter_interpreter.h"
+#include "gestures/include/unittest_util.h"
+
+namespace gestures {
+
+class PredictionFilterInterpreterTest : public ::testing::Test {};
+
+class PredictionFilterInterpreterTestInterpreter : public Interpreter {
+ public:
+  PredictionFilterInterpreterTestInterpreter()
+      : Interpreter(NULL, NULL, false) {}
+
+  virtual void SyncInterpret(HardwareState* hwstate, stime_t* timeout) {
+    ASSERT_EQ(1, hwstate->finger_cnt);
+    prev_ = hwstate->fingers[0];
+  }
+
+  FingerState prev_;
+};
+
+namespace {
+HardwareProperties hwprops = {
+  0, 0, 100, 100,  // left, top, right, bottom
+  1, 1,  // x res (pixels/mm), y res (pixels/mm)
+  1, 1,  // scrn DPI X, Y
+  0, 0,  // orientation minimum, maximum
+  2, 5,  // max fingers, max_touch
+  0, 0, 1, 0  // t5r2, semi, button pad, has_wheel
+};
+
+const unsigned kWarpFlags = GESTURES_FINGER_WARP_X | GESTURES_FINGER_WARP_Y;
+}  // namespace {}
+
+TEST(PredictionFilterInterpreterTest, ConstantVelocityTest) {
+  PredictionFilterInterpreterTestInterpreter* base_interpreter =
+      new PredictionFilterInterpreterTestInterpreter;
+  PredictionFilterInterpreter interpreter(NULL, base_interpreter, NULL);
+  TestInterpreterWrapper wrapper(&interpreter, &hwprops);
+
+  // Off by default
+  FingerState fs = { 0, 0, 0, 0, 50, 0, 10.0, 20.0, 1, 0 };
+  HardwareState hs = { 0.0, 0, 1, 1, &fs, 0, 0, 0, 0 };
+  for (size_t i = 0; i < 5; i++) {
+    fs.position_x = 10.0 + i;
+    fs.flags = 0;
+    hs.timestamp = 0.01 * i;
+    wrapper.SyncInterpret(&hs, NULL);
+    EXPECT_FLOAT_EQ(10.0 + i, base_interpreter->prev_.position_x);
+  }
+
+  interpreter.enabled_.val_ = true;
+  interpreter.horizon_.val_ = 0.016;
+  interpreter.max_lead_.val_ = 2.0;
+  // 100 mm/s to the right
+  float prev_out_x = 0.0;
+  for (size_t i = 0; i < 40; i++) {
+    fs.position_x = 20.0 + i;
+    fs.position_y = 20.0;
+    fs.flags = 0;
+    hs.timestamp = 1.0 + 0.01 * i;
+    wrapper.SyncInterpret(&hs, NULL);
+    const FingerState& out = base_interpreter->prev_;
+    EXPECT_FLOAT_EQ(20.0, out.position_y) << "i=" << i;
+    EXPECT_EQ(0U, out.flags & kWarpFlags) << "i=" << i;
+    if (i > 0) {
+      EXPECT_GT(out.position_x, prev_out_x) << "i=" << i;
+    }
+    prev_out_x = out.position_x;
+  }
+  EXPECT_NEAR(100.0, interpreter.predictions_[1].velocity.x, 0.1);
+  EXPECT_NEAR(20.0 + 39 + 1.6, prev_out_x, 0.01);
+
+  // The lead is limited.
+  interpreter.horizon_.val_ = 0.1;
+  fs.position_x = 60.0;
+  fs.flags = 0;
+  hs.timestamp = 1.4;
+  wrapper.SyncInterpret(&hs, NULL);
+  EXPECT_NEAR(62.0, base_interpreter->prev_.position_x, 0.001);
+  prev_out_x = base_interpreter->prev_.position_x;
+
+  // The finger stops. The output never moves back, other than by a warp,
+  // and ends up where the finger is.
+  for (size_t i = 0; i < 20; i++) {
+    fs.position_x = 60.0;
+    fs.flags = 0;
+    hs.timestamp = 1.41 + 0.01 * i;
+    wrapper.SyncInterpret(&hs, NULL);
+    const FingerState& out = base_interpreter->prev_;
+    if (!(out.flags & GESTURES_FINGER_WARP_X)) {
+      EXPECT_GE(out.position_x, prev_out_x) << "i=" << i;
+    }
+    prev_out_x = out.position_x;
+  }
+  EXPECT_FLOAT_EQ(60.0, prev_out_x);
+
+  // A gap in the frames starts the finger over.
+  fs.position_x = 70.0;
+  fs.flags = 0;
+  hs.timestamp = 2.0;
+  wrapper.SyncInterpret(&hs, NULL);
+  EXPECT_FLOAT_EQ(70.0, base_interpreter->prev_.position_x);
+  EXPECT_FLOAT_EQ(0.0, interpreter.predictions_[1].velocity.x);
+}
+
+}  // namespace gestures
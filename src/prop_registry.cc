@@ -4,6 +4,7 @@
 
 #include "gestures/include/prop_registry.h"
 
+#include <algorithm>
 #include <set>
 #include <string>
 
@@ -17,69 +18,322 @@ using std::string;
 
 namespace gestures {
 
+size_t PropRegistry::NameHash::operator()(const char* name) const {
+  // FNV-1a
+  size_t ret = 2166136261u;
+  for (; *name; ++name) {
+    ret ^= static_cast<unsigned char>(*name);
+    ret *= 16777619u;
+  }
+  return ret;
+}
+
 void PropRegistry::Register(Property* prop) {
-  props_.insert(prop);
-  if (prop_provider_)
-    prop->CreateProp();
+  props_.push_back(prop);
+  by_name_.insert(std::make_pair(prop->name(), prop));
+  if (has_provider() && !holding_creation_)
+    CreateProps(&prop, 1);
 }
 
 void PropRegistry::Unregister(Property* prop) {
-  if (props_.erase(prop) != 1)
+  std::vector<Property*>::iterator it =
+      std::find(props_.begin(), props_.end(), prop);
+  if (it == props_.end()) {
     Err("Unregister failed?");
-  if (prop_provider_)
-    prop->DestroyProp();
+  } else {
+    props_.erase(it);
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      if (prop->dirty_) {
+        written_.erase(std::find(written_.begin(), written_.end(), prop));
+        prop->dirty_ = false;
+      }
+    }
+    NameMap::iterator named = by_name_.find(prop->name());
+    if (named != by_name_.end() && named->second == prop) {
+      by_name_.erase(named);
+      // Let the next one of the same name, if any, take over.
+      for (it = props_.begin(); it != props_.end(); ++it) {
+        if (strcmp((*it)->name(), prop->name()) == 0) {
+          by_name_.insert(std::make_pair((*it)->name(), *it));
+          break;
+        }
+      }
+    }
+  }
+  if (has_provider() && prop->created_)
+    DestroyProps(&prop, 1);
+}
+
+Property* PropRegistry::GetProperty(const char* name) const {
+  NameMap::const_iterator it = by_name_.find(name);
+  return it == by_name_.end() ? NULL : it->second;
 }
 
 void PropRegistry::SetPropProvider(GesturesPropProvider* prop_provider,
                                    void* data) {
-  if (prop_provider_ == prop_provider)
+  ReplaceProvider(prop_provider, NULL, data);
+}
+
+void PropRegistry::SetBulkPropProvider(GesturesBulkPropProvider* bulk_provider,
+                                       void* data) {
+  ReplaceProvider(NULL, bulk_provider, data);
+}
+
+void PropRegistry::ReplaceProvider(GesturesPropProvider* prop_provider,
+                                   GesturesBulkPropProvider* bulk_provider,
+                                   void* data) {
+  if (prop_provider_ == prop_provider && bulk_provider_ == bulk_provider)
     return;
-  if (prop_provider_) {
-    for (std::set<Property*>::iterator it = props_.begin(), e= props_.end();
-         it != e; ++it)
-      (*it)->DestroyProp();
+  {
+    // Staged values belong to the old provider's properties.
+    std::lock_guard<std::mutex> lock(lock_);
+    for (size_t i = 0; i < written_.size(); i++)
+      written_[i]->dirty_ = false;
+    written_.clear();
+    ready_ = false;
+  }
+  if (has_provider()) {
+    std::vector<Property*> created;
+    for (size_t i = 0; i < props_.size(); i++)
+      if (props_[i]->created_)
+        created.push_back(props_[i]);
+    if (!created.empty())
+      DestroyProps(&created[0], created.size());
   }
   prop_provider_ = prop_provider;
+  bulk_provider_ = bulk_provider;
   prop_provider_data_ = data;
-  if (prop_provider_)
-    for (std::set<Property*>::iterator it = props_.begin(), e= props_.end();
-         it != e; ++it)
-      (*it)->CreateProp();
-}
-
-void Property::CreateProp() {
-  if (gprop_)
-    Err("Property already created");
-  CreatePropImpl();
-  if (parent_) {
-    parent_->PropProvider()->register_handlers_fn(
-        parent_->PropProviderData(),
-        gprop_,
-        this,
-        &StaticHandleGesturesPropWillRead,
-        &StaticHandleGesturesPropWritten);
+  if (!holding_creation_)
+    CreateUncreatedProps();
+}
+
+void PropRegistry::HoldCreation() {
+  holding_creation_ = true;
+}
+
+void PropRegistry::CreateHeldProps() {
+  holding_creation_ = false;
+  CreateUncreatedProps();
+}
+
+void PropRegistry::CreateUncreatedProps() {
+  if (!has_provider())
+    return;
+  std::vector<Property*> uncreated;
+  for (size_t i = 0; i < props_.size(); i++)
+    if (!props_[i]->created_)
+      uncreated.push_back(props_[i]);
+  if (!uncreated.empty())
+    CreateProps(&uncreated[0], uncreated.size());
+}
+
+void PropRegistry::CreateProps(Property* const* props, size_t count) {
+  std::vector<GesturesPropDesc> descs(count);
+  // Each one's value from before the provider could configure it, back to
+  // back.
+  string orig;
+  for (size_t i = 0; i < count; i++) {
+    Property* prop = props[i];
+    if (prop->gprop_)
+      Err("Property already created");
+    prop->Describe(&descs[i]);
+    descs[i].name = prop->name();
+    descs[i].handler_data = prop;
+    orig.append(static_cast<const char*>(prop->val_loc_), prop->val_size_);
+  }
+  std::vector<GesturesProp*> gprops(count, NULL);
+  if (bulk_provider_) {
+    bulk_provider_->create_fn(prop_provider_data_, &descs[0], count,
+                              &gprops[0],
+                              &Property::StaticHandleGesturesPropsWritten);
+  } else {
+    for (size_t i = 0; i < count; i++) {
+      gprops[i] = CreateWithPropProvider(descs[i]);
+      prop_provider_->register_handlers_fn(
+          prop_provider_data_,
+          gprops[i],
+          props[i],
+          &Property::StaticHandleGesturesPropWillRead,
+          &Property::StaticHandleGesturesPropWritten);
+    }
+  }
+  size_t offset = 0;
+  for (size_t i = 0; i < count; i++) {
+    Property* prop = props[i];
+    prop->gprop_ = gprops[i];
+    prop->created_ = true;
+    prop->TakeCreatedValue();
+    if (prop->delegate_ && prop->ValueDiffers(orig.data() + offset))
+      prop->NotifyDelegate();
+    offset += prop->val_size_;
   }
 }
 
-void Property::DestroyProp() {
-  if (!gprop_) {
-    Err("gprop_ already freed!");
+GesturesProp* PropRegistry::CreateWithPropProvider(
+    const GesturesPropDesc& desc) {
+  switch (desc.type) {
+    case GESTURES_PROP_INT:
+      return prop_provider_->create_int_fn(
+          prop_provider_data_, desc.name, static_cast<int*>(desc.loc),
+          desc.count, static_cast<const int*>(desc.init));
+    case GESTURES_PROP_SHORT:
+      return prop_provider_->create_short_fn(
+          prop_provider_data_, desc.name, static_cast<short*>(desc.loc),
+          desc.count, static_cast<const short*>(desc.init));
+    case GESTURES_PROP_BOOL:
+      return prop_provider_->create_bool_fn(
+          prop_provider_data_, desc.name,
+          static_cast<GesturesPropBool*>(desc.loc), desc.count,
+          static_cast<const GesturesPropBool*>(desc.init));
+    case GESTURES_PROP_STRING:
+      return prop_provider_->create_string_fn(
+          prop_provider_data_, desc.name, static_cast<const char**>(desc.loc),
+          static_cast<const char*>(desc.init));
+    case GESTURES_PROP_REAL:
+      return prop_provider_->create_real_fn(
+          prop_provider_data_, desc.name, static_cast<double*>(desc.loc),
+          desc.count, static_cast<const double*>(desc.init));
+  }
+  Err("Unknown property type %d", desc.type);
+  return NULL;
+}
+
+void PropRegistry::DestroyProps(Property* const* props, size_t count) {
+  std::vector<GesturesProp*> gprops;
+  for (size_t i = 0; i < count; i++) {
+    Property* prop = props[i];
+    prop->created_ = false;
+    if (!prop->gprop_) {
+      Err("gprop_ already freed!");
+      continue;
+    }
+    gprops.push_back(prop->gprop_);
+    prop->gprop_ = NULL;
+  }
+  if (gprops.empty())
+    return;
+  if (bulk_provider_) {
+    bulk_provider_->free_fn(prop_provider_data_, &gprops[0], gprops.size());
     return;
   }
-  parent_->PropProvider()->free_fn(parent_->PropProviderData(), gprop_);
-  gprop_ = NULL;
-}
-
-void BoolProperty::CreatePropImpl() {
-  GesturesPropBool orig_val = val_;
-  gprop_ = parent_->PropProvider()->create_bool_fn(
-      parent_->PropProviderData(),
-      name(),
-      &val_,
-      1,
-      &val_);
-  if (delegate_ && orig_val != val_)
-    delegate_->BoolWasWritten(this);
+  for (size_t i = 0; i < gprops.size(); i++)
+    prop_provider_->free_fn(prop_provider_data_, gprops[i]);
+}
+
+void PropRegistry::SetDeferred(bool deferred) {
+  if (has_provider()) {
+    Err("Deferred writes must be set up before the prop provider");
+    return;
+  }
+  deferred_ = deferred;
+}
+
+void PropRegistry::BeginUpdate() {
+  std::lock_guard<std::mutex> lock(lock_);
+  holds_++;
+  ready_ = false;
+}
+
+void PropRegistry::EndUpdate() {
+  std::lock_guard<std::mutex> lock(lock_);
+  if (holds_ <= 0) {
+    Err("EndUpdate() without BeginUpdate()");
+    return;
+  }
+  holds_--;
+  if (!holds_ && !written_.empty())
+    ready_.store(true, std::memory_order_release);
+}
+
+void PropRegistry::Stage(Property* prop) {
+  std::lock_guard<std::mutex> lock(lock_);
+  memcpy(prop->pending_.get(), prop->staged_.get(), prop->val_size_);
+  if (!prop->dirty_) {
+    prop->dirty_ = true;
+    written_.push_back(prop);
+  }
+  if (!holds_)
+    ready_.store(true, std::memory_order_release);
+}
+
+void PropRegistry::Commit() {
+  if (!ready_.load(std::memory_order_acquire))
+    return;
+  std::vector<Property*> written;
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    if (holds_)
+      return;
+    ready_ = false;
+    written.swap(written_);
+    for (size_t i = 0; i < written.size(); i++) {
+      Property* prop = written[i];
+      memcpy(prop->val_loc_, prop->pending_.get(), prop->val_size_);
+      prop->dirty_ = false;
+    }
+  }
+  if (written.empty())
+    return;
+  epoch_++;
+  for (size_t i = 0; i < written.size(); i++)
+    written[i]->HandleGesturesPropWritten();
+}
+
+void Property::StaticHandleGesturesPropWritten(void* data) {
+  Property* prop = reinterpret_cast<Property*>(data);
+  if (prop->staged_.get())
+    prop->parent_->Stage(prop);
+  else
+    prop->HandleGesturesPropWritten();
+}
+
+void Property::StaticHandleGesturesPropsWritten(void* const* data,
+                                                size_t count) {
+  if (!count)
+    return;
+  PropRegistry* parent = reinterpret_cast<Property*>(data[0])->parent_;
+  bool deferred = parent && parent->deferred();
+  if (deferred)
+    parent->BeginUpdate();
+  for (size_t i = 0; i < count; i++)
+    StaticHandleGesturesPropWritten(data[i]);
+  if (deferred)
+    parent->EndUpdate();
+}
+
+bool Property::ValueDiffers(const char* orig) const {
+  return memcmp(orig, val_loc_, val_size_) != 0;
+}
+
+void* Property::ProviderLocation(void* val, size_t size) {
+  val_loc_ = val;
+  val_size_ = size;
+  if (!parent_ || !parent_->deferred()) {
+    staged_.reset();
+    pending_.reset();
+    return val;
+  }
+  staged_.reset(new char[size]);
+  pending_.reset(new char[size]);
+  memcpy(staged_.get(), val, size);
+  return staged_.get();
+}
+
+void Property::TakeCreatedValue() {
+  if (staged_.get())
+    memcpy(val_loc_, staged_.get(), val_size_);
+}
+
+void BoolProperty::Describe(GesturesPropDesc* desc) {
+  desc->type = GESTURES_PROP_BOOL;
+  desc->loc = ProviderLocation(&val_, sizeof(val_));
+  desc->count = 1;
+  desc->init = &val_;
+}
+
+void BoolProperty::NotifyDelegate() {
+  delegate_->BoolWasWritten(this);
 }
 
 Json::Value BoolProperty::NewValue() const {
@@ -106,17 +360,15 @@ void BoolProperty::HandleGesturesPropWritten() {
     delegate_->BoolWasWritten(this);
 }
 
-void BoolArrayProperty::CreatePropImpl() {
-  GesturesPropBool orig_vals[count_];
-  memcpy(orig_vals, vals_, sizeof(orig_vals));
-  gprop_ = parent_->PropProvider()->create_bool_fn(
-      parent_->PropProviderData(),
-      name(),
-      vals_,
-      count_,
-      vals_);
-  if (delegate_ && memcmp(orig_vals, vals_, sizeof(orig_vals)))
-    delegate_->BoolArrayWasWritten(this);
+void BoolArrayProperty::Describe(GesturesPropDesc* desc) {
+  desc->type = GESTURES_PROP_BOOL;
+  desc->loc = ProviderLocation(vals_, count_ * sizeof(*vals_));
+  desc->count = count_;
+  desc->init = vals_;
+}
+
+void BoolArrayProperty::NotifyDelegate() {
+  delegate_->BoolArrayWasWritten(this);
 }
 
 Json::Value BoolArrayProperty::NewValue() const {
@@ -145,16 +397,15 @@ void BoolArrayProperty::HandleGesturesPropWritten() {
     delegate_->BoolArrayWasWritten(this);
 }
 
-void DoubleProperty::CreatePropImpl() {
-  double orig_val = val_;
-  gprop_ = parent_->PropProvider()->create_real_fn(
-      parent_->PropProviderData(),
-      name(),
-      &val_,
-      1,
-      &val_);
-  if (delegate_ && orig_val != val_)
-    delegate_->DoubleWasWritten(this);
+void DoubleProperty::Describe(GesturesPropDesc* desc) {
+  desc->type = GESTURES_PROP_REAL;
+  desc->loc = ProviderLocation(&val_, sizeof(val_));
+  desc->count = 1;
+  desc->init = &val_;
+}
+
+void DoubleProperty::NotifyDelegate() {
+  delegate_->DoubleWasWritten(this);
 }
 
 Json::Value DoubleProperty::NewValue() const {
@@ -183,17 +434,15 @@ void DoubleProperty::HandleGesturesPropWritten() {
     delegate_->DoubleWasWritten(this);
 }
 
-void DoubleArrayProperty::CreatePropImpl() {
-  float orig_vals[count_];
-  memcpy(orig_vals, vals_, sizeof(orig_vals));
-  gprop_ = parent_->PropProvider()->create_real_fn(
-      parent_->PropProviderData(),
-      name(),
-      vals_,
-      count_,
-      vals_);
-  if (delegate_ && memcmp(orig_vals, vals_, sizeof(orig_vals)))
-    delegate_->DoubleArrayWasWritten(this);
+void DoubleArrayProperty::Describe(GesturesPropDesc* desc) {
+  desc->type = GESTURES_PROP_REAL;
+  desc->loc = ProviderLocation(vals_, count_ * sizeof(*vals_));
+  desc->count = count_;
+  desc->init = vals_;
+}
+
+void DoubleArrayProperty::NotifyDelegate() {
+  delegate_->DoubleArrayWasWritten(this);
 }
 
 Json::Value DoubleArrayProperty::NewValue() const {
@@ -227,16 +476,15 @@ void DoubleArrayProperty::HandleGesturesPropWritten() {
     delegate_->DoubleArrayWasWritten(this);
 }
 
-void IntProperty::CreatePropImpl() {
-  int orig_val = val_;
-  gprop_ = parent_->PropProvider()->create_int_fn(
-      parent_->PropProviderData(),
-      name(),
-      &val_,
-      1,
-      &val_);
-  if (delegate_ && orig_val != val_)
-    delegate_->IntWasWritten(this);
+void IntProperty::Describe(GesturesPropDesc* desc) {
+  desc->type = GESTURES_PROP_INT;
+  desc->loc = ProviderLocation(&val_, sizeof(val_));
+  desc->count = 1;
+  desc->init = &val_;
+}
+
+void IntProperty::NotifyDelegate() {
+  delegate_->IntWasWritten(this);
 }
 
 Json::Value IntProperty::NewValue() const {
@@ -265,17 +513,15 @@ void IntProperty::HandleGesturesPropWritten() {
     delegate_->IntWasWritten(this);
 }
 
-void IntArrayProperty::CreatePropImpl() {
-  int orig_vals[count_];
-  memcpy(orig_vals, vals_, sizeof(orig_vals));
-  gprop_ = parent_->PropProvider()->create_int_fn(
-      parent_->PropProviderData(),
-      name(),
-      vals_,
-      count_,
-      vals_);
-  if (delegate_ && memcmp(orig_vals, vals_, sizeof(orig_vals)))
-    delegate_->IntArrayWasWritten(this);
+void IntArrayProperty::Describe(GesturesPropDesc* desc) {
+  desc->type = GESTURES_PROP_INT;
+  desc->loc = ProviderLocation(vals_, count_ * sizeof(*vals_));
+  desc->count = count_;
+  desc->init = vals_;
+}
+
+void IntArrayProperty::NotifyDelegate() {
+  delegate_->IntArrayWasWritten(this);
 }
 
 Json::Value IntArrayProperty::NewValue() const {
@@ -305,16 +551,15 @@ void IntArrayProperty::HandleGesturesPropWritten() {
     delegate_->IntArrayWasWritten(this);
 }
 
-void ShortProperty::CreatePropImpl() {
-  short orig_val = val_;
-  gprop_ = parent_->PropProvider()->create_short_fn(
-      parent_->PropProviderData(),
-      name(),
-      &val_,
-      1,
-      &val_);
-  if (delegate_ && orig_val != val_)
-    delegate_->ShortWasWritten(this);
+void ShortProperty::Describe(GesturesPropDesc* desc) {
+  desc->type = GESTURES_PROP_SHORT;
+  desc->loc = ProviderLocation(&val_, sizeof(val_));
+  desc->count = 1;
+  desc->init = &val_;
+}
+
+void ShortProperty::NotifyDelegate() {
+  delegate_->ShortWasWritten(this);
 }
 
 Json::Value ShortProperty::NewValue() const {
@@ -342,17 +587,15 @@ void ShortProperty::HandleGesturesPropWritten() {
     delegate_->ShortWasWritten(this);
 }
 
-void ShortArrayProperty::CreatePropImpl() {
-  short orig_vals[count_];
-  memcpy(orig_vals, vals_, sizeof(orig_vals));
-  gprop_ = parent_->PropProvider()->create_short_fn(
-      parent_->PropProviderData(),
-      name(),
-      vals_,
-      count_,
-      vals_);
-  if (delegate_ && memcmp(orig_vals, vals_, sizeof(orig_vals)))
-    delegate_->ShortArrayWasWritten(this);
+void ShortArrayProperty::Describe(GesturesPropDesc* desc) {
+  desc->type = GESTURES_PROP_SHORT;
+  desc->loc = ProviderLocation(vals_, count_ * sizeof(*vals_));
+  desc->count = count_;
+  desc->init = vals_;
+}
+
+void ShortArrayProperty::NotifyDelegate() {
+  delegate_->ShortArrayWasWritten(this);
 }
 
 Json::Value ShortArrayProperty::NewValue() const {
@@ -382,15 +625,21 @@ void ShortArrayProperty::HandleGesturesPropWritten() {
     delegate_->ShortArrayWasWritten(this);
 }
 
-void StringProperty::CreatePropImpl() {
-  const char* orig_val = val_;
-  gprop_ = parent_->PropProvider()->create_string_fn(
-      parent_->PropProviderData(),
-      name(),
-      &val_,
-      val_);
-  if (delegate_ && strcmp(orig_val, val_) == 0)
-    delegate_->StringWasWritten(this);
+void StringProperty::Describe(GesturesPropDesc* desc) {
+  desc->type = GESTURES_PROP_STRING;
+  desc->loc = ProviderLocation(&val_, sizeof(val_));
+  desc->count = 1;
+  desc->init = val_;
+}
+
+bool StringProperty::ValueDiffers(const char* orig) const {
+  const char* orig_val;
+  memcpy(&orig_val, orig, sizeof(orig_val));
+  return strcmp(orig_val, val_) != 0;
+}
+
+void StringProperty::NotifyDelegate() {
+  delegate_->StringWasWritten(this);
 }
 
 Json::Value StringProperty::NewValue() const {
@@ -2,11 +2,14 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <memory>
 #include <string>
+#include <vector>
 
 #include <gtest/gtest.h>
 
 #include "gestures/include/activity_log.h"
+#include "gestures/include/macros.h"
 #include "gestures/include/prop_registry.h"
 
 using std::string;
@@ -195,4 +198,274 @@ TEST(PropRegistryTest, DoublePromoteIntTest) {
   EXPECT_TRUE(my_double.SetValue(my_int_val));
   EXPECT_TRUE(strstr(ValueForProperty(my_double).c_str(), "321"));
 }
+
+TEST(PropRegistryTest, GetPropertyTest) {
+  PropRegistry reg;
+  IntProperty first(&reg, "First", 1);
+  DoubleProperty second(&reg, "Second", 2.0);
+  ASSERT_EQ(2, reg.props().size());
+  EXPECT_EQ(&first, reg.props()[0]);
+  EXPECT_EQ(&second, reg.props()[1]);
+
+  // Lookup is by contents, not by pointer.
+  string name("Second");
+  EXPECT_EQ(&second, reg.GetProperty(name.c_str()));
+  EXPECT_EQ(NULL, reg.GetProperty("Third"));
+
+  {
+    // The first of several with one name wins, and when it goes the next
+    // one takes over.
+    IntProperty* replaced = new IntProperty(&reg, "Replaced", 3);
+    IntProperty replacement(&reg, "Replaced", 4);
+    EXPECT_EQ(replaced, reg.GetProperty("Replaced"));
+    delete replaced;
+    EXPECT_EQ(&replacement, reg.GetProperty("Replaced"));
+    EXPECT_EQ(3, reg.props().size());
+  }
+  EXPECT_EQ(NULL, reg.GetProperty("Replaced"));
+  EXPECT_EQ(2, reg.props().size());
+}
+
+namespace {
+// Remembers where each property lives in the provider, as the provider
+// would, so the test can write to it.
+struct StagingProvider {
+  double* real_loc;
+  int* int_loc;
+  void* real_handler_data;
+  void* int_handler_data;
+};
+
+GesturesProp* StagingCreateInt(void* data, const char* name, int* loc,
+                               size_t count, const int* init) {
+  reinterpret_cast<StagingProvider*>(data)->int_loc = loc;
+  *loc = 7;  // configured value
+  return new GesturesProp();
+}
+
+GesturesProp* StagingCreateReal(void* data, const char* name, double* loc,
+                                size_t count, const double* init) {
+  reinterpret_cast<StagingProvider*>(data)->real_loc = loc;
+  return new GesturesProp();
+}
+
+void StagingRegisterHandlers(void* data, GesturesProp* prop,
+                             void* handler_data,
+                             GesturesPropGetHandler getter,
+                             GesturesPropSetHandler setter) {
+  StagingProvider* provider = reinterpret_cast<StagingProvider*>(data);
+  if (!provider->real_handler_data)
+    provider->real_handler_data = handler_data;
+  else
+    provider->int_handler_data = handler_data;
+}
+}  // namespace {}
+
+TEST(PropRegistryTest, DeferredWritesTest) {
+  GesturesPropProvider staging_provider = {
+    StagingCreateInt,
+    MockGesturesPropCreateShort,
+    MockGesturesPropCreateBool,
+    MockGesturesPropCreateString,
+    StagingCreateReal,
+    StagingRegisterHandlers,
+    MockGesturesPropFree
+  };
+  StagingProvider provider = { NULL, NULL, NULL, NULL };
+
+  PropRegistry reg;
+  PropRegistryTestDelegate delegate;
+  double curve[] = { 1.0, 2.0, 3.0 };
+  DoubleArrayProperty curve_prop(&reg, "Curve", curve, arraysize(curve),
+                                 &delegate);
+  IntProperty int_prop(&reg, "Int", 0, &delegate);
+  reg.SetDeferred(true);
+  reg.SetPropProvider(&staging_provider, &provider);
+  // Values configured at creation apply right away.
+  EXPECT_EQ(7, int_prop.val_);
+  EXPECT_EQ(1, delegate.call_cnt_);
+  ASSERT_TRUE(provider.real_loc);
+  EXPECT_NE(curve, provider.real_loc);
+  EXPECT_EQ(0, reg.epoch());
+
+  // Nothing staged
+  reg.Commit();
+  EXPECT_EQ(0, reg.epoch());
+
+  // Writes are invisible until committed, then applied together.
+  for (size_t i = 0; i < arraysize(curve); i++)
+    provider.real_loc[i] = 10.0 + i;
+  Property::StaticHandleGesturesPropWritten(provider.real_handler_data);
+  *provider.int_loc = 8;
+  Property::StaticHandleGesturesPropWritten(provider.int_handler_data);
+  EXPECT_DOUBLE_EQ(1.0, curve[0]);
+  EXPECT_EQ(7, int_prop.val_);
+  EXPECT_EQ(1, delegate.call_cnt_);
+  reg.Commit();
+  EXPECT_DOUBLE_EQ(10.0, curve[0]);
+  EXPECT_DOUBLE_EQ(12.0, curve[2]);
+  EXPECT_EQ(8, int_prop.val_);
+  // PropRegistryTestDelegate doesn't count array writes.
+  EXPECT_EQ(2, delegate.call_cnt_);
+  EXPECT_EQ(1, reg.epoch());
+
+  // An open update holds writes back.
+  reg.BeginUpdate();
+  *provider.int_loc = 9;
+  Property::StaticHandleGesturesPropWritten(provider.int_handler_data);
+  reg.Commit();
+  EXPECT_EQ(8, int_prop.val_);
+  reg.EndUpdate();
+  reg.Commit();
+  EXPECT_EQ(9, int_prop.val_);
+  EXPECT_EQ(2, reg.epoch());
+
+  reg.SetPropProvider(NULL, NULL);
+}
+
+namespace {
+struct CountingProvider {
+  int created;
+  int freed;
+};
+
+GesturesProp* CountingCreateInt(void* data, const char* name, int* loc,
+                                size_t count, const int* init) {
+  reinterpret_cast<CountingProvider*>(data)->created++;
+  *loc = 7;  // configured value
+  return new GesturesProp();
+}
+
+void CountingFree(void* data, GesturesProp* prop) {
+  reinterpret_cast<CountingProvider*>(data)->freed++;
+  delete prop;
+}
+}  // namespace {}
+
+TEST(PropRegistryTest, HoldCreationTest) {
+  GesturesPropProvider counting_provider = {
+    CountingCreateInt,
+    MockGesturesPropCreateShort,
+    MockGesturesPropCreateBool,
+    MockGesturesPropCreateString,
+    MockGesturesPropCreateReal,
+    MockGesturesPropRegisterHandlers,
+    CountingFree
+  };
+  CountingProvider provider = { 0, 0 };
+
+  PropRegistry reg;
+  reg.SetPropProvider(&counting_provider, &provider);
+  PropRegistryTestDelegate delegate;
+  std::unique_ptr<IntProperty> old_prop(new IntProperty(&reg, "Int", 0));
+  EXPECT_EQ(1, provider.created);
+
+  reg.HoldCreation();
+  // Replaced before the provider ever sees it
+  std::unique_ptr<IntProperty> temp_prop(new IntProperty(&reg, "Temp", 0));
+  temp_prop.reset();
+  IntProperty new_prop(&reg, "Int", 0, &delegate);
+  old_prop.reset();
+  EXPECT_EQ(1, provider.created);
+  EXPECT_EQ(1, provider.freed);
+  EXPECT_EQ(0, new_prop.val_);
+  EXPECT_EQ(0, delegate.call_cnt_);
+
+  reg.CreateHeldProps();
+  EXPECT_EQ(2, provider.created);
+  EXPECT_EQ(7, new_prop.val_);
+  EXPECT_EQ(1, delegate.call_cnt_);
+  // Registered as usual again
+  IntProperty other_prop(&reg, "Other", 0);
+  EXPECT_EQ(3, provider.created);
+
+  reg.SetPropProvider(NULL, NULL);
+  EXPECT_EQ(3, provider.freed);
+}
+
+namespace {
+// Records the tables it's given. Configures every int property to 7.
+struct BulkProvider {
+  BulkProvider() : create_calls(0), free_calls(0), live(0), written(NULL) {}
+  int create_calls;
+  int free_calls;
+  int live;
+  std::vector<GesturesPropDesc> descs;
+  GesturesPropsWrittenHandler written;
+};
+
+void BulkCreate(void* data, const GesturesPropDesc* descs, size_t count,
+                GesturesProp** props, GesturesPropsWrittenHandler written) {
+  BulkProvider* provider = reinterpret_cast<BulkProvider*>(data);
+  provider->create_calls++;
+  provider->written = written;
+  for (size_t i = 0; i < count; i++) {
+    provider->descs.push_back(descs[i]);
+    if (descs[i].type == GESTURES_PROP_INT)
+      *static_cast<int*>(descs[i].loc) = 7;
+    props[i] = new GesturesProp();
+  }
+  provider->live += count;
+}
+
+void BulkFree(void* data, GesturesProp* const* props, size_t count) {
+  BulkProvider* provider = reinterpret_cast<BulkProvider*>(data);
+  provider->free_calls++;
+  provider->live -= count;
+  for (size_t i = 0; i < count; i++)
+    delete props[i];
+}
+}  // namespace {}
+
+TEST(PropRegistryTest, BulkProviderTest) {
+  GesturesBulkPropProvider bulk_provider = { BulkCreate, BulkFree };
+  BulkProvider provider;
+
+  PropRegistry reg;
+  PropRegistryTestDelegate delegate;
+  IntProperty int_prop(&reg, "Int", 0, &delegate);
+  DoubleProperty double_prop(&reg, "Double", 2.0, &delegate);
+  StringProperty string_prop(&reg, "String", "str", &delegate);
+  reg.SetDeferred(true);
+  reg.SetBulkPropProvider(&bulk_provider, &provider);
+  EXPECT_EQ(1, provider.create_calls);
+  ASSERT_EQ(3, provider.descs.size());
+  EXPECT_STREQ("Int", provider.descs[0].name);
+  EXPECT_EQ(GESTURES_PROP_INT, provider.descs[0].type);
+  EXPECT_EQ(1, provider.descs[0].count);
+  EXPECT_EQ(GESTURES_PROP_REAL, provider.descs[1].type);
+  EXPECT_EQ(GESTURES_PROP_STRING, provider.descs[2].type);
+  EXPECT_STREQ("str", static_cast<const char*>(provider.descs[2].init));
+  // Only the int was configured.
+  EXPECT_EQ(7, int_prop.val_);
+  EXPECT_EQ(1, delegate.call_cnt_);
+
+  // Properties created together after a hold go in one call.
+  reg.HoldCreation();
+  IntProperty held1(&reg, "Held1", 0);
+  IntProperty held2(&reg, "Held2", 0);
+  EXPECT_EQ(1, provider.create_calls);
+  reg.CreateHeldProps();
+  EXPECT_EQ(2, provider.create_calls);
+  EXPECT_EQ(5, provider.live);
+  EXPECT_EQ(7, held2.val_);
+
+  // Writes reported together are committed together.
+  *static_cast<int*>(provider.descs[0].loc) = 8;
+  *static_cast<double*>(provider.descs[1].loc) = 3.0;
+  void* handler_data[] = {
+    provider.descs[0].handler_data, provider.descs[1].handler_data
+  };
+  provider.written(handler_data, arraysize(handler_data));
+  EXPECT_EQ(7, int_prop.val_);
+  reg.Commit();
+  EXPECT_EQ(8, int_prop.val_);
+  EXPECT_DOUBLE_EQ(3.0, double_prop.val_);
+  EXPECT_EQ(3, delegate.call_cnt_);
+  EXPECT_EQ(1, reg.epoch());
+
+  reg.SetBulkPropProvider(NULL, NULL);
+  EXPECT_EQ(1, provider.free_calls);
+  EXPECT_EQ(0, provider.live);
+}
 }  // namespace gestures
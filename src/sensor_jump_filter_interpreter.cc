@@ -26,8 +26,10 @@ SensorJumpFilterInterpreter::SensorJumpFilterInterpreter(PropRegistry* prop_reg,
                                0.9),
       no_warp_min_dist_move_(prop_reg,
                              "Sensor Jump No Warp Min Dist Move",
-                             0.21) {
+                             0.21),
+      input_history_(3) {
   InitName();
+  input_history_.Reset(kMaxFingers);
 }
 
 void SensorJumpFilterInterpreter::SyncInterpretImpl(HardwareState* hwstate,
@@ -37,27 +39,22 @@ void SensorJumpFilterInterpreter::SyncInterpretImpl(HardwareState* hwstate,
     return;
   }
 
-  RemoveMissingIdsFromMap(&previous_input_[0], *hwstate);
-  RemoveMissingIdsFromMap(&previous_input_[1], *hwstate);
+  input_history_.PushState(*hwstate);
   RemoveMissingIdsFromSet(&first_flag_[0], *hwstate);
   RemoveMissingIdsFromSet(&first_flag_[1], *hwstate);
   RemoveMissingIdsFromSet(&first_flag_[2], *hwstate);
   RemoveMissingIdsFromSet(&first_flag_[3], *hwstate);
 
-  map<short, FingerState, kMaxFingers> current_input;
-
-  for (size_t i = 0; i < hwstate->finger_cnt; i++)
-    current_input[hwstate->fingers[i].tracking_id] = hwstate->fingers[i];
-
   for (size_t i = 0; i < hwstate->finger_cnt; i++) {
     short tracking_id = hwstate->fingers[i].tracking_id;
-    if (!MapContainsKey(previous_input_[1], tracking_id) ||
-        !MapContainsKey(previous_input_[0], tracking_id))
+    const FingerState* prev = input_history_.GetFinger(1, tracking_id);
+    const FingerState* prev2 = input_history_.GetFinger(2, tracking_id);
+    if (!prev || !prev2)
       continue;
-    FingerState* fs[] = {
+    const FingerState* fs[] = {
       &hwstate->fingers[i],  // newest
-      &previous_input_[0][tracking_id],
-      &previous_input_[1][tracking_id],  // oldest
+      prev,
+      prev2,  // oldest
     };
     float FingerState::* const fields[] = { &FingerState::position_x,
                                             &FingerState::position_y,
@@ -112,10 +109,11 @@ void SensorJumpFilterInterpreter::SyncInterpretImpl(HardwareState* hwstate,
         should_store_flag = should_warp = true;
       }
       if (should_warp) {
-        fs[0]->flags |= (warp[f_idx] | GESTURES_FINGER_WARP_TELEPORTATION);
+        FingerState* current = &hwstate->fingers[i];
+        current->flags |= (warp[f_idx] | GESTURES_FINGER_WARP_TELEPORTATION);
         // Warping moves here get tap warped, too
         if (warp_move) {
-          fs[0]->flags |= warp[f_idx] == GESTURES_FINGER_WARP_X_MOVE ?
+          current->flags |= warp[f_idx] == GESTURES_FINGER_WARP_X_MOVE ?
               GESTURES_FINGER_WARP_X_TAP_MOVE : GESTURES_FINGER_WARP_Y_TAP_MOVE;
         }
       }
@@ -126,10 +124,6 @@ void SensorJumpFilterInterpreter::SyncInterpretImpl(HardwareState* hwstate,
     }
   }
 
-  // Update previous input/output state
-  previous_input_[1] = previous_input_[0];
-  previous_input_[0] = current_input;
-
   next_->SyncInterpret(hwstate, timeout);
 }
 
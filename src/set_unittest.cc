@@ -76,6 +76,20 @@ TEST(SetTest, OverflowTest) {
   EXPECT_EQ(the_set.end(), the_set.find(7));
 }
 
+TEST(SetTest, TrackingIdTest) {
+  const size_t kMax = 40;
+  set<short, kMax> the_set;
+  for (size_t i = 0; i < kMax; i++)
+    EXPECT_TRUE(the_set.insert(static_cast<short>(i * 1024 - 7)).second);
+  EXPECT_FALSE(the_set.insert(-7).second);
+  for (size_t i = 0; i < kMax; i += 2)
+    EXPECT_EQ(1, the_set.erase(static_cast<short>(i * 1024 - 7)));
+  for (size_t i = 0; i < kMax; i++)
+    EXPECT_EQ(i % 2 == 1,
+              SetContainsValue(the_set, static_cast<short>(i * 1024 - 7)));
+  EXPECT_EQ(1024 - 7, *the_set.begin());
+}
+
 TEST(SetTest, SizeTest) {
   set<short, 2> small;
   set<short, 3> big;
@@ -0,0 +1,232 @@
+// Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "gestures/include/shadow_stack.h"
+
+#include <math.h>
+#include <string.h>
+#include <time.h>
+
+#include "gestures/include/finger_metrics.h"
+#include "gestures/include/logging.h"
+#include "gestures/include/prop_registry.h"
+
+namespace gestures {
+
+namespace {
+// Differences in summed motion smaller than this don't count as divergence.
+const float kMotionTolerance = 0.01;
+
+// Bounds the timer callbacks run for one event, in case a stack keeps
+// asking to be called back right away.
+const int kMaxTimerRunsPerEvent = 16;
+
+struct HardwarePropertiesTask {
+  ShadowStack* stack;
+  HardwareProperties hwprops;
+};
+}  // namespace {}
+
+void GestureSummary::Clear() {
+  memset(counts, 0, sizeof(counts));
+  buttons_down = buttons_up = 0;
+  move_dx = move_dy = scroll_dx = scroll_dy = 0.0;
+}
+
+void GestureSummary::Add(const Gesture& gesture) {
+  if (gesture.type < 0 || static_cast<size_t>(gesture.type) >= kTypeCount)
+    return;
+  counts[gesture.type]++;
+  switch (gesture.type) {
+    case kGestureTypeMove:
+      move_dx += gesture.details.move.dx;
+      move_dy += gesture.details.move.dy;
+      break;
+    case kGestureTypeScroll:
+      scroll_dx += gesture.details.scroll.dx;
+      scroll_dy += gesture.details.scroll.dy;
+      break;
+    case kGestureTypeButtonsChange:
+      buttons_down |= gesture.details.buttons.down;
+      buttons_up |= gesture.details.buttons.up;
+      break;
+    default:
+      break;
+  }
+}
+
+bool GestureSummary::Matches(const GestureSummary& that,
+                             float tolerance) const {
+  return memcmp(counts, that.counts, sizeof(counts)) == 0 &&
+      buttons_down == that.buttons_down &&
+      buttons_up == that.buttons_up &&
+      fabsf(move_dx - that.move_dx) <= tolerance &&
+      fabsf(move_dy - that.move_dy) <= tolerance &&
+      fabsf(scroll_dx - that.scroll_dx) <= tolerance &&
+      fabsf(scroll_dy - that.scroll_dy) <= tolerance;
+}
+
+size_t GestureSummary::total() const {
+  size_t ret = 0;
+  for (size_t i = 0; i < kTypeCount; i++)
+    ret += counts[i];
+  return ret;
+}
+
+ShadowStack::ShadowStack(PropRegistry* prop_reg, MetricsProperties* mprops,
+                         Interpreter* shadow)
+    : prop_reg_(prop_reg),
+      mprops_(mprops),
+      shadow_(shadow),
+      shadow_deadline_(0.0),
+      queued_events_(0),
+      scheduler_(1),
+      strand_(scheduler_.NewStrand()) {
+  memset(&hwprops_, 0, sizeof(hwprops_));
+  memset(&stats_, 0, sizeof(stats_));
+}
+
+ShadowStack::~ShadowStack() {
+  scheduler_.WaitIdle();
+}
+
+void ShadowStack::CopyProperties(const PropRegistry& primary) {
+  const std::vector<Property*>& props = prop_reg_->props();
+  for (std::vector<Property*>::const_iterator it = props.begin(),
+           e = props.end(); it != e; ++it) {
+    Property* source = primary.GetProperty((*it)->name());
+    if (!source)
+      continue;
+    if (!(*it)->SetValue(source->NewValue()))
+      Err("Unable to copy value for property %s", (*it)->name());
+    else
+      (*it)->HandleGesturesPropWritten();
+  }
+}
+
+void ShadowStack::SetHardwareProperties(const HardwareProperties& hwprops) {
+  HardwarePropertiesTask* task = new HardwarePropertiesTask;
+  task->stack = this;
+  task->hwprops = hwprops;
+  strand_->Post(RunSetHardwareProperties, task);
+}
+
+void ShadowStack::RunSetHardwareProperties(void* data) {
+  HardwarePropertiesTask* task = reinterpret_cast<HardwarePropertiesTask*>(data);
+  ShadowStack* self = task->stack;
+  self->hwprops_ = task->hwprops;
+  self->shadow_deadline_ = 0.0;
+  self->shadow_->Initialize(&self->hwprops_, NULL, self->mprops_.get(), self);
+  delete task;
+}
+
+void ShadowStack::SyncInterpret(Interpreter* primary, HardwareState* hwstate,
+                                stime_t* timeout) {
+  // Copy before the primary stack modifies |hwstate|.
+  Event* event = NewEvent(false, hwstate->timestamp);
+  if (event) {
+    event->hwstate = *hwstate;
+    event->fingers.reset(new FingerState[hwstate->finger_cnt ?
+                                         hwstate->finger_cnt : 1]);
+    event->hwstate.fingers = event->fingers.get();
+    event->hwstate.DeepCopy(*hwstate, hwstate->finger_cnt);
+  }
+  primary_summary_.Clear();
+  stime_t start = ThreadCpuTime();
+  primary->SyncInterpret(hwstate, timeout);
+  QueueEvent(event, ThreadCpuTime() - start);
+}
+
+void ShadowStack::HandleTimer(Interpreter* primary, stime_t now,
+                              stime_t* timeout) {
+  Event* event = NewEvent(true, now);
+  primary_summary_.Clear();
+  stime_t start = ThreadCpuTime();
+  primary->HandleTimer(now, timeout);
+  QueueEvent(event, ThreadCpuTime() - start);
+}
+
+GesturesShadowStats ShadowStack::stats() {
+  std::lock_guard<std::mutex> lock(lock_);
+  return stats_;
+}
+
+void ShadowStack::ConsumeGesture(const Gesture& gesture) {
+  shadow_summary_.Add(gesture);
+}
+
+stime_t ShadowStack::ThreadCpuTime() {
+  struct timespec ts;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) < 0)
+    return 0.0;
+  return StimeFromTimespec(&ts);
+}
+
+ShadowStack::Event* ShadowStack::NewEvent(bool is_timer, stime_t now) {
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    if (queued_events_ >= kMaxQueuedEvents) {
+      stats_.dropped_events++;
+      return NULL;
+    }
+    queued_events_++;
+  }
+  Event* ret = new Event;
+  ret->stack = this;
+  ret->is_timer = is_timer;
+  ret->now = now;
+  memset(&ret->hwstate, 0, sizeof(ret->hwstate));
+  ret->primary_cpu = 0.0;
+  return ret;
+}
+
+void ShadowStack::QueueEvent(Event* event, stime_t primary_cpu) {
+  if (!event)
+    return;
+  event->primary = primary_summary_;
+  event->primary_cpu = primary_cpu;
+  strand_->Post(RunEvent, event);
+}
+
+void ShadowStack::RunEvent(void* data) {
+  Event* event = reinterpret_cast<Event*>(data);
+  ShadowStack* self = event->stack;
+  self->shadow_summary_.Clear();
+  stime_t start = ThreadCpuTime();
+  self->HandleDueTimers(event->now);
+  if (!event->is_timer) {
+    stime_t timeout = -1.0;
+    self->shadow_->SyncInterpret(&event->hwstate, &timeout);
+    self->shadow_deadline_ = timeout > 0.0 ? event->now + timeout : 0.0;
+  }
+  stime_t shadow_cpu = ThreadCpuTime() - start;
+  bool diverged = !event->primary.Matches(self->shadow_summary_,
+                                          kMotionTolerance);
+  {
+    std::lock_guard<std::mutex> lock(self->lock_);
+    self->queued_events_--;
+    self->stats_.events++;
+    if (diverged)
+      self->stats_.divergent_events++;
+    self->stats_.primary_gestures += event->primary.total();
+    self->stats_.shadow_gestures += self->shadow_summary_.total();
+    self->stats_.primary_cpu_time += event->primary_cpu;
+    self->stats_.shadow_cpu_time += shadow_cpu;
+  }
+  delete event;
+}
+
+void ShadowStack::HandleDueTimers(stime_t now) {
+  for (int i = 0; i < kMaxTimerRunsPerEvent; i++) {
+    if (shadow_deadline_ <= 0.0 || shadow_deadline_ > now)
+      return;
+    shadow_deadline_ = 0.0;
+    stime_t timeout = -1.0;
+    shadow_->HandleTimer(now, &timeout);
+    if (timeout >= 0.0)
+      shadow_deadline_ = now + timeout;
+  }
+}
+
+}  // namespace gestures
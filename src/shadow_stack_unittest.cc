@@ -0,0 +1,196 @@
+// Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <atomic>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "gestures/include/finger_metrics.h"
+#include "gestures/include/gestures.h"
+#include "gestures/include/prop_registry.h"
+#include "gestures/include/shadow_stack.h"
+
+namespace gestures {
+
+class ShadowStackTest : public ::testing::Test {};
+
+namespace {
+// Moves by the first finger's x position times "Shadow Test Scale", then
+// scribbles over the finger. Once fingers leave, asks for a timer and
+// reports a click from it.
+class ShadowStackTestInterpreter : public Interpreter {
+ public:
+  explicit ShadowStackTestInterpreter(PropRegistry* prop_reg)
+      : Interpreter(NULL, NULL, false),
+        scale_(prop_reg, "Shadow Test Scale", 1.0),
+        release_(NULL) {}
+
+  virtual void SyncInterpretImpl(HardwareState* hwstate, stime_t* timeout) {
+    if (release_) {
+      while (!*release_)
+        std::this_thread::yield();
+    }
+    if (hwstate->finger_cnt == 0) {
+      *timeout = 0.1;
+      return;
+    }
+    float dx = hwstate->fingers[0].position_x * scale_.val_;
+    ProduceGesture(Gesture(kGestureMove, hwstate->timestamp,
+                           hwstate->timestamp, dx, 0));
+    hwstate->fingers[0].position_x = -1.0;
+  }
+
+  virtual void HandleTimerImpl(stime_t now, stime_t* timeout) {
+    ProduceGesture(Gesture(kGestureButtonsChange, now, now,
+                           GESTURES_BUTTON_LEFT, GESTURES_BUTTON_LEFT));
+  }
+
+  DoubleProperty scale_;
+  // If set, SyncInterpret() waits for it to become true.
+  std::atomic<bool>* release_;
+};
+
+class SummaryConsumer : public GestureConsumer {
+ public:
+  explicit SummaryConsumer(GestureSummary* summary) : summary_(summary) {}
+  virtual void ConsumeGesture(const Gesture& gesture) {
+    summary_->Add(gesture);
+  }
+ private:
+  GestureSummary* summary_;
+};
+
+HardwareProperties hwprops = {
+  0, 0, 100, 100,  // left, top, right, bottom
+  1, 1, 133, 133,  // res, dpi
+  0, 0,  // orientation minimum, maximum
+  2, 5, 0, 0, 0, 0  // max fingers, max_touch, t5r2, semi_mt, button pad, wheel
+};
+
+// Pushes |count| frames with one finger, then one with none, then runs the
+// timer that asks for.
+void RunFrames(ShadowStack* stack, Interpreter* primary, int count) {
+  FingerState fs = { 0, 0, 0, 0, 10, 0, 1, 1, 1, 0 };
+  stime_t now = 1.0;
+  for (int i = 0; i < count; i++, now += 0.01) {
+    fs.position_x = i + 1;
+    HardwareState hs = { now, 0, 1, 1, &fs, 0, 0, 0, 0 };
+    stime_t timeout = -1.0;
+    stack->SyncInterpret(primary, &hs, &timeout);
+    EXPECT_EQ(-1.0, fs.position_x);
+  }
+  HardwareState hs = { now, 0, 0, 0, NULL, 0, 0, 0, 0 };
+  stime_t timeout = -1.0;
+  stack->SyncInterpret(primary, &hs, &timeout);
+  EXPECT_DOUBLE_EQ(0.1, timeout);
+  timeout = -1.0;
+  stack->HandleTimer(primary, now + 0.1, &timeout);
+}
+}  // namespace {}
+
+TEST(ShadowStackTest, SummaryTest) {
+  GestureSummary a, b;
+  EXPECT_TRUE(a.Matches(b, 0.0));
+  a.Add(Gesture(kGestureMove, 0, 0, 1.0, 2.0));
+  EXPECT_FALSE(a.Matches(b, 0.0));
+  b.Add(Gesture(kGestureMove, 0, 0, 1.005, 2.0));
+  EXPECT_FALSE(a.Matches(b, 0.001));
+  EXPECT_TRUE(a.Matches(b, 0.01));
+  a.Add(Gesture(kGestureButtonsChange, 0, 0, GESTURES_BUTTON_LEFT, 0));
+  b.Add(Gesture(kGestureButtonsChange, 0, 0, GESTURES_BUTTON_RIGHT, 0));
+  EXPECT_FALSE(a.Matches(b, 0.01));
+  EXPECT_EQ(2, a.total());
+  a.Clear();
+  EXPECT_EQ(0, a.total());
+}
+
+TEST(ShadowStackTest, MatchingStacksTest) {
+  PropRegistry primary_reg;
+  MetricsProperties primary_mprops(&primary_reg);
+  ShadowStackTestInterpreter primary(&primary_reg);
+  primary.scale_.val_ = 2.0;
+
+  PropRegistry* shadow_reg = new PropRegistry;
+  ShadowStackTestInterpreter* shadow = new ShadowStackTestInterpreter(
+      shadow_reg);
+  ShadowStack stack(shadow_reg, new MetricsProperties(shadow_reg), shadow);
+  stack.CopyProperties(primary_reg);
+  EXPECT_DOUBLE_EQ(2.0, shadow->scale_.val_);
+
+  SummaryConsumer consumer(stack.primary_summary());
+  primary.Initialize(&hwprops, NULL, &primary_mprops, &consumer);
+  stack.SetHardwareProperties(hwprops);
+  RunFrames(&stack, &primary, 10);
+  stack.WaitIdle();
+
+  GesturesShadowStats stats = stack.stats();
+  EXPECT_EQ(12, stats.events);
+  EXPECT_EQ(0, stats.divergent_events);
+  EXPECT_EQ(11, stats.primary_gestures);
+  EXPECT_EQ(11, stats.shadow_gestures);
+  EXPECT_EQ(0, stats.dropped_events);
+  EXPECT_GE(stats.primary_cpu_time, 0.0);
+  EXPECT_GE(stats.shadow_cpu_time, 0.0);
+}
+
+TEST(ShadowStackTest, DivergenceTest) {
+  PropRegistry primary_reg;
+  MetricsProperties primary_mprops(&primary_reg);
+  ShadowStackTestInterpreter primary(&primary_reg);
+
+  PropRegistry* shadow_reg = new PropRegistry;
+  ShadowStackTestInterpreter* shadow = new ShadowStackTestInterpreter(
+      shadow_reg);
+  ShadowStack stack(shadow_reg, new MetricsProperties(shadow_reg), shadow);
+  shadow->scale_.val_ = 1.5;
+
+  SummaryConsumer consumer(stack.primary_summary());
+  primary.Initialize(&hwprops, NULL, &primary_mprops, &consumer);
+  stack.SetHardwareProperties(hwprops);
+  RunFrames(&stack, &primary, 10);
+  stack.WaitIdle();
+
+  // Every move differs; the lift and the timer's click don't.
+  GesturesShadowStats stats = stack.stats();
+  EXPECT_EQ(12, stats.events);
+  EXPECT_EQ(10, stats.divergent_events);
+  EXPECT_EQ(stats.primary_gestures, stats.shadow_gestures);
+}
+
+// A shadow stack that can't keep up mustn't hold up the primary one.
+TEST(ShadowStackTest, DroppedEventsTest) {
+  PropRegistry primary_reg;
+  MetricsProperties primary_mprops(&primary_reg);
+  ShadowStackTestInterpreter primary(&primary_reg);
+
+  PropRegistry* shadow_reg = new PropRegistry;
+  ShadowStackTestInterpreter* shadow = new ShadowStackTestInterpreter(
+      shadow_reg);
+  std::atomic<bool> release(false);
+  shadow->release_ = &release;
+  ShadowStack stack(shadow_reg, new MetricsProperties(shadow_reg), shadow);
+
+  SummaryConsumer consumer(stack.primary_summary());
+  primary.Initialize(&hwprops, NULL, &primary_mprops, &consumer);
+  stack.SetHardwareProperties(hwprops);
+  RunFrames(&stack, &primary, 299);
+  release = true;
+  stack.WaitIdle();
+
+  GesturesShadowStats stats = stack.stats();
+  EXPECT_EQ(256, stats.events);
+  EXPECT_EQ(45, stats.dropped_events);
+  EXPECT_EQ(0, stats.divergent_events);
+}
+
+TEST(ShadowStackTest, DisabledTest) {
+  GestureInterpreter* gi = NewGestureInterpreter();
+  GestureInterpreterInitialize(gi, GESTURES_DEVCLASS_TOUCHPAD);
+  GesturesShadowStats stats;
+  EXPECT_EQ(0, GestureInterpreterGetShadowStats(gi, &stats));
+  DeleteGestureInterpreter(gi);
+}
+
+}  // namespace gestures
@@ -0,0 +1,48 @@
+// Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "gestures/include/shared_resources.h"
+
+#include <sys/stat.h>
+
+#include "gestures/include/gestures.h"
+#include "gestures/include/string_util.h"
+
+namespace gestures {
+
+std::string SharedResources::FileKey(const char* prefix, const char* path) {
+  struct stat st;
+  if (stat(path, &st) < 0)
+    return "";
+  return StringPrintf("%s:%s:%llu:%llu:%lld:%lld.%09ld", prefix, path,
+                      static_cast<unsigned long long>(st.st_dev),
+                      static_cast<unsigned long long>(st.st_ino),
+                      static_cast<long long>(st.st_size),
+                      static_cast<long long>(st.st_mtim.tv_sec),
+                      st.st_mtim.tv_nsec);
+}
+
+size_t SharedResources::size() {
+  std::lock_guard<std::mutex> lock(lock_);
+  for (std::map<std::string, std::weak_ptr<const void> >::iterator it =
+           entries_.begin(); it != entries_.end();) {
+    if (it->second.expired())
+      entries_.erase(it++);
+    else
+      ++it;
+  }
+  return entries_.size();
+}
+
+}  // namespace gestures
+
+// C API:
+
+GesturesSharedResources* NewGesturesSharedResources(void) {
+  return new gestures::SharedResources();
+}
+
+void DeleteGesturesSharedResources(GesturesSharedResources* resources) {
+  delete resources;
+}
@@ -0,0 +1,84 @@
+// Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "gestures/include/gestures.h"
+#include "gestures/include/shared_resources.h"
+
+namespace gestures {
+
+class SharedResourcesTest : public ::testing::Test {};
+
+namespace {
+int* NewInt(void* data) {
+  int* calls = reinterpret_cast<int*>(data);
+  (*calls)++;
+  return new int(*calls);
+}
+
+int* FailToCreate(void* data) {
+  (*reinterpret_cast<int*>(data))++;
+  return NULL;
+}
+}  // namespace {}
+
+TEST(SharedResourcesTest, SimpleTest) {
+  SharedResources resources;
+  int calls = 0;
+  std::shared_ptr<const int> first = resources.Get<int>("a", NewInt, &calls);
+  std::shared_ptr<const int> second = resources.Get<int>("a", NewInt, &calls);
+  EXPECT_EQ(1, calls);
+  EXPECT_EQ(first.get(), second.get());
+  EXPECT_EQ(1, resources.size());
+
+  std::shared_ptr<const int> other = resources.Get<int>("b", NewInt, &calls);
+  EXPECT_EQ(2, calls);
+  EXPECT_NE(first.get(), other.get());
+  EXPECT_EQ(2, resources.size());
+
+  // Entries go away with their last user and are rebuilt on demand.
+  first.reset();
+  second.reset();
+  EXPECT_EQ(1, resources.size());
+  first = resources.Get<int>("a", NewInt, &calls);
+  EXPECT_EQ(3, calls);
+  EXPECT_EQ(3, *first);
+
+  // Failures aren't cached.
+  int failures = 0;
+  EXPECT_FALSE(resources.Get<int>("c", FailToCreate, &failures));
+  EXPECT_FALSE(resources.Get<int>("c", FailToCreate, &failures));
+  EXPECT_EQ(2, failures);
+  EXPECT_EQ(2, resources.size());
+}
+
+TEST(SharedResourcesTest, OutlivesHostTest) {
+  int calls = 0;
+  GesturesSharedResources* resources = NewGesturesSharedResources();
+  std::shared_ptr<const int> value = resources->Get<int>("a", NewInt, &calls);
+  DeleteGesturesSharedResources(resources);
+  EXPECT_EQ(1, *value);
+}
+
+TEST(SharedResourcesTest, FileKeyTest) {
+  char path[] = "/tmp/shared_resources_unittest_XXXXXX";
+  int fd = mkstemp(path);
+  ASSERT_LE(0, fd);
+  std::string key = SharedResources::FileKey("test", path);
+  EXPECT_FALSE(key.empty());
+  EXPECT_EQ(key, SharedResources::FileKey("test", path));
+  EXPECT_NE(key, SharedResources::FileKey("other", path));
+  EXPECT_EQ(1, write(fd, "x", 1));
+  EXPECT_NE(key, SharedResources::FileKey("test", path));
+  close(fd);
+  unlink(path);
+  EXPECT_EQ("", SharedResources::FileKey("test", path));
+}
+
+}  // namespace gestures
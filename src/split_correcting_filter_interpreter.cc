@@ -63,40 +63,53 @@ void SplitCorrectingFilterInterpreter::MergeFingers(
   }
   if (unused.empty())
     return;
-  for (UnmergedContact* it = unmerged_; it->Valid();) {
+  // Pair unmerged contacts with new contacts that they may have split into,
+  // all at once, so that which pairs are made doesn't depend on the order
+  // of unmerged_.
+  const FingerState* new_contacts[kMaxFingers];
+  size_t new_cnt = 0;
+  for (set<const FingerState*, kMaxFingers>::iterator unused_it =
+           unused.begin(), e = unused.end(); unused_it != e; ++unused_it)
+    new_contacts[new_cnt++] = *unused_it;
+  const FingerState* existing_contacts[kMaxFingers];
+  size_t unmerged_cnt = 0;
+  for (; unmerged_cnt < arraysize(unmerged_) &&
+           unmerged_[unmerged_cnt].Valid(); unmerged_cnt++) {
     // Current state of the unmerged finger
-    const FingerState* existing_contact = hwstate.GetFingerState(it->input_id);
-    if (!existing_contact) {
+    existing_contacts[unmerged_cnt] =
+        hwstate.GetFingerState(unmerged_[unmerged_cnt].input_id);
+    if (!existing_contacts[unmerged_cnt]) {
       Err("How is existing_contact NULL?");
       return;
     }
-    // try all fingers for possible merging
-    float min_error = INFINITY;
-    set<const FingerState*, kMaxFingers>::iterator min_error_it = unused.end();
-    for (set<const FingerState*, kMaxFingers>::iterator unused_it =
-             unused.begin(), e = unused.end(); unused_it != e; ++unused_it) {
-      const FingerState* new_contact = *unused_it;
-      if (new_contact == existing_contact)
-        continue;
-      float error = AreMergePair(*existing_contact, *new_contact, *it);
-      if (error < 0)
+  }
+  merge_solver_.Reset(unmerged_cnt, new_cnt);
+  for (size_t i = 0; i < unmerged_cnt; i++) {
+    for (size_t j = 0; j < new_cnt; j++) {
+      if (new_contacts[j] == existing_contacts[i])
         continue;
-      if (error < min_error) {
-        min_error = error;
-        min_error_it = unused_it;
-      }
+      float error = AreMergePair(*existing_contacts[i], *new_contacts[j],
+                                 unmerged_[i]);
+      if (error >= 0)
+        merge_solver_.SetCost(i, j, error);
     }
-    if (min_error_it != unused.end()) {
-      // we have a merge!
-      AppendMergedContact(*existing_contact, *(*min_error_it), it->output_id);
-      unused.erase(min_error_it);
-      // Delete this UnmergedContact
-      std::copy(it + 1, &unmerged_[arraysize(unmerged_)], it);
-      unmerged_[arraysize(unmerged_) - 1].Invalidate();
+  }
+  merge_solver_.Solve();
+  size_t kept = 0;
+  for (size_t i = 0; i < unmerged_cnt; i++) {
+    int j = merge_solver_.ColForRow(i);
+    if (j == AssignmentSolver::kUnassigned) {
+      unmerged_[kept++] = unmerged_[i];
       continue;
     }
-    it++;
+    // we have a merge!
+    AppendMergedContact(*existing_contacts[i], *new_contacts[j],
+                        unmerged_[i].output_id);
+    unused.erase(new_contacts[j]);
   }
+  // Delete the merged UnmergedContacts
+  for (size_t i = kept; i < unmerged_cnt; i++)
+    unmerged_[i].Invalidate();
   if (unused.empty())
     return;
   // Put the unused new fingers into the unmerged fingers
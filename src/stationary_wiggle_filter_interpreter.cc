@@ -6,6 +6,7 @@
 
 #include "gestures/include/gestures.h"
 #include "gestures/include/interpreter.h"
+#include "gestures/include/logging.h"
 #include "gestures/include/map.h"
 #include "gestures/include/tracer.h"
 #include "gestures/include/util.h"
@@ -20,44 +21,69 @@ void FingerEnergyHistory::PushFingerState(const FingerState &fs,
   if (moving_ && timestamp - prev_ > idle_time_) {
     moving_ = false;
     head_ = size_ = 0;
+    ClearSums();
+  }
+
+  // Drop the oldest sample from the sums if it's about to be overwritten
+  if (size_ == max_size_) {
+    const FingerEnergy& oldest = Get(size_ - 1);
+    sum_x_ -= oldest.x;
+    sum_y_ -= oldest.y;
+    sum_mixed_x_ -= oldest.mixed_x;
+    sum_mixed_y_ -= oldest.mixed_y;
+    sum_energy_x_ -= oldest.energy_x;
+    sum_energy_y_ -= oldest.energy_y;
   }
 
   // Insert current finger position into the queue
   head_ = (head_ + max_size_ - 1) % max_size_;
-  history_[head_].x = fs.position_x;
-  history_[head_].y = fs.position_y;
+  FingerEnergy* fe = &history_[head_];
+  fe->x = fs.position_x;
+  fe->y = fs.position_y;
   size_ = std::min(size_ + 1, max_size_);
 
-  // Calculate average of original signal set, the average of original signal
-  // is considered as the offset.
-  float sum_x = 0.0;
-  float sum_y = 0.0;
-  for (size_t i = 0; i < size_; ++i) {
-    const FingerEnergy& fe = Get(i);
-    sum_x += fe.x;
-    sum_y += fe.y;
-  }
-  // Obtain the mixed signal strength
-  history_[head_].mixed_x = fs.position_x - sum_x / size_;
-  history_[head_].mixed_y = fs.position_y - sum_y / size_;
+  // The average of original signal set is considered as the offset. Obtain
+  // the mixed signal strength.
+  sum_x_ += fe->x;
+  sum_y_ += fe->y;
+  fe->mixed_x = fs.position_x - sum_x_ / size_;
+  fe->mixed_y = fs.position_y - sum_y_ / size_;
+
+  // The average of mixed signal set is considered as pure signal strength.
+  sum_mixed_x_ += fe->mixed_x;
+  sum_mixed_y_ += fe->mixed_y;
+  float psx = sum_mixed_x_ / size_;
+  float psy = sum_mixed_y_ / size_;
+  // Calculate current pure signal energy
+  fe->energy_x = psx * psx;
+  fe->energy_y = psy * psy;
+  sum_energy_x_ += fe->energy_x;
+  sum_energy_y_ += fe->energy_y;
+
+  if (++pushes_ >= kRecomputeInterval)
+    RecomputeSums();
 
+  prev_ = timestamp;
+}
 
-  // Calculate the average of the mixed signal set, the average of mixed signal
-  // is considered as pure signal strength.
-  float psx = 0.0;
-  float psy = 0.0;
+void FingerEnergyHistory::ClearSums() {
+  sum_x_ = sum_y_ = 0.0;
+  sum_mixed_x_ = sum_mixed_y_ = 0.0;
+  sum_energy_x_ = sum_energy_y_ = 0.0;
+  pushes_ = 0;
+}
+
+void FingerEnergyHistory::RecomputeSums() {
+  ClearSums();
   for (size_t i = 0; i < size_; ++i) {
     const FingerEnergy& fe = Get(i);
-    psx += fe.mixed_x;
-    psy += fe.mixed_y;
+    sum_x_ += fe.x;
+    sum_y_ += fe.y;
+    sum_mixed_x_ += fe.mixed_x;
+    sum_mixed_y_ += fe.mixed_y;
+    sum_energy_x_ += fe.energy_x;
+    sum_energy_y_ += fe.energy_y;
   }
-  psx /= size_;
-  psy /= size_;
-  // Calculate current pure signal energy
-  history_[head_].energy_x = psx * psx;
-  history_[head_].energy_y = psy * psy;
-
-  prev_ = timestamp;
 }
 
 const FingerEnergy& FingerEnergyHistory::Get(size_t offset) const {
@@ -74,14 +100,7 @@ bool FingerEnergyHistory::IsFingerMoving(float threshold) {
   if (size_ < max_size_)
     return false;
 
-  float sum_energy_x = 0.0;
-  float sum_energy_y = 0.0;
-  for (size_t i = 0; i < size_; i++) {
-    const FingerEnergy& fe = history_[i];
-    sum_energy_x += fe.energy_x;
-    sum_energy_y += fe.energy_y;
-  }
-  moving_ = (sum_energy_x > threshold || sum_energy_y > threshold);
+  moving_ = (sum_energy_x_ > threshold || sum_energy_y_ > threshold);
   return moving_;
 }
 
@@ -103,7 +122,9 @@ StationaryWiggleFilterInterpreter::StationaryWiggleFilterInterpreter(
     : FilterInterpreter(NULL, next, tracer, false),
       enabled_(prop_reg, "Stationary Wiggle Filter Enabled", false),
       threshold_(prop_reg, "Finger Moving Energy", 0.012),
-      hysteresis_(prop_reg, "Finger Moving Hysteresis", 0.006) {
+      hysteresis_(prop_reg, "Finger Moving Hysteresis", 0.006),
+      window_size_(prop_reg, "Finger Moving Energy Samples", SIGNAL_SAMPLES,
+                   this) {
   InitName();
 }
 
@@ -114,6 +135,14 @@ void StationaryWiggleFilterInterpreter::SyncInterpretImpl(
   next_->SyncInterpret(hwstate, timeout);
 }
 
+void StationaryWiggleFilterInterpreter::IntWasWritten(IntProperty* prop) {
+  if (window_size_.val_ < 1 || window_size_.val_ > MAX_SIGNAL_SAMPLES)
+    Err("Finger Moving Energy Samples must be from 1 to %d",
+        MAX_SIGNAL_SAMPLES);
+  // Start over with the new window size.
+  histories_.clear();
+}
+
 void StationaryWiggleFilterInterpreter::UpdateStationaryFlags(
     HardwareState* hwstate) {
 
@@ -124,7 +153,8 @@ void StationaryWiggleFilterInterpreter::UpdateStationaryFlags(
 
     // Create a new entry if it is a new finger
     if (!MapContainsKey(histories_, fs->tracking_id)) {
-      histories_[fs->tracking_id] = FingerEnergyHistory();
+      histories_[fs->tracking_id] =
+          FingerEnergyHistory(std::max(window_size_.val_, 0));
       histories_[fs->tracking_id].PushFingerState(*fs, hwstate->timestamp);
       continue;
     }
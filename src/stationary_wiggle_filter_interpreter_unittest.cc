@@ -0,0 +1,110 @@
+// Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <math.h>
+
+#include <deque>
+
+#include <gtest/gtest.h>
+
+#include "gestures/include/gestures.h"
+#include "gestures/include/stationary_wiggle_filter_interpreter.h"
+#include "gestures/include/unittest_util.h"
+
+using std::deque;
+
+namespace gestures {
+
+class StationaryWiggleFilterInterpreterTest : public ::testing::Test {};
+
+class StationaryWiggleFilterInterpreterTestInterpreter : public Interpreter {
+ public:
+  StationaryWiggleFilterInterpreterTestInterpreter()
+      : Interpreter(NULL, NULL, false) {}
+
+  virtual void SyncInterpret(HardwareState* hwstate, stime_t* timeout) {}
+};
+
+// The running sums must give the energies computed from the whole window,
+// long after they were last recomputed.
+TEST(StationaryWiggleFilterInterpreterTest, RunningSumTest) {
+  const size_t kWindow = 32;
+  FingerEnergyHistory history(kWindow);
+  deque<float> xs, mixed;
+  deque<float> energies;
+  for (size_t i = 0; i < 1000; i++) {
+    FingerState fs = { 0, 0, 0, 0, 50, 0, 0, 0, 1, 0 };
+    // A slow drift with a little wiggle on top, far from the origin
+    fs.position_x = 500.0 + 0.01 * i + 0.2 * sinf(i * 1.3);
+    history.PushFingerState(fs, 0.01 * i);
+
+    xs.push_front(fs.position_x);
+    if (xs.size() > kWindow)
+      xs.pop_back();
+    double sum = 0.0;
+    for (size_t j = 0; j < xs.size(); j++)
+      sum += xs[j];
+    mixed.push_front(fs.position_x - sum / xs.size());
+    if (mixed.size() > kWindow)
+      mixed.pop_back();
+    double pure = 0.0;
+    for (size_t j = 0; j < mixed.size(); j++)
+      pure += mixed[j];
+    pure /= mixed.size();
+    energies.push_front(pure * pure);
+    if (energies.size() > kWindow)
+      energies.pop_back();
+
+    const FingerEnergy& fe = history.Get(0);
+    EXPECT_NEAR(mixed[0], fe.mixed_x, 1e-3) << "i=" << i;
+    EXPECT_NEAR(energies[0], fe.energy_x, 1e-5) << "i=" << i;
+  }
+  ASSERT_TRUE(history.HasEnoughSamples());
+  double total = 0.0;
+  for (size_t j = 0; j < energies.size(); j++)
+    total += energies[j];
+  EXPECT_TRUE(history.IsFingerMoving(total * 0.99));
+  EXPECT_FALSE(history.IsFingerMoving(total * 1.01));
+}
+
+TEST(StationaryWiggleFilterInterpreterTest, SimpleTest) {
+  StationaryWiggleFilterInterpreter interpreter(
+      NULL, new StationaryWiggleFilterInterpreterTestInterpreter, NULL);
+  TestInterpreterWrapper wrapper(&interpreter);
+  interpreter.enabled_.val_ = true;
+
+  const unsigned kWarp = GESTURES_FINGER_WARP_X | GESTURES_FINGER_WARP_Y;
+  for (size_t i = 0; i < 20; i++) {
+    // Finger 1 wiggles in place; finger 2 moves steadily.
+    FingerState fs[] = {
+      { 0, 0, 0, 0, 50, 0, 30.0f + 0.01f * (i % 2), 30, 1, 0 },
+      { 0, 0, 0, 0, 50, 0, 60.0f + 2.0f * i, 30, 2, 0 },
+    };
+    HardwareState hs = { 0.01 * i, 0, 2, 2, fs, 0, 0, 0, 0 };
+    stime_t timeout = -1.0;
+    wrapper.SyncInterpret(&hs, &timeout);
+    if (i < SIGNAL_SAMPLES - 1) {
+      // Too few samples to tell
+      EXPECT_EQ(0U, fs[0].flags) << "i=" << i;
+      EXPECT_EQ(0U, fs[1].flags) << "i=" << i;
+    } else {
+      EXPECT_EQ(kWarp, fs[0].flags) << "i=" << i;
+      EXPECT_EQ(static_cast<unsigned>(GESTURES_FINGER_INSTANTANEOUS_MOVING),
+                fs[1].flags) << "i=" << i;
+    }
+  }
+
+  // A longer window takes longer to fill.
+  interpreter.window_size_.val_ = 10;
+  interpreter.IntWasWritten(&interpreter.window_size_);
+  for (size_t i = 0; i < 10; i++) {
+    FingerState fs = { 0, 0, 0, 0, 50, 0, 30, 30, 1, 0 };
+    HardwareState hs = { 0.2 + 0.01 * i, 0, 1, 1, &fs, 0, 0, 0, 0 };
+    stime_t timeout = -1.0;
+    wrapper.SyncInterpret(&hs, &timeout);
+    EXPECT_EQ(i < 9 ? 0U : kWarp, fs.flags) << "i=" << i;
+  }
+}
+
+}  // namespace gestures
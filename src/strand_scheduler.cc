@@ -0,0 +1,350 @@
+// Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "gestures/include/strand_scheduler.h"
+
+#include <algorithm>
+
+#include "gestures/include/logging.h"
+
+namespace gestures {
+
+namespace {
+// The scheduler and worker index of the current thread, if it is a worker.
+thread_local StrandScheduler* current_scheduler = NULL;
+thread_local size_t current_worker = 0;
+
+struct HardwareStateTask {
+  GestureInterpreter* gi;
+  HardwareState hwstate;
+  std::unique_ptr<FingerState[]> fingers;
+};
+}  // namespace {}
+
+GesturesTimerProvider Strand::kProvider = {
+  Strand::StaticCreate,
+  Strand::StaticSet,
+  Strand::StaticCancel,
+  Strand::StaticFree
+};
+
+Strand::Strand(StrandScheduler* scheduler)
+    : scheduler_(scheduler),
+      scheduled_(false),
+      timer_provider_(NULL),
+      timer_provider_data_(NULL) {}
+
+void Strand::Post(GesturesTaskFunction task, void* data) {
+  scheduler_->TaskPosted();
+  bool schedule = false;
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    Work work = { task, data };
+    queue_.push_back(work);
+    if (!scheduled_)
+      schedule = scheduled_ = true;
+  }
+  if (schedule)
+    scheduler_->Schedule(this);
+}
+
+bool Strand::RunTurn() {
+  for (size_t i = 0; i < kMaxTasksPerTurn; i++) {
+    Work work;
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      if (queue_.empty()) {
+        scheduled_ = false;
+        return false;
+      }
+      work = queue_.front();
+      queue_.pop_front();
+    }
+    work.task(work.data);
+    scheduler_->TasksDone(1);
+  }
+  std::lock_guard<std::mutex> lock(lock_);
+  if (queue_.empty()) {
+    scheduled_ = false;
+    return false;
+  }
+  return true;
+}
+
+void Strand::PostHardwareState(GestureInterpreter* gi,
+                               const HardwareState& hwstate) {
+  HardwareStateTask* task = new HardwareStateTask;
+  task->gi = gi;
+  task->hwstate = hwstate;
+  task->fingers.reset(new FingerState[hwstate.finger_cnt ?
+                                      hwstate.finger_cnt : 1]);
+  task->hwstate.fingers = task->fingers.get();
+  task->hwstate.DeepCopy(hwstate, hwstate.finger_cnt);
+  Post(RunHardwareState, task);
+}
+
+void Strand::RunHardwareState(void* data) {
+  HardwareStateTask* task = reinterpret_cast<HardwareStateTask*>(data);
+  task->gi->PushHardwareState(&task->hwstate);
+  delete task;
+}
+
+GesturesTimer* Strand::StaticCreate(void* data) {
+  Strand* strand = reinterpret_cast<Strand*>(data);
+  if (!strand->timer_provider_) {
+    Err("Strand has no timer provider to wrap");
+    return NULL;
+  }
+  GesturesTimer* timer =
+      strand->timer_provider_->create_fn(strand->timer_provider_data_);
+  if (!timer)
+    return NULL;
+  Timer* ret = new Timer;
+  ret->strand = strand;
+  ret->timer = timer;
+  ret->callback = NULL;
+  ret->callback_data = NULL;
+  ret->generation = 0;
+  return reinterpret_cast<GesturesTimer*>(ret);
+}
+
+void Strand::ArmTimer(Timer* timer, stime_t delay) {
+  timer->generation++;
+  timer_provider_->set_fn(timer_provider_data_, timer->timer, delay,
+                          TimerTrampoline, timer);
+}
+
+void Strand::StaticSet(void* data, GesturesTimer* timer, stime_t delay,
+                       GesturesTimerCallback callback, void* callback_data) {
+  Timer* wrapper = reinterpret_cast<Timer*>(timer);
+  wrapper->callback = callback;
+  wrapper->callback_data = callback_data;
+  reinterpret_cast<Strand*>(data)->ArmTimer(wrapper, delay);
+}
+
+void Strand::StaticCancel(void* data, GesturesTimer* timer) {
+  Strand* strand = reinterpret_cast<Strand*>(data);
+  Timer* wrapper = reinterpret_cast<Timer*>(timer);
+  wrapper->generation++;
+  strand->timer_provider_->cancel_fn(strand->timer_provider_data_,
+                                     wrapper->timer);
+}
+
+void Strand::StaticFree(void* data, GesturesTimer* timer) {
+  Strand* strand = reinterpret_cast<Strand*>(data);
+  Timer* wrapper = reinterpret_cast<Timer*>(timer);
+  wrapper->generation++;
+  strand->timer_provider_->free_fn(strand->timer_provider_data_,
+                                   wrapper->timer);
+  // Firings may still be queued on the strand, so free it after them.
+  strand->Post(DeleteTimer, wrapper);
+}
+
+void Strand::DeleteTimer(void* data) {
+  delete reinterpret_cast<Timer*>(data);
+}
+
+// Runs on the wrapped provider's thread.
+stime_t Strand::TimerTrampoline(stime_t now, void* data) {
+  Timer* timer = reinterpret_cast<Timer*>(data);
+  TimerFiring* firing = new TimerFiring;
+  firing->timer = timer;
+  firing->generation = timer->generation;
+  firing->now = now;
+  timer->strand->Post(RunTimerFiring, firing);
+  // If the callback wants to run again, RunTimerFiring re-arms the timer.
+  return -1.0;
+}
+
+void Strand::RunTimerFiring(void* data) {
+  TimerFiring* firing = reinterpret_cast<TimerFiring*>(data);
+  Timer* timer = firing->timer;
+  if (firing->generation == timer->generation) {
+    stime_t next = timer->callback(firing->now, timer->callback_data);
+    if (next >= 0.0)
+      timer->strand->ArmTimer(timer, next);
+  }
+  delete firing;
+}
+
+StrandScheduler::StrandScheduler(size_t thread_count)
+    : runnable_count_(0),
+      pending_tasks_(0),
+      next_worker_(0),
+      steals_(0),
+      stopping_(false) {
+  if (thread_count == 0)
+    thread_count = std::max(std::thread::hardware_concurrency(), 1U);
+  for (size_t i = 0; i < thread_count; i++)
+    workers_.push_back(std::unique_ptr<Worker>(new Worker));
+  // Start the threads only once workers_ is complete, since they steal from
+  // each other.
+  for (size_t i = 0; i < thread_count; i++)
+    workers_[i]->thread = std::thread(&StrandScheduler::WorkerMain, this, i);
+}
+
+StrandScheduler::~StrandScheduler() {
+  WaitIdle();
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    stopping_ = true;
+  }
+  wake_.notify_all();
+  for (size_t i = 0; i < workers_.size(); i++)
+    workers_[i]->thread.join();
+}
+
+Strand* StrandScheduler::NewStrand() {
+  std::lock_guard<std::mutex> lock(strands_lock_);
+  strands_.push_back(std::unique_ptr<Strand>(new Strand(this)));
+  return strands_.back().get();
+}
+
+void StrandScheduler::WaitIdle() {
+  if (current_scheduler == this) {
+    Err("WaitIdle() called from a task would never return");
+    return;
+  }
+  std::unique_lock<std::mutex> lock(lock_);
+  while (pending_tasks_)
+    idle_.wait(lock);
+}
+
+size_t StrandScheduler::steals() {
+  std::lock_guard<std::mutex> lock(lock_);
+  return steals_;
+}
+
+void StrandScheduler::TaskPosted() {
+  std::lock_guard<std::mutex> lock(lock_);
+  pending_tasks_++;
+}
+
+void StrandScheduler::TasksDone(size_t count) {
+  std::lock_guard<std::mutex> lock(lock_);
+  pending_tasks_ -= count;
+  if (!pending_tasks_)
+    idle_.notify_all();
+}
+
+void StrandScheduler::Schedule(Strand* strand) {
+  size_t index;
+  {
+    std::lock_guard<std::mutex> lock(lock_);
+    // Count it first, so that a thread taking it never sees a zero count.
+    runnable_count_++;
+    if (current_scheduler == this)
+      index = current_worker;
+    else
+      index = next_worker_++ % workers_.size();
+  }
+  {
+    std::lock_guard<std::mutex> lock(workers_[index]->lock);
+    workers_[index]->runnable.push_back(strand);
+  }
+  wake_.notify_one();
+}
+
+Strand* StrandScheduler::TakeStrand(size_t index) {
+  Strand* ret = NULL;
+  {
+    Worker* own = workers_[index].get();
+    std::lock_guard<std::mutex> lock(own->lock);
+    if (!own->runnable.empty()) {
+      ret = own->runnable.back();
+      own->runnable.pop_back();
+    }
+  }
+  bool stolen = false;
+  for (size_t i = 1; !ret && i < workers_.size(); i++) {
+    Worker* victim = workers_[(index + i) % workers_.size()].get();
+    std::lock_guard<std::mutex> lock(victim->lock);
+    if (!victim->runnable.empty()) {
+      ret = victim->runnable.front();
+      victim->runnable.pop_front();
+      stolen = true;
+    }
+  }
+  if (ret) {
+    std::lock_guard<std::mutex> lock(lock_);
+    runnable_count_--;
+    if (stolen)
+      steals_++;
+  }
+  return ret;
+}
+
+void StrandScheduler::WorkerMain(size_t index) {
+  current_scheduler = this;
+  current_worker = index;
+  for (;;) {
+    Strand* strand = TakeStrand(index);
+    if (!strand) {
+      std::unique_lock<std::mutex> lock(lock_);
+      if (runnable_count_) {
+        // Being queued by another thread right now
+        lock.unlock();
+        std::this_thread::yield();
+        continue;
+      }
+      if (stopping_)
+        return;
+      wake_.wait(lock);
+      continue;
+    }
+    if (!strand->RunTurn())
+      continue;
+    // Still has work. Put it where our own next TakeStrand() looks last and
+    // where idle threads steal from.
+    {
+      std::lock_guard<std::mutex> lock(lock_);
+      runnable_count_++;
+    }
+    {
+      std::lock_guard<std::mutex> lock(workers_[index]->lock);
+      workers_[index]->runnable.push_front(strand);
+    }
+    wake_.notify_one();
+  }
+}
+
+}  // namespace gestures
+
+// C API:
+
+GesturesStrandScheduler* NewGesturesStrandScheduler(size_t thread_count) {
+  return new gestures::StrandScheduler(thread_count);
+}
+
+void DeleteGesturesStrandScheduler(GesturesStrandScheduler* scheduler) {
+  delete scheduler;
+}
+
+GesturesStrand* GesturesStrandSchedulerNewStrand(
+    GesturesStrandScheduler* scheduler) {
+  return scheduler->NewStrand();
+}
+
+void GesturesStrandSchedulerWaitIdle(GesturesStrandScheduler* scheduler) {
+  scheduler->WaitIdle();
+}
+
+void GesturesStrandPost(GesturesStrand* strand, GesturesTaskFunction task,
+                        void* data) {
+  strand->Post(task, data);
+}
+
+void GesturesStrandPushHardwareState(GesturesStrand* strand,
+                                     GestureInterpreter* gi,
+                                     const struct HardwareState* hwstate) {
+  strand->PostHardwareState(gi, *hwstate);
+}
+
+void GesturesStrandSetTimerProvider(GesturesStrand* strand,
+                                    GestureInterpreter* gi,
+                                    GesturesTimerProvider* tp,
+                                    void* tp_data) {
+  strand->SetTimerProvider(tp, tp_data);
+  gi->SetTimerProvider(gestures::Strand::provider(), strand);
+}
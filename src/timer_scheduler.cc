@@ -0,0 +1,38 @@
+// Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "gestures/include/timer_scheduler.h"
+
+namespace gestures {
+
+const stime_t TimerScheduler::kSlack = 0.000001;
+
+void TimerScheduler::SetDeadline(int id, stime_t deadline) {
+  if (deadline <= 0.0) {
+    Cancel(id);
+    return;
+  }
+  deadlines_[id] = deadline;
+}
+
+stime_t TimerScheduler::Deadline(int id) const {
+  map<int, stime_t, kMaxTimers>::const_iterator it = deadlines_.find(id);
+  return it == deadlines_.end() ? 0.0 : it->second;
+}
+
+stime_t TimerScheduler::NextDeadline() const {
+  stime_t ret = 0.0;
+  for (map<int, stime_t, kMaxTimers>::const_iterator it = deadlines_.begin(),
+           e = deadlines_.end(); it != e; ++it)
+    if (ret == 0.0 || it->second < ret)
+      ret = it->second;
+  return ret;
+}
+
+bool TimerScheduler::IsDue(int id, stime_t now) const {
+  stime_t deadline = Deadline(id);
+  return deadline > 0.0 && deadline < now + kSlack;
+}
+
+}  // namespace gestures
@@ -0,0 +1,54 @@
+// Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <gtest/gtest.h>
+
+#include "gestures/include/timer_scheduler.h"
+
+namespace gestures {
+
+class TimerSchedulerTest : public ::testing::Test {};
+
+TEST(TimerSchedulerTest, SimpleTest) {
+  TimerScheduler timers;
+  EXPECT_TRUE(timers.empty());
+  EXPECT_DOUBLE_EQ(0.0, timers.NextDeadline());
+
+  timers.SetDeadline(0, 2.0);
+  timers.SetDeadline(1, 1.5);
+  timers.SetDeadline(2, 3.0);
+  EXPECT_DOUBLE_EQ(1.5, timers.NextDeadline());
+  EXPECT_DOUBLE_EQ(2.0, timers.Deadline(0));
+
+  EXPECT_FALSE(timers.IsDue(1, 1.4));
+  EXPECT_TRUE(timers.IsDue(1, 1.5));
+  EXPECT_TRUE(timers.IsDue(1, 1.6));
+  EXPECT_FALSE(timers.IsDue(3, 10.0));
+
+  // Moving a deadline replaces it
+  timers.SetDeadline(1, 2.5);
+  EXPECT_DOUBLE_EQ(2.0, timers.NextDeadline());
+
+  // Non-positive deadlines cancel
+  timers.SetDeadline(0, 0.0);
+  EXPECT_DOUBLE_EQ(0.0, timers.Deadline(0));
+  EXPECT_DOUBLE_EQ(2.5, timers.NextDeadline());
+
+  timers.Cancel(1);
+  timers.Cancel(2);
+  EXPECT_TRUE(timers.empty());
+  EXPECT_DOUBLE_EQ(0.0, timers.NextDeadline());
+}
+
+TEST(TimerSchedulerTest, SameDeadlineTest) {
+  stime_t now = 1234.567;
+  stime_t deadline = now + 0.1;
+  stime_t rederived = now + (deadline - now);
+  EXPECT_TRUE(TimerScheduler::SameDeadline(deadline, rederived));
+  EXPECT_TRUE(TimerScheduler::SameDeadline(0.0, 0.0));
+  EXPECT_FALSE(TimerScheduler::SameDeadline(deadline, deadline + 0.001));
+  EXPECT_FALSE(TimerScheduler::SameDeadline(0.0, deadline));
+}
+
+}  // namespace gestures
@@ -0,0 +1,304 @@
+// Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "gestures/include/timerfd_loop.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "gestures/include/eintr_wrapper.h"
+#include "gestures/include/logging.h"
+
+namespace gestures {
+
+namespace {
+const int kMaxEvents = 16;
+
+void StimeToTimespec(stime_t time, struct timespec* ts) {
+  stime_t secs = floor(time);
+  ts->tv_sec = static_cast<time_t>(secs);
+  ts->tv_nsec = static_cast<long>((time - secs) * 1000000000.0);
+  if (ts->tv_nsec > 999999999)
+    ts->tv_nsec = 999999999;
+}
+}  // namespace {}
+
+GesturesTimerProvider TimerFdLoop::kProvider = {
+  TimerFdLoop::StaticCreate,
+  TimerFdLoop::StaticSet,
+  TimerFdLoop::StaticCancel,
+  TimerFdLoop::StaticFree
+};
+
+TimerFdLoop::TimerFdLoop()
+    : epoll_fd_(epoll_create1(EPOLL_CLOEXEC)),
+      slack_(0.0),
+      dispatching_(false) {
+  if (epoll_fd_ < 0)
+    Err("epoll_create1 failed: %s", strerror(errno));
+}
+
+TimerFdLoop::~TimerFdLoop() {
+  for (std::set<Source*>::iterator it = timers_.begin(), e = timers_.end();
+       it != e; ++it) {
+    close((*it)->fd);
+    delete *it;
+  }
+  for (std::set<Source*>::iterator it = watches_.begin(), e = watches_.end();
+       it != e; ++it)
+    delete *it;
+  for (size_t i = 0; i < dead_.size(); i++)
+    delete dead_[i];
+  if (epoll_fd_ >= 0)
+    close(epoll_fd_);
+}
+
+stime_t TimerFdLoop::Now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return StimeFromTimespec(&ts);
+}
+
+bool TimerFdLoop::AddSource(Source* source) {
+  struct epoll_event event;
+  memset(&event, 0, sizeof(event));
+  event.events = EPOLLIN;
+  event.data.ptr = source;
+  if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, source->fd, &event) < 0) {
+    Err("epoll_ctl failed for fd %d: %s", source->fd, strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+void TimerFdLoop::RemoveSource(Source* source) {
+  epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, source->fd, NULL);
+  if (source->is_timer)
+    close(source->fd);
+  source->fd = -1;
+  if (dispatching_)
+    dead_.push_back(source);
+  else
+    delete source;
+}
+
+bool TimerFdLoop::WatchFd(int fd, GesturesFdCallback callback, void* data) {
+  if (!valid())
+    return false;
+  Source* source = new Source();
+  source->fd = fd;
+  source->is_timer = false;
+  source->fd_callback = callback;
+  source->fd_data = data;
+  if (!AddSource(source)) {
+    delete source;
+    return false;
+  }
+  watches_.insert(source);
+  return true;
+}
+
+void TimerFdLoop::UnwatchFd(int fd) {
+  for (std::set<Source*>::iterator it = watches_.begin(), e = watches_.end();
+       it != e; ++it) {
+    if ((*it)->fd == fd) {
+      Source* source = *it;
+      watches_.erase(it);
+      RemoveSource(source);
+      return;
+    }
+  }
+  Err("fd %d isn't being watched", fd);
+}
+
+GesturesTimer* TimerFdLoop::CreateTimer() {
+  if (!valid())
+    return NULL;
+  int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (fd < 0) {
+    Err("timerfd_create failed: %s", strerror(errno));
+    return NULL;
+  }
+  Source* source = new Source();
+  source->fd = fd;
+  source->is_timer = true;
+  source->deadline = 0.0;
+  if (!AddSource(source)) {
+    close(fd);
+    delete source;
+    return NULL;
+  }
+  timers_.insert(source);
+  return reinterpret_cast<GesturesTimer*>(source);
+}
+
+bool TimerFdLoop::ArmTimerFd(Source* timer, stime_t deadline) {
+  struct itimerspec spec;
+  memset(&spec, 0, sizeof(spec));
+  // An all-zero it_value disarms the timer.
+  if (deadline > 0.0)
+    StimeToTimespec(deadline, &spec.it_value);
+  if (timerfd_settime(timer->fd, TFD_TIMER_ABSTIME, &spec, NULL) < 0) {
+    Err("timerfd_settime failed: %s", strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+void TimerFdLoop::SetTimer(GesturesTimer* timer, stime_t delay,
+                           GesturesTimerCallback callback,
+                           void* callback_data) {
+  Source* source = reinterpret_cast<Source*>(timer);
+  stime_t deadline = Now() + (delay > 0.0 ? delay : 0.0);
+  if (slack_ > 0.0)
+    deadline = ceil(deadline / slack_) * slack_;
+  source->timer_callback = callback;
+  source->timer_data = callback_data;
+  source->deadline = ArmTimerFd(source, deadline) ? deadline : 0.0;
+}
+
+void TimerFdLoop::CancelTimer(GesturesTimer* timer) {
+  Source* source = reinterpret_cast<Source*>(timer);
+  if (source->deadline == 0.0)
+    return;
+  source->deadline = 0.0;
+  ArmTimerFd(source, 0.0);
+}
+
+void TimerFdLoop::FreeTimer(GesturesTimer* timer) {
+  Source* source = reinterpret_cast<Source*>(timer);
+  if (timers_.erase(source) != 1) {
+    Err("Freeing unknown timer");
+    return;
+  }
+  RemoveSource(source);
+}
+
+void TimerFdLoop::FireTimer(Source* timer, stime_t now) {
+  timer->deadline = 0.0;
+  // It may have been run early because of the slack, so make sure the
+  // timerfd doesn't fire again for this deadline.
+  ArmTimerFd(timer, 0.0);
+  stime_t next = timer->timer_callback(now, timer->timer_data);
+  if (next >= 0.0 && timer->fd >= 0)
+    SetTimer(reinterpret_cast<GesturesTimer*>(timer), next,
+             timer->timer_callback, timer->timer_data);
+}
+
+int TimerFdLoop::Dispatch(int timeout_ms) {
+  if (!valid())
+    return -1;
+  struct epoll_event events[kMaxEvents];
+  int count = epoll_wait(epoll_fd_, events, kMaxEvents, timeout_ms);
+  if (count < 0) {
+    if (errno == EINTR)
+      return 0;
+    Err("epoll_wait failed: %s", strerror(errno));
+    return -1;
+  }
+  int ran = 0;
+  dispatching_ = true;
+  for (int i = 0; i < count; i++) {
+    Source* source = reinterpret_cast<Source*>(events[i].data.ptr);
+    if (source->fd < 0)
+      continue;  // Removed by an earlier callback
+    if (source->is_timer) {
+      // Clear the expiration; the timer itself runs below.
+      uint64_t expirations = 0;
+      if (HANDLE_EINTR(read(source->fd, &expirations,
+                            sizeof(expirations))) < 0 && errno != EAGAIN)
+        Err("timerfd read failed: %s", strerror(errno));
+      continue;
+    }
+    source->fd_callback(source->fd, source->fd_data);
+    ran++;
+  }
+  // Run every timer that is due, including those within the slack that
+  // haven't fired yet. Callbacks may set or cancel other timers, so work
+  // from a snapshot.
+  stime_t now = Now();
+  std::vector<Source*> due;
+  for (std::set<Source*>::iterator it = timers_.begin(), e = timers_.end();
+       it != e; ++it)
+    if ((*it)->deadline > 0.0 && (*it)->deadline <= now + slack_)
+      due.push_back(*it);
+  for (size_t i = 0; i < due.size(); i++) {
+    if (due[i]->fd < 0 || due[i]->deadline == 0.0)
+      continue;  // Freed or cancelled by an earlier callback
+    FireTimer(due[i], now);
+    ran++;
+  }
+  dispatching_ = false;
+  for (size_t i = 0; i < dead_.size(); i++)
+    delete dead_[i];
+  dead_.clear();
+  return ran;
+}
+
+GesturesTimer* TimerFdLoop::StaticCreate(void* data) {
+  return reinterpret_cast<TimerFdLoop*>(data)->CreateTimer();
+}
+
+void TimerFdLoop::StaticSet(void* data, GesturesTimer* timer, stime_t delay,
+                            GesturesTimerCallback callback,
+                            void* callback_data) {
+  reinterpret_cast<TimerFdLoop*>(data)->SetTimer(timer, delay, callback,
+                                                 callback_data);
+}
+
+void TimerFdLoop::StaticCancel(void* data, GesturesTimer* timer) {
+  reinterpret_cast<TimerFdLoop*>(data)->CancelTimer(timer);
+}
+
+void TimerFdLoop::StaticFree(void* data, GesturesTimer* timer) {
+  reinterpret_cast<TimerFdLoop*>(data)->FreeTimer(timer);
+}
+
+}  // namespace gestures
+
+// C API:
+
+GesturesTimerFdLoop* NewGesturesTimerFdLoop(void) {
+  gestures::TimerFdLoop* loop = new gestures::TimerFdLoop();
+  if (!loop->valid()) {
+    delete loop;
+    return NULL;
+  }
+  return loop;
+}
+
+void DeleteGesturesTimerFdLoop(GesturesTimerFdLoop* loop) {
+  delete loop;
+}
+
+GesturesTimerProvider* GesturesTimerFdLoopProvider(void) {
+  return gestures::TimerFdLoop::provider();
+}
+
+int GesturesTimerFdLoopFd(GesturesTimerFdLoop* loop) {
+  return loop->fd();
+}
+
+void GesturesTimerFdLoopSetSlack(GesturesTimerFdLoop* loop, stime_t slack) {
+  loop->set_slack(slack);
+}
+
+int GesturesTimerFdLoopWatchFd(GesturesTimerFdLoop* loop, int fd,
+                               GesturesFdCallback callback, void* data) {
+  return loop->WatchFd(fd, callback, data) ? 1 : 0;
+}
+
+void GesturesTimerFdLoopUnwatchFd(GesturesTimerFdLoop* loop, int fd) {
+  loop->UnwatchFd(fd);
+}
+
+int GesturesTimerFdLoopDispatch(GesturesTimerFdLoop* loop, int timeout_ms) {
+  return loop->Dispatch(timeout_ms);
+}
@@ -0,0 +1,119 @@
+// Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+#include "gestures/include/gestures.h"
+#include "gestures/include/timerfd_loop.h"
+
+namespace gestures {
+
+class TimerFdLoopTest : public ::testing::Test {};
+
+namespace {
+struct CallbackRecord {
+  CallbackRecord() : count(0), last_now(0.0), rearm(-1.0) {}
+  int count;
+  stime_t last_now;
+  stime_t rearm;
+};
+
+stime_t RecordingCallback(stime_t now, void* data) {
+  CallbackRecord* record = reinterpret_cast<CallbackRecord*>(data);
+  record->count++;
+  record->last_now = now;
+  stime_t ret = record->rearm;
+  record->rearm = -1.0;
+  return ret;
+}
+
+void ReadByteCallback(int fd, void* data) {
+  char c;
+  if (read(fd, &c, 1) == 1)
+    (*reinterpret_cast<int*>(data))++;
+}
+}  // namespace {}
+
+TEST(TimerFdLoopTest, SimpleTest) {
+  TimerFdLoop loop;
+  ASSERT_TRUE(loop.valid());
+  GesturesTimerProvider* provider = TimerFdLoop::provider();
+  GesturesTimer* timer = provider->create_fn(&loop);
+  ASSERT_TRUE(timer);
+
+  CallbackRecord record;
+  record.rearm = 0.001;  // Ask to be called once more
+  stime_t start = TimerFdLoop::Now();
+  provider->set_fn(&loop, timer, 0.01, RecordingCallback, &record);
+  while (record.count < 2)
+    ASSERT_LE(0, loop.Dispatch(1000));
+  EXPECT_EQ(2, record.count);
+  EXPECT_LE(start + 0.011, record.last_now);
+
+  // Cancelled timers don't fire
+  provider->set_fn(&loop, timer, 0.005, RecordingCallback, &record);
+  provider->cancel_fn(&loop, timer);
+  EXPECT_EQ(0, loop.Dispatch(20));
+  EXPECT_EQ(2, record.count);
+
+  provider->free_fn(&loop, timer);
+}
+
+TEST(TimerFdLoopTest, SlackTest) {
+  TimerFdLoop loop;
+  loop.set_slack(0.05);
+  GesturesTimer* first = loop.CreateTimer();
+  GesturesTimer* second = loop.CreateTimer();
+  CallbackRecord first_record;
+  CallbackRecord second_record;
+
+  // Both deadlines land in the same slack window, so one wakeup runs both.
+  loop.SetTimer(first, 0.001, RecordingCallback, &first_record);
+  loop.SetTimer(second, 0.002, RecordingCallback, &second_record);
+  int ran = 0;
+  while (ran == 0)
+    ran = loop.Dispatch(1000);
+  EXPECT_EQ(2, ran);
+  EXPECT_EQ(1, first_record.count);
+  EXPECT_EQ(1, second_record.count);
+  EXPECT_DOUBLE_EQ(first_record.last_now, second_record.last_now);
+
+  loop.FreeTimer(first);
+  loop.FreeTimer(second);
+}
+
+TEST(TimerFdLoopTest, WatchFdTest) {
+  TimerFdLoop loop;
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+  int reads = 0;
+  EXPECT_TRUE(loop.WatchFd(fds[0], ReadByteCallback, &reads));
+  EXPECT_EQ(0, loop.Dispatch(0));
+  EXPECT_EQ(1, write(fds[1], "x", 1));
+  EXPECT_EQ(1, loop.Dispatch(1000));
+  EXPECT_EQ(1, reads);
+  loop.UnwatchFd(fds[0]);
+  EXPECT_EQ(1, write(fds[1], "x", 1));
+  EXPECT_EQ(0, loop.Dispatch(0));
+  close(fds[0]);
+  close(fds[1]);
+}
+
+// Drives a real GestureInterpreter through the C API.
+TEST(TimerFdLoopTest, CApiTest) {
+  GesturesTimerFdLoop* loop = NewGesturesTimerFdLoop();
+  ASSERT_TRUE(loop);
+  EXPECT_LE(0, GesturesTimerFdLoopFd(loop));
+  GesturesTimerFdLoopSetSlack(loop, 0.001);
+  GestureInterpreter* gi = NewGestureInterpreter();
+  GestureInterpreterSetTimerProvider(gi, GesturesTimerFdLoopProvider(), loop);
+  GestureInterpreterInitialize(gi, GESTURES_DEVCLASS_MOUSE);
+  DeleteGestureInterpreter(gi);
+  EXPECT_EQ(0, GesturesTimerFdLoopDispatch(loop, 0));
+  DeleteGesturesTimerFdLoop(loop);
+}
+
+}  // namespace gestures
@@ -4,7 +4,9 @@
 
 #include "gestures/include/trend_classifying_filter_interpreter.h"
 
+#include <algorithm>
 #include <cmath>
+#include <cstring>
 
 #include "gestures/include/filter_interpreter.h"
 #include "gestures/include/finger_metrics.h"
@@ -29,8 +31,8 @@ namespace gestures {
 TrendClassifyingFilterInterpreter::TrendClassifyingFilterInterpreter(
     PropRegistry* prop_reg, Interpreter* next, Tracer* tracer)
     : FilterInterpreter(NULL, next, tracer, false),
-      kstate_mm_(kMaxFingers * kNumOfSamples),
-      history_mm_(kMaxFingers),
+      ring_(new float[kMaxFingers * kNumAxes * kMaxNumOfSamples]),
+      sorted_(new float[kMaxFingers * kNumAxes * kMaxNumOfSamples]),
       trend_classifying_filter_enable_(
           prop_reg, "Trend Classifying Filter Enabled", true),
       second_order_enable_(
@@ -42,8 +44,13 @@ TrendClassifyingFilterInterpreter::TrendClassifyingFilterInterpreter(
       z_threshold_(
           prop_reg, "Trend Classifying Z Threshold", 2.5758293035489004) {
   InitName();
+  for (size_t i = 0; i < arraysize(windows_); i++)
+    ClearWindow(i);
+  memset(slot_used_, 0, sizeof(slot_used_));
 }
 
+const size_t TrendClassifyingFilterInterpreter::kMaxNumOfSamples;
+
 void TrendClassifyingFilterInterpreter::SyncInterpretImpl(
     HardwareState* hwstate, stime_t* timeout) {
   if (trend_classifying_filter_enable_.val_)
@@ -70,116 +77,145 @@ void TrendClassifyingFilterInterpreter::InterpretTestResult(
     *flags |= flag_decreasing;
 }
 
-void TrendClassifyingFilterInterpreter::AddNewStateToBuffer(
-    FingerHistory* history, const FingerState& fs) {
-  // The history buffer is already full, pop one
-  if (history->size() == static_cast<size_t>(num_of_samples_.val_))
-    history->DeleteFront();
-
-  // Push the new finger state to the back of buffer
-  KState* previous_end = history->Tail();
-  KState* current = history->PushNewEltBack();
-  if (!current) {
-    Err("KState buffer out of space");
-    return;
-  }
-  current->Init(fs);
-  if (history->size() == 1)
+void TrendClassifyingFilterInterpreter::ClearWindow(size_t idx) {
+  KendallWindow* window = &windows_[idx];
+  window->head = window->size = 0;
+  window->score = window->tie_n2 = window->tie_n3 = 0;
+}
+
+void TrendClassifyingFilterInterpreter::PushSample(size_t idx, float val,
+                                                   size_t max_size) {
+  KendallWindow* window = &windows_[idx];
+  while (window->size && window->size >= max_size)
+    PopSample(idx);
+  if (!max_size)
     return;
 
-  current->DxAxis()->val = current->XAxis()->val - previous_end->XAxis()->val;
-  current->DyAxis()->val = current->YAxis()->val - previous_end->YAxis()->val;
-  // Update the nodes already in the buffer and compute the Kendall score/
-  // variance along the way. Complexity is O(|buffer|) per finger.
-  int tie_n2[KState::n_axes_] = { 0, 0, 0, 0, 0, 0 };
-  int tie_n3[KState::n_axes_] = { 0, 0, 0, 0, 0, 0 };
-  for (KState* it = history->Begin(); it != history->Tail(); it = it->next_)
-    for (size_t i = 0; i < KState::n_axes_; i++)
-      if(it != history->Begin() || !KState::IsDelta(i)) {
-        UpdateKTValuePair(&it->axes_[i], &current->axes_[i],
-            &tie_n2[i], &tie_n3[i]);
-      }
-  size_t n_samples = history->size();
-  for (size_t i = 0; i < KState::n_axes_; i++) {
-    current->axes_[i].var = ComputeKTVariance(tie_n2[i], tie_n3[i],
-        KState::IsDelta(i) ? n_samples - 1 : n_samples);
+  float* sorted = &sorted_[idx * kMaxNumOfSamples];
+  float* lower = std::lower_bound(sorted, sorted + window->size, val);
+  float* upper = std::upper_bound(lower, sorted + window->size, val);
+  int less = lower - sorted;
+  int greater = sorted + window->size - upper;
+  int ties = upper - lower;
+  window->score += less - greater;
+  window->tie_n2 += ties;
+  window->tie_n3 += (ties * (ties - 1)) >> 1;
+  memmove(upper + 1, upper, greater * sizeof(*upper));
+  *upper = val;
+
+  float* ring = &ring_[idx * kMaxNumOfSamples];
+  ring[(window->head + window->size) % kMaxNumOfSamples] = val;
+  window->size++;
+}
+
+void TrendClassifyingFilterInterpreter::PopSample(size_t idx) {
+  KendallWindow* window = &windows_[idx];
+  float* ring = &ring_[idx * kMaxNumOfSamples];
+  float val = ring[window->head];
+  window->head = (window->head + 1) % kMaxNumOfSamples;
+
+  // The oldest sample comes before all the others, so its pairs with them
+  // are concordant when they're greater.
+  float* sorted = &sorted_[idx * kMaxNumOfSamples];
+  float* lower = std::lower_bound(sorted, sorted + window->size, val);
+  float* upper = std::upper_bound(lower, sorted + window->size, val);
+  int less = lower - sorted;
+  int greater = sorted + window->size - upper;
+  int ties = upper - lower - 1;
+  window->score -= greater - less;
+  window->tie_n2 -= ties;
+  window->tie_n3 -= (ties * (ties - 1)) >> 1;
+  memmove(lower, lower + 1, (window->size - less - 1) * sizeof(*lower));
+  window->size--;
+}
+
+void TrendClassifyingFilterInterpreter::AddNewStateToBuffer(
+    size_t slot, const FingerState& fs) {
+  size_t num_of_samples = std::min(
+      static_cast<size_t>(std::max(num_of_samples_.val_, 1)),
+      kMaxNumOfSamples);
+  size_t x_idx = WindowIndex(slot, kAxisX);
+  size_t y_idx = WindowIndex(slot, kAxisY);
+  if (windows_[x_idx].size) {
+    // Deltas from the previous sample; the window has one fewer of them.
+    const KendallWindow& x = windows_[x_idx];
+    const KendallWindow& y = windows_[y_idx];
+    size_t last = (x.head + x.size - 1) % kMaxNumOfSamples;
+    PushSample(WindowIndex(slot, kAxisDx),
+               fs.position_x - ring_[x_idx * kMaxNumOfSamples + last],
+               num_of_samples - 1);
+    last = (y.head + y.size - 1) % kMaxNumOfSamples;
+    PushSample(WindowIndex(slot, kAxisDy),
+               fs.position_y - ring_[y_idx * kMaxNumOfSamples + last],
+               num_of_samples - 1);
   }
+  PushSample(x_idx, fs.position_x, num_of_samples);
+  PushSample(y_idx, fs.position_y, num_of_samples);
+  PushSample(WindowIndex(slot, kAxisPressure), fs.pressure, num_of_samples);
+  PushSample(WindowIndex(slot, kAxisTouchMajor), fs.touch_major,
+             num_of_samples);
 }
 
 TrendClassifyingFilterInterpreter::TrendType
-TrendClassifyingFilterInterpreter::RunKTTest(const KState::KAxis* current,
-    const size_t n_samples) {
+TrendClassifyingFilterInterpreter::RunKTTest(const KendallWindow& window) {
   // Sample size is too small for a meaningful result
-  if (n_samples < static_cast<size_t>(min_num_of_samples_.val_))
+  if (window.size < static_cast<size_t>(min_num_of_samples_.val_))
     return TREND_NONE;
 
   // A zero score implies purely random behavior. Need to special-case it
   // because the test might be fooled with a zero variance (e.g. all
   // observations are tied).
-  if (!current->score)
+  if (!window.score)
     return TREND_NONE;
 
   // The test conduct the hypothesis test based on the fact that S/sqrt(Var(S))
   // approximately follows the normal distribution. To optimize for speed,
   // we reformulate the expression to drop the sqrt and division operations.
-  if (current->score * current->score <
-      z_threshold_.val_ * z_threshold_.val_ * current->var) {
+  double var = ComputeKTVariance(window.tie_n2, window.tie_n3, window.size);
+  if (window.score * window.score < z_threshold_.val_ * z_threshold_.val_ * var)
     return TREND_NONE;
-  }
-  return (current->score > 0) ? TREND_INCREASING : TREND_DECREASING;
+  return (window.score > 0) ? TREND_INCREASING : TREND_DECREASING;
 }
 
 void TrendClassifyingFilterInterpreter::UpdateFingerState(
     const HardwareState& hwstate) {
-  FingerHistoryMap removed;
-  RemoveMissingIdsFromMap(&histories_, hwstate, &removed);
-  for (FingerHistoryMap::const_iterator it =
+  FingerSlotMap removed;
+  RemoveMissingIdsFromMap(&slots_, hwstate, &removed);
+  for (FingerSlotMap::const_iterator it =
        removed.begin(); it != removed.end(); ++it) {
-    it->second->DeleteAll();
-    history_mm_.Free(it->second);
+    for (size_t axis = 0; axis < kNumAxes; axis++)
+      ClearWindow(WindowIndex(it->second, axis));
+    slot_used_[it->second] = false;
   }
 
   FingerState *fs = hwstate.fingers;
   for (short i = 0; i < hwstate.finger_cnt; i++) {
-    FingerHistory* hp;
+    size_t slot;
 
     // Update the map if the contact is new
-    if (!MapContainsKey(histories_, fs[i].tracking_id)) {
-      hp = history_mm_.Allocate();
-      if (!hp) {
-        Err("FingerHistory out of space");
+    FingerSlotMap::const_iterator it = slots_.find(fs[i].tracking_id);
+    if (it == slots_.end()) {
+      slot = std::find(slot_used_, slot_used_ + kMaxFingers, false) -
+          slot_used_;
+      if (slot == kMaxFingers) {
+        Err("Finger slots out of space");
         continue;
       }
-      hp->Init(&kstate_mm_);
-      histories_[fs[i].tracking_id] = hp;
+      slot_used_[slot] = true;
+      slots_[fs[i].tracking_id] = slot;
     } else {
-      hp = histories_[fs[i].tracking_id];
+      slot = it->second;
     }
 
     // Check if the score demonstrates statistical significance
-    AddNewStateToBuffer(hp, fs[i]);
-    KState* current = hp->Tail();
-    size_t n_samples = hp->size();
-    for (size_t idx = 0; idx < KState::n_axes_; idx++)
-      if (second_order_enable_.val_ || !KState::IsDelta(idx)) {
-        TrendType result = RunKTTest(&current->axes_[idx],
-            KState::IsDelta(idx) ? n_samples - 1 : n_samples);
-        InterpretTestResult(result, KState::IncFlag(idx),
-            KState::DecFlag(idx), &(fs[i].flags));
+    AddNewStateToBuffer(slot, fs[i]);
+    for (size_t axis = 0; axis < kNumAxes; axis++)
+      if (second_order_enable_.val_ || !IsDelta(axis)) {
+        TrendType result = RunKTTest(windows_[WindowIndex(slot, axis)]);
+        InterpretTestResult(result, IncFlag(axis), DecFlag(axis),
+                            &(fs[i].flags));
       }
   }
 }
 
-void TrendClassifyingFilterInterpreter::KState::Init() {
-  for (size_t i = 0; i < KState::n_axes_; i++)
-    axes_[i].Init();
-}
-
-void TrendClassifyingFilterInterpreter::KState::Init(const FingerState& fs) {
-  Init();
-  XAxis()->val = fs.position_x, YAxis()->val = fs.position_y;
-  PressureAxis()->val = fs.pressure;
-  TouchMajorAxis()->val = fs.touch_major;
-}
-
 }
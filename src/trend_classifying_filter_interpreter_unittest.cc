@@ -0,0 +1,121 @@
+// Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <deque>
+
+#include <gtest/gtest.h>
+
+#include "gestures/include/gestures.h"
+#include "gestures/include/trend_classifying_filter_interpreter.h"
+#include "gestures/include/unittest_util.h"
+
+using std::deque;
+
+namespace gestures {
+
+class TrendClassifyingFilterInterpreterTest : public ::testing::Test {};
+
+class TrendClassifyingFilterInterpreterTestInterpreter : public Interpreter {
+ public:
+  TrendClassifyingFilterInterpreterTestInterpreter()
+      : Interpreter(NULL, NULL, false) {}
+
+  virtual void SyncInterpret(HardwareState* hwstate, stime_t* timeout) {}
+};
+
+// The incremental statistic must match the one computed from scratch over
+// the samples in the window.
+TEST(TrendClassifyingFilterInterpreterTest, KendallWindowTest) {
+  TrendClassifyingFilterInterpreter interpreter(
+      NULL, new TrendClassifyingFilterInterpreterTestInterpreter, NULL);
+  const size_t kWindowSize = 8;
+  deque<float> samples;
+  unsigned seed = 1;
+  for (size_t i = 0; i < 100; i++) {
+    // Few distinct values, so there are plenty of ties
+    seed = seed * 1103515245 + 12345;
+    float val = (seed >> 16) % 5;
+    interpreter.PushSample(0, val, kWindowSize);
+    samples.push_back(val);
+    if (samples.size() > kWindowSize)
+      samples.pop_front();
+
+    int score = 0, tie_n2 = 0, tie_n3 = 0;
+    for (size_t j = 0; j < samples.size(); j++) {
+      int later_ties = 0;
+      for (size_t k = j + 1; k < samples.size(); k++) {
+        if (samples[j] < samples[k])
+          score++;
+        else if (samples[j] > samples[k])
+          score--;
+        else
+          later_ties++;
+      }
+      tie_n2 += later_ties;
+      tie_n3 += later_ties * (later_ties - 1) / 2;
+    }
+    const TrendClassifyingFilterInterpreter::KendallWindow& window =
+        interpreter.windows_[0];
+    EXPECT_EQ(samples.size(), window.size) << "i=" << i;
+    EXPECT_EQ(score, window.score) << "i=" << i;
+    EXPECT_EQ(tie_n2, window.tie_n2) << "i=" << i;
+    EXPECT_EQ(tie_n3, window.tie_n3) << "i=" << i;
+  }
+
+  // Shrinking the window drops the oldest samples.
+  float a = samples[kWindowSize - 2], b = samples[kWindowSize - 1];
+  interpreter.PushSample(0, 10.0, 3);
+  EXPECT_EQ(3U, interpreter.windows_[0].size);
+  EXPECT_EQ(2 + (a < b) - (a > b), interpreter.windows_[0].score);
+}
+
+TEST(TrendClassifyingFilterInterpreterTest, SimpleTest) {
+  TrendClassifyingFilterInterpreter interpreter(
+      NULL, new TrendClassifyingFilterInterpreterTestInterpreter, NULL);
+  HardwareProperties hwprops = {
+    0, 0, 100, 100,  // left, top, right, bottom
+    1, 1,  // x res (pixels/mm), y res (pixels/mm)
+    1, 1,  // scrn DPI X, Y
+    0, 0,  // orientation minimum, maximum
+    2, 5,  // max fingers, max_touch
+    0, 0, 1, 0  // t5r2, semi, button pad
+  };
+  TestInterpreterWrapper wrapper(&interpreter, &hwprops);
+
+  const unsigned kTrendFlags =
+      GESTURES_FINGER_TREND_INC_X | GESTURES_FINGER_TREND_DEC_X |
+      GESTURES_FINGER_TREND_INC_Y | GESTURES_FINGER_TREND_DEC_Y |
+      GESTURES_FINGER_TREND_INC_PRESSURE |
+      GESTURES_FINGER_TREND_DEC_PRESSURE |
+      GESTURES_FINGER_TREND_INC_TOUCH_MAJOR |
+      GESTURES_FINGER_TREND_DEC_TOUCH_MAJOR;
+  for (size_t i = 0; i < 30; i++) {
+    // Finger 1 moves right; finger 2 jitters in place.
+    FingerState fs[] = {
+      { 0, 0, 0, 0, 50, 0, 10.0f + i, 50, 1, 0 },
+      { 0, 0, 0, 0, 50, 0, 70.0f + (i % 2), 50, 2, 0 },
+    };
+    HardwareState hs = { 0.01 * i, 0, 2, 2, fs, 0, 0, 0, 0 };
+    stime_t timeout = -1.0;
+    wrapper.SyncInterpret(&hs, &timeout);
+    // Too few samples at first to tell
+    unsigned expected = i < 5 ? 0 : GESTURES_FINGER_TREND_INC_X;
+    EXPECT_EQ(expected, fs[0].flags & kTrendFlags) << "i=" << i;
+    EXPECT_EQ(0U, fs[1].flags & kTrendFlags) << "i=" << i;
+  }
+
+  // A new finger with the same tracking id starts over.
+  FingerState fs = { 0, 0, 0, 0, 50, 0, 80, 50, 1, 0 };
+  HardwareState hs[] = {
+    { 0.30, 0, 0, 0, NULL, 0, 0, 0, 0 },
+    { 0.31, 0, 1, 1, &fs, 0, 0, 0, 0 },
+  };
+  for (size_t i = 0; i < arraysize(hs); i++) {
+    stime_t timeout = -1.0;
+    wrapper.SyncInterpret(&hs[i], &timeout);
+  }
+  EXPECT_EQ(0U, fs.flags & kTrendFlags);
+}
+
+}  // namespace gestures
@@ -0,0 +1,86 @@
+#!/usr/bin/python
+#
+# Copyright (c) 2014 The Chromium OS Authors. All rights reserved.
+# Use of this source code is governed by a BSD-style license that can be
+# found in the LICENSE file.
+
+"""Compile non-linearity filter data for memory-mapping.
+
+Converts a data file in the original format (three ranges of doubles, then
+the matrix of (x, y) error doubles) to the compiled format described by
+NonLinearityFilterInterpreter::DataHeader.
+
+Usage: convert_non_linearity_data.py INPUT.dat OUTPUT
+"""
+
+
+import logging
+import struct
+import sys
+
+
+MAGIC = 0x444c4e47  # "GNLD"
+VERSION = 1
+HEADER_FORMAT = '<8I'
+
+
+def _read(fmt, data, offset):
+  """Unpack |fmt| from |data| at |offset|. Return the values and the new
+  offset."""
+  size = struct.calcsize(fmt)
+  if offset + size > len(data):
+    raise ValueError('File is truncated')
+  return struct.unpack_from(fmt, data, offset), offset + size
+
+
+def checksum(payload):
+  """FNV-1a of the payload bytes."""
+  value = 2166136261
+  for byte in bytearray(payload):
+    value = ((value ^ byte) * 16777619) & 0xffffffff
+  return value
+
+
+def convert(data):
+  """Convert the original format in |data| to the compiled format."""
+  offset = 0
+  ranges = []
+  for _ in range(3):
+    (length,), offset = _read('<i', data, offset)
+    if length <= 0:
+      raise ValueError('Invalid range length %d' % length)
+    points, offset = _read('<%dd' % length, data, offset)
+    if any(a >= b for a, b in zip(points, points[1:])):
+      raise ValueError('Range points must be increasing')
+    ranges.append(points)
+  cells = len(ranges[0]) * len(ranges[1]) * len(ranges[2])
+  errors, offset = _read('<%dd' % (2 * cells), data, offset)
+
+  values = ranges[0] + ranges[1] + ranges[2] + errors
+  payload = struct.pack('<%df' % len(values), *values)
+  header = struct.pack(HEADER_FORMAT, MAGIC, VERSION,
+                       struct.calcsize(HEADER_FORMAT) + len(payload),
+                       len(ranges[0]), len(ranges[1]), len(ranges[2]),
+                       checksum(payload), 0)
+  return header + payload
+
+
+def main(argv):
+  if len(argv) != 3:
+    sys.stderr.write(__doc__)
+    return 1
+  with open(argv[1], 'rb') as f:
+    data = f.read()
+  try:
+    compiled = convert(data)
+  except (ValueError, struct.error) as err:
+    logging.error('%s: %s', argv[1], err)
+    return 1
+  with open(argv[2], 'wb') as f:
+    f.write(compiled)
+  return 0
+
+
+if __name__ == '__main__':
+  logging.basicConfig(format='', level=logging.INFO)
+  sys.exit(main(sys.argv))